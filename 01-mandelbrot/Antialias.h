@@ -0,0 +1,150 @@
+#ifndef ANTIALIAS_H_
+#define ANTIALIAS_H_
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Palette.h"
+#include "Tiles.h"
+
+// Adaptive anti-aliasing.
+//
+// The image is first rendered with one sample per pixel.  Only the pixels
+// where the smooth iteration count changes sharply (those whose count differs
+// from one of their neighbours by more than a threshold) are then supersampled,
+// with a jittered grid of samples across the pixel, and get the average color
+// of their samples.  That's where the aliasing is; everywhere else the color
+// changes too slowly to need more than one sample.  With distance shading,
+// the pixels within a pixel or so of the set are supersampled as well (see
+// escapeTimeWithDistance), since the filaments running through them can be
+// missed by the smooth iteration counts altogether.
+//
+// The jitter is a hash of the pixel and sample, so the result doesn't depend
+// on the order in which the tiles are rendered.
+
+
+// Whether the pixel (x, y) of a width x height buffer of smooth iteration
+// counts differs from any of its neighbours by more than threshold
+inline bool needsSupersampling(const float *smooth, int width, int height, int x, int y, float threshold)
+{
+    const float value = smooth[y*width + x];
+    const int dx[4] = {-1, 1, 0, 0};
+    const int dy[4] = {0, 0, -1, 1};
+    for(int k = 0; k < 4; ++k)
+    {
+        const int nx = x + dx[k];
+        const int ny = y + dy[k];
+        if(nx >= 0 && nx < width && ny >= 0 && ny < height &&
+           std::fabs(smooth[ny*width + nx] - value) > threshold)
+            return true;
+    }
+    return false;
+}
+
+
+// A pseudo random number in [0, 1) for sample k of pixel (x, y)
+inline double jitter(int x, int y, int k)
+{
+    std::uint64_t h = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) ^
+                      (static_cast<std::uint32_t>(y)*0x9E3779B9u) ^ (static_cast<std::uint64_t>(k) << 48);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return (h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Supersample the pixels of a tile that need it, and overwrite their colors in
+// bgr, which holds a band of the image  width  pixels wide, starting at row
+// band_y (the tile is in image coordinates).  needs(col, row) tells whether
+// pixel (col, row) of the image needs it, and colorSamples(x, y, count, bgr)
+// colors  count  samples given in pixel coordinates, where pixel (col, row) is
+// the point (col, row) and covers the square from (col - 0.5, row - 0.5) to
+// (col + 0.5, row + 0.5).  Each pixel gets grid x grid samples.
+//
+// Returns the number of pixels that were supersampled.
+template <typename NeedsSupersampling, typename ColorSamples>
+int supersamplePixels(const Tile &tile, int band_y, int width, int grid, const NeedsSupersampling &needs,
+                      const ColorSamples &colorSamples, unsigned char *bgr)
+{
+    const int samples = grid*grid;
+    std::vector<double> x(samples), y(samples);
+    std::vector<unsigned char> sample_bgr(3*samples);
+
+    int supersampled = 0;
+    for(int row = tile.y; row < tile.y + tile.height; ++row)
+    {
+        for(int col = tile.x; col < tile.x + tile.width; ++col)
+        {
+            if(!needs(col, row))
+                continue;
+
+            // One sample at a random position in every cell of the grid
+            for(int j = 0; j < grid; ++j)
+            {
+                for(int i = 0; i < grid; ++i)
+                {
+                    const int k = j*grid + i;
+                    x[k] = col - 0.5 + (i + jitter(col, row, 2*k))/grid;
+                    y[k] = row - 0.5 + (j + jitter(col, row, 2*k + 1))/grid;
+                }
+            }
+
+            colorSamples(x.data(), y.data(), samples, sample_bgr.data());
+
+            // Average the colors of the samples
+            unsigned char *out = bgr + 3*(static_cast<std::size_t>(row - band_y)*width + col);
+            for(int c = 0; c < 3; ++c)
+            {
+                int sum = 0;
+                for(int k = 0; k < samples; ++k)
+                    sum += sample_bgr[3*k + c];
+                out[c] = (sum + samples/2) / samples;
+            }
+            ++supersampled;
+        }
+    }
+    return supersampled;
+}
+
+
+// Supersample the pixels of a tile whose smooth iteration count differs from a
+// neighbour's by more than threshold (see needsSupersampling), coloring the
+// samples through the palette.
+//
+// bgr holds the colors of a band of the image  width  pixels wide, starting at
+// row band_y, and smooth the smooth iteration counts of  height  rows of the
+// image, starting at row smooth_y.  Those may reach a row past the band on
+// either side, so that the pixels on the edges of a band are compared with
+// their neighbours in the bands next to it, as they would be in the whole
+// image.  calculatePoints(x, y, count, iterations, norm) calculates the escape
+// times of points given in pixel coordinates, and degree is that of the
+// fractal (see smoothIterations).
+template <typename CalculatePoints>
+int supersampleTile(const Tile &tile, int band_y, const float *smooth, int smooth_y, int width, int height,
+                    int grid, float threshold, int max_iterations, const Palette &palette,
+                    const CalculatePoints &calculatePoints, unsigned char *bgr, int degree = 2)
+{
+    std::vector<double> norm(grid*grid);
+    std::vector<int> iterations(grid*grid);
+    std::vector<float> sample_smooth(grid*grid);
+
+    auto needs = [&](int col, int row)
+    {
+        return needsSupersampling(smooth, width, height, col, row - smooth_y, threshold);
+    };
+    auto colorSamples = [&](const double *x, const double *y, int count, unsigned char *sample_bgr)
+    {
+        calculatePoints(x, y, count, iterations.data(), norm.data());
+        for(int k = 0; k < count; ++k)
+            sample_smooth[k] = smoothIterations(iterations[k], norm[k], max_iterations, degree);
+        colorize(sample_smooth.data(), count, palette, sample_bgr);
+    };
+    return supersamplePixels(tile, band_y, width, grid, needs, colorSamples, bgr);
+}
+
+
+#endif  // ANTIALIAS_H_
@@ -0,0 +1,303 @@
+#ifndef BIG_FIXED_H_
+#define BIG_FIXED_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// An arbitrary precision fixed point number.
+//
+// The number is stored as a sign and a magnitude.  The magnitude is a vector of
+// 32 bit limbs, least significant first: the last limb is the integer part and
+// the other  fractionLimbs()  limbs are the fraction.  So the precision is
+// 32*fractionLimbs() bits after the binary point, and the integer part must stay
+// below 2^32, which is plenty for points of the Mandelbrot set and their orbits.
+//
+// This is only used for the few calculations that really need more than double
+// precision (the reference orbit of a deep zoom), so it is optimized more for
+// readability than for speed.
+
+class BigFixed
+{
+public:
+
+    // Number of fraction limbs needed for the given number of bits after the binary point
+    static int limbsForBits(int bits)
+    {
+        return bits <= 0 ? 1 : (bits + 31) / 32;
+    }
+
+    // Zero
+    explicit BigFixed(int fraction_limbs = 2)
+        : negative_(false), limbs_(fraction_limbs + 1, 0)
+    {
+    }
+
+    // mantissa * 2^exponent, truncated to the precision
+    BigFixed(double mantissa, int exponent, int fraction_limbs)
+        : negative_(mantissa < 0), limbs_(fraction_limbs + 1, 0)
+    {
+        if(mantissa == 0 || !std::isfinite(mantissa))
+        {
+            negative_ = false;
+            return;
+        }
+
+        // mantissa = m * 2^(shift) where m is a 53 bit integer
+        int e;
+        double m = std::frexp(std::fabs(mantissa), &e);
+        std::uint64_t bits = static_cast<std::uint64_t>(std::ldexp(m, 53));
+        const int shift = e - 53 + exponent + 32*fraction_limbs;
+
+        for(int b = 0; b < 53; ++b)
+        {
+            const int position = shift + b;
+            if(((bits >> b) & 1) && position >= 0 && position < 32*static_cast<int>(limbs_.size()))
+                limbs_[position / 32] |= std::uint32_t(1) << (position % 32);
+        }
+    }
+
+    // Parse a decimal number such as "-0.7436438870371587047521915", "1.5e-3" or "2"
+    static BigFixed fromString(const std::string &text, int fraction_limbs)
+    {
+        std::size_t i = 0;
+        bool negative = false;
+        if(i < text.size() && (text[i] == '-' || text[i] == '+'))
+            negative = text[i++] == '-';
+
+        std::string integer_digits, fraction_digits;
+        while(i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])))
+            integer_digits += text[i++];
+        if(i < text.size() && text[i] == '.')
+        {
+            ++i;
+            while(i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])))
+                fraction_digits += text[i++];
+        }
+        if(integer_digits.empty() && fraction_digits.empty())
+            throw std::invalid_argument("not a number: " + text);
+
+        int exponent = 0;
+        if(i < text.size() && (text[i] == 'e' || text[i] == 'E'))
+        {
+            std::size_t length;
+            exponent = std::stoi(text.substr(i + 1), &length);
+            i += 1 + length;
+        }
+        if(i != text.size())
+            throw std::invalid_argument("not a number: " + text);
+
+        // The decimal point goes after  point  digits, which may be before the
+        // first digit or past the last one.  Only the digits down to a little
+        // past the precision of the fraction limbs count, so those further on,
+        // and any leading zeros beyond them, aren't looked at.
+        const std::string digits = integer_digits + fraction_digits;
+        const long long point = static_cast<long long>(integer_digits.size()) + exponent;
+        const long long places = 10LL*fraction_limbs + 2;
+        const long long leading_zeros = std::max(-point, 0LL);
+        const long long first = std::max(point, 0LL);
+        const long long last = std::min(static_cast<long long>(digits.size()),
+                                        first + std::max(places - leading_zeros, 0LL));
+
+        // Accumulate the fraction from the last digit to the first: f = (digit + f)/10
+        BigFixed result(fraction_limbs);
+        for(long long d = last; d-- > first; )
+        {
+            result.limbs_.back() += digits[d] - '0';
+            result.divide(10);
+        }
+        for(long long z = 0; z < leading_zeros && z < places; ++z)
+            result.divide(10);
+
+        // Then the integer part, with zeros past the last digit
+        std::uint64_t integer = 0;
+        for(long long d = 0; d < point; ++d)
+        {
+            if(d >= static_cast<long long>(digits.size()) && integer == 0)
+                break;
+            integer = integer*10 + (d < static_cast<long long>(digits.size()) ? digits[d] - '0' : 0);
+            if(integer >> 32)
+                throw std::out_of_range("number too large: " + text);
+        }
+        result.limbs_.back() = integer;
+
+        result.negative_ = negative && !result.isZero();
+        return result;
+    }
+
+    // A number from its sign and limbs, as negative() and limbs() give them
+    BigFixed(bool negative, const std::vector<std::uint32_t> &limbs)
+        : negative_(negative), limbs_(limbs)
+    {
+        assert(!limbs_.empty());
+        negative_ = negative && !isZero();
+    }
+
+    int fractionLimbs() const {return limbs_.size() - 1;}
+
+    // The sign and the magnitude, least significant limb first, e.g. to save the number
+    bool negative() const {return negative_;}
+    const std::vector<std::uint32_t> &limbs() const {return limbs_;}
+
+    bool isZero() const
+    {
+        for(std::uint32_t limb : limbs_)
+            if(limb)
+                return false;
+        return true;
+    }
+
+    double toDouble() const
+    {
+        // The top three non-zero limbs are enough for double precision
+        double value = 0;
+        int used = 0;
+        for(std::size_t k = limbs_.size(); k-- > 0 && used < 3; )
+        {
+            if(limbs_[k] || used)
+            {
+                value += std::ldexp(static_cast<double>(limbs_[k]), 32*(static_cast<int>(k) - fractionLimbs()));
+                ++used;
+            }
+        }
+        return negative_ ? -value : value;
+    }
+
+    BigFixed operator-() const
+    {
+        BigFixed result(*this);
+        result.negative_ = !negative_ && !isZero();
+        return result;
+    }
+
+    BigFixed operator+(const BigFixed &other) const
+    {
+        assert(limbs_.size() == other.limbs_.size());
+
+        BigFixed result(fractionLimbs());
+        if(negative_ == other.negative_)
+        {
+            addMagnitudes(limbs_, other.limbs_, result.limbs_);
+            result.negative_ = negative_;
+        }
+        else if(compareMagnitudes(limbs_, other.limbs_) >= 0)
+        {
+            subtractMagnitudes(limbs_, other.limbs_, result.limbs_);
+            result.negative_ = negative_;
+        }
+        else
+        {
+            subtractMagnitudes(other.limbs_, limbs_, result.limbs_);
+            result.negative_ = other.negative_;
+        }
+
+        if(result.isZero())
+            result.negative_ = false;
+        return result;
+    }
+
+    BigFixed operator-(const BigFixed &other) const
+    {
+        return *this + (-other);
+    }
+
+    BigFixed operator*(const BigFixed &other) const
+    {
+        assert(limbs_.size() == other.limbs_.size());
+
+        // Schoolbook multiplication, then drop the extra fraction limbs
+        const std::size_t n = limbs_.size();
+        std::vector<std::uint32_t> product(2*n, 0);
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            std::uint64_t carry = 0;
+            for(std::size_t j = 0; j < n; ++j)
+            {
+                std::uint64_t t = static_cast<std::uint64_t>(limbs_[i])*other.limbs_[j] + product[i+j] + carry;
+                product[i+j] = static_cast<std::uint32_t>(t);
+                carry = t >> 32;
+            }
+            product[i+n] = static_cast<std::uint32_t>(carry);
+        }
+
+        BigFixed result(fractionLimbs());
+        for(std::size_t k = 0; k < n; ++k)
+            result.limbs_[k] = product[k + fractionLimbs()];
+        result.negative_ = (negative_ != other.negative_) && !result.isZero();
+        return result;
+    }
+
+    // Multiply by 2 (exactly)
+    BigFixed twice() const
+    {
+        BigFixed result(*this);
+        std::uint32_t carry = 0;
+        for(std::uint32_t &limb : result.limbs_)
+        {
+            std::uint32_t next = limb >> 31;
+            limb = (limb << 1) | carry;
+            carry = next;
+        }
+        return result;
+    }
+
+private:
+
+    // Divide the magnitude by a small integer, rounding down
+    void divide(std::uint32_t divisor)
+    {
+        std::uint64_t remainder = 0;
+        for(std::size_t k = limbs_.size(); k-- > 0; )
+        {
+            std::uint64_t t = (remainder << 32) | limbs_[k];
+            limbs_[k] = static_cast<std::uint32_t>(t / divisor);
+            remainder = t % divisor;
+        }
+    }
+
+    static int compareMagnitudes(const std::vector<std::uint32_t> &a, const std::vector<std::uint32_t> &b)
+    {
+        for(std::size_t k = a.size(); k-- > 0; )
+        {
+            if(a[k] != b[k])
+                return a[k] < b[k] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    static void addMagnitudes(const std::vector<std::uint32_t> &a, const std::vector<std::uint32_t> &b,
+                              std::vector<std::uint32_t> &result)
+    {
+        std::uint64_t carry = 0;
+        for(std::size_t k = 0; k < a.size(); ++k)
+        {
+            std::uint64_t t = static_cast<std::uint64_t>(a[k]) + b[k] + carry;
+            result[k] = static_cast<std::uint32_t>(t);
+            carry = t >> 32;
+        }
+    }
+
+    // a - b, where |a| >= |b|
+    static void subtractMagnitudes(const std::vector<std::uint32_t> &a, const std::vector<std::uint32_t> &b,
+                                   std::vector<std::uint32_t> &result)
+    {
+        std::int64_t borrow = 0;
+        for(std::size_t k = 0; k < a.size(); ++k)
+        {
+            std::int64_t t = static_cast<std::int64_t>(a[k]) - b[k] - borrow;
+            borrow = t < 0;
+            result[k] = static_cast<std::uint32_t>(t + (borrow << 32));
+        }
+    }
+
+    bool negative_;
+    std::vector<std::uint32_t> limbs_;
+};
+
+
+#endif  // BIG_FIXED_H_
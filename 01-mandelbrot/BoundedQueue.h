@@ -0,0 +1,73 @@
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// A first in, first out queue between threads, which holds at most
+// max_size items.  push() blocks while the queue is full, and pop() blocks
+// while it is empty, so a fast producer can't run arbitrarily far ahead of a
+// slow consumer.
+//
+// After close(), push() fails, and pop() fails once the queue has run empty.
+
+template <typename T>
+class BoundedQueue
+{
+public:
+
+    explicit BoundedQueue(std::size_t max_size)
+        : max_size_(max_size > 0 ? max_size : 1), closed_(false)
+    {
+    }
+
+    // Add an item, waiting for room if necessary.  Returns false if the queue was closed.
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]{ return closed_ || items_.size() < max_size_; });
+        if(closed_)
+            return false;
+
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Take the oldest item, waiting for one if necessary.  Returns false if the
+    // queue was closed and is empty.
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this]{ return closed_ || !items_.empty(); });
+        if(items_.empty())
+            return false;
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+
+    const std::size_t max_size_;
+    bool closed_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+
+#endif  // BOUNDED_QUEUE_H_
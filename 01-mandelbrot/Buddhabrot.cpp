@@ -0,0 +1,235 @@
+#include "Buddhabrot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "EscapeTime.h"
+
+
+// The samples of a batch, as many as a task of the thread pool draws
+static const int batch_size = 4096;
+
+
+static std::uint64_t mixBits(std::uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+}
+
+
+// SplitMix64: fast, and good enough for drawing samples.  Every stream is
+// seeded from the seed and a stream number.
+class SampleGenerator
+{
+public:
+
+    SampleGenerator(std::uint64_t seed, std::uint64_t stream)
+        : state_(mixBits(seed + mixBits(stream + 1)))
+    {
+    }
+
+    // A number in [0, 1)
+    double uniform()
+    {
+        state_ += 0x9E3779B97F4A7C15ull;
+        return (mixBits(state_) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+
+    std::uint64_t state_;
+};
+
+
+Buddhabrot::Buddhabrot(double startx, double starty, double width, double height, int image_width,
+                       int image_height, int min_iterations, int max_iterations, std::uint64_t seed)
+    : startx_(startx), starty_(starty), scale_x_(image_width / width), scale_y_(image_height / height),
+      image_width_(image_width), image_height_(image_height), min_iterations_(min_iterations),
+      max_iterations_(max_iterations), seed_(seed), cells_(1), cell_size_(4), cumulative_(1, 1.0),
+      levels_(1, 0), density_(static_cast<std::size_t>(image_width)*image_height, 0), next_batch_(0),
+      samples_(0), visits_(0)
+{
+}
+
+
+int Buddhabrot::iterate(double cx, double cy, double *x, double *y) const
+{
+    if(isInMainCardioidOrBulb(cx, cy))
+        return max_iterations_;
+
+    double zx = 0, zy = 0;
+    for(int n = 0; n < max_iterations_; ++n)
+    {
+        const double zx2 = zx*zx;
+        const double zy2 = zy*zy;
+        if(zx2 + zy2 > 4)
+            return n;
+
+        zy = 2*zx*zy + cy;
+        zx = zx2 - zy2 + cx;
+        x[n] = zx;
+        y[n] = zy;
+    }
+    return max_iterations_;
+}
+
+
+int Buddhabrot::pixel(double x, double y) const
+{
+    const double col = (x - startx_)*scale_x_;
+    const double row = (starty_ - y)*scale_y_;
+    if(!(col >= 0 && col < image_width_ && row >= 0 && row < image_height_))
+        return -1;
+    return static_cast<int>(row)*image_width_ + static_cast<int>(col);
+}
+
+
+void Buddhabrot::buildImportanceMap(ThreadPool &pool, int cells, int probes)
+{
+    // The orbit points of every cell's probes that land in the view
+    std::vector<long long> hits(cells*cells, 0);
+    const double cell_size = 4.0 / cells;
+    for(int row = 0; row < cells; ++row)
+    {
+        pool.submit([&, row]
+        {
+            std::vector<double> x(max_iterations_), y(max_iterations_);
+            for(int col = 0; col < cells; ++col)
+            {
+                // The probes use streams of their own, below the ones of the batches
+                const int cell = row*cells + col;
+                SampleGenerator random(seed_, -1 - static_cast<long long>(cell));
+                for(int probe = 0; probe < probes; ++probe)
+                {
+                    const double cx = -2 + (col + random.uniform())*cell_size;
+                    const double cy = -2 + (row + random.uniform())*cell_size;
+                    const int n = iterate(cx, cy, x.data(), y.data());
+                    if(n < min_iterations_ || n >= max_iterations_)
+                        continue;
+                    for(int i = 0; i + 1 < n; ++i)
+                        hits[cell] += pixel(x[i], y[i]) >= 0;
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    // The best cells get level 0, and every halving of the hits one more
+    const long long best = *std::max_element(hits.begin(), hits.end());
+    cells_ = cells;
+    cell_size_ = cell_size;
+    cumulative_.resize(hits.size());
+    levels_.resize(hits.size());
+    double sum = 0;
+    for(std::size_t cell = 0; cell < hits.size(); ++cell)
+    {
+        int level = max_importance_level;
+        if(hits[cell] > 0)
+            level = std::min(max_importance_level, static_cast<int>(std::floor(std::log2(
+                static_cast<double>(best) / hits[cell]))));
+        levels_[cell] = level;
+        sum += std::ldexp(1.0, -level);
+        cumulative_[cell] = sum;
+    }
+}
+
+
+void Buddhabrot::merge(WorkerDensity &worker)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(std::size_t i = 0; i < density_.size(); ++i)
+        density_[i] += worker.counts[i];
+    std::fill(worker.counts, worker.counts + density_.size(), 0);
+    worker.added = 0;
+}
+
+
+void Buddhabrot::drawBatch(long long batch, int count)
+{
+    WorkerDensity &worker = *workers_[ThreadPool::workerIndex()];
+    SampleGenerator random(seed_, batch);
+    std::vector<double> x(max_iterations_), y(max_iterations_);
+    long long visits = 0;
+
+    for(int sample = 0; sample < count; ++sample)
+    {
+        const double u = random.uniform()*cumulative_.back();
+        const int cell = std::min<std::size_t>(std::upper_bound(cumulative_.begin(), cumulative_.end(), u) -
+                                               cumulative_.begin(), cumulative_.size() - 1);
+        const double cx = -2 + (cell % cells_ + random.uniform())*cell_size_;
+        const double cy = -2 + (cell / cells_ + random.uniform())*cell_size_;
+
+        const int n = iterate(cx, cy, x.data(), y.data());
+        if(n < min_iterations_ || n >= max_iterations_)
+            continue;
+
+        // No count can overflow as long as their sum doesn't
+        const std::uint32_t weight = 1u << levels_[cell];
+        if(worker.added + static_cast<std::uint64_t>(n)*weight > std::numeric_limits<std::uint32_t>::max())
+            merge(worker);
+
+        for(int i = 0; i + 1 < n; ++i)
+        {
+            const int p = pixel(x[i], y[i]);
+            if(p >= 0)
+            {
+                worker.counts[p] += weight;
+                worker.added += weight;
+                ++visits;
+            }
+        }
+    }
+    visits_ += visits;
+}
+
+
+void Buddhabrot::render(ThreadPool &pool, long long samples)
+{
+    // Every worker's counts start on a cache line boundary
+    const std::size_t line = 64 / sizeof(std::uint32_t);
+    while(workers_.size() < pool.size())
+    {
+        std::unique_ptr<WorkerDensity> worker(new WorkerDensity);
+        worker->storage.assign(density_.size() + line, 0);
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(worker->storage.data());
+        worker->counts = worker->storage.data() + (line - address / sizeof(std::uint32_t) % line) % line;
+        worker->added = 0;
+        workers_.push_back(std::move(worker));
+    }
+
+    for(long long start = 0; start < samples; start += batch_size)
+    {
+        const long long batch = next_batch_++;
+        const int count = std::min<long long>(batch_size, samples - start);
+        pool.submit([this, batch, count]{ drawBatch(batch, count); });
+    }
+    pool.wait();
+    samples_ += samples;
+
+    for(std::unique_ptr<WorkerDensity> &worker : workers_)
+        if(worker->added > 0)
+            merge(*worker);
+}
+
+
+std::vector<unsigned char> Buddhabrot::image(double gamma) const
+{
+    std::vector<std::uint64_t> nonzero;
+    for(std::uint64_t d : density_)
+        if(d > 0)
+            nonzero.push_back(d);
+
+    std::vector<unsigned char> gray(density_.size(), 0);
+    if(nonzero.empty())
+        return gray;
+
+    const std::size_t k = (nonzero.size() - 1) * 999 / 1000;
+    std::nth_element(nonzero.begin(), nonzero.begin() + k, nonzero.end());
+    const double reference = nonzero[k];
+
+    for(std::size_t i = 0; i < density_.size(); ++i)
+        gray[i] = std::lround(255*std::pow(std::min(1.0, density_[i] / reference), gamma));
+    return gray;
+}
@@ -0,0 +1,124 @@
+#ifndef BUDDHABROT_H_
+#define BUDDHABROT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Buddhabrot rendering: the density of the orbits of the points outside the
+// Mandelbrot set.
+//
+// Points c are drawn at random from the square [-2, 2] x [-2, 2], and every one
+// whose orbit escapes (|z| > 2, not the escape radius of the escape time
+// kernels) after at least min_iterations and fewer than max_iterations
+// iterations adds the points of its orbit inside the disk that fall in the view
+// to a density buffer.  A clean image takes billions of samples.
+//
+// Every worker of the thread pool counts into a buffer of its own that starts
+// on a cache line of its own, so the workers don't share lines and need no
+// atomics.  The buffers are merged into the total at the end of a render, or
+// before the 32 bit counts of a worker could overflow.  The samples are drawn
+// in batches, each with a generator seeded from the seed and the number of the
+// batch, so the density doesn't depend on the number of threads, only on the
+// seed and the numbers of samples of the renders.
+//
+// Most samples of a zoomed in view have orbits that never come near it.  The
+// importance map (see buildImportanceMap) divides the square into cells,
+// probes how many orbit points of each cell land in the view, and draws the
+// cells in proportion, down to 1/2^max_importance_level as often as the best
+// ones for the cells without any hits, so that no cell is left out.  To keep
+// the density unbiased, the orbit points of a cell that is drawn 2^k times less
+// often than the best ones count 2^k times.  Since the proportions are powers
+// of two, the counts stay whole numbers.
+
+// The importance map: cells across the square, probes per cell, and the
+// level of the cells without hits
+const int importance_cells = 256;
+const int importance_probes = 16;
+const int max_importance_level = 8;
+
+
+class Buddhabrot
+{
+public:
+
+    // A view of the rectangle of the complex plane whose top left corner is
+    // (startx, starty), on an image_width x image_height image
+    Buddhabrot(double startx, double starty, double width, double height, int image_width, int image_height,
+               int min_iterations, int max_iterations, std::uint64_t seed);
+
+    int imageWidth() const {return image_width_;}
+    int imageHeight() const {return image_height_;}
+
+    // Probe the square on the thread pool, and draw the following samples
+    // from the importance map.  Until then, they are drawn uniformly.
+    void buildImportanceMap(ThreadPool &pool, int cells = importance_cells, int probes = importance_probes);
+
+    // Draw  samples  more samples on the thread pool
+    void render(ThreadPool &pool, long long samples);
+
+    // The weighted counts of orbit points per pixel, row by row
+    const std::vector<std::uint64_t> &density() const {return density_;}
+
+    // The samples drawn, and the orbit points that landed in the view
+    // (unweighted; the ratio tells how well the samples are spent)
+    long long samples() const {return samples_;}
+    long long visits() const {return visits_;}
+
+    // The density as 8 bit gray levels:  255 * min(1, d/reference)^gamma,  with
+    // the 99.9th percentile of the nonzero densities as the reference, so that
+    // a few very dense pixels don't darken the rest
+    std::vector<unsigned char> image(double gamma = 0.5) const;
+
+private:
+
+    // The counts of one worker since they were last merged, and their sum
+    struct WorkerDensity
+    {
+        std::vector<std::uint32_t> storage;
+        std::uint32_t *counts;
+        std::uint64_t added;
+
+        // Keeps the next worker's fields off the cache line of  added
+        char padding[64];
+    };
+
+    void drawBatch(long long batch, int count);
+    void merge(WorkerDensity &worker);
+
+    // The orbit points z_1, z_2, ... of c, into (x, y); returns the escape time
+    // n, or max_iterations if c doesn't escape.  Only the first n - 1 points are
+    // counted, since z_n is the one outside the disk.
+    int iterate(double cx, double cy, double *x, double *y) const;
+
+    // The pixel that a point of an orbit lands on, or -1 outside the view
+    int pixel(double x, double y) const;
+
+    const double startx_, starty_;
+    const double scale_x_, scale_y_;
+    const int image_width_, image_height_;
+    const int min_iterations_, max_iterations_;
+    const std::uint64_t seed_;
+
+    // The cells that the samples are drawn from, the cumulative sum of their
+    // proportions, and their levels (a cell drawn 2^-level as often as the best)
+    int cells_;
+    double cell_size_;
+    std::vector<double> cumulative_;
+    std::vector<int> levels_;
+
+    std::vector<std::unique_ptr<WorkerDensity>> workers_;
+    std::mutex mutex_;
+    std::vector<std::uint64_t> density_;
+
+    long long next_batch_;
+    long long samples_;
+    std::atomic<long long> visits_;
+};
+
+
+#endif  // BUDDHABROT_H_
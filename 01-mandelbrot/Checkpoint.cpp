@@ -0,0 +1,363 @@
+#include "Checkpoint.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <zlib.h>
+
+
+// A checkpoint file is the header, the key, and the records
+static const char magic[8] = {'M', 'B', 'C', 'K', 'P', 'T', '0', '1'};
+static const char tile_tag[4] = {'T', 'I', 'L', 'E'};
+static const char orbit_tag[4] = {'O', 'R', 'B', 'T'};
+
+struct CheckpointHeader
+{
+    char magic[8];
+    std::uint32_t key_length;
+    std::uint32_t reserved;
+};
+
+// Every record is its header and  size  bytes of zlib data, which inflate to
+// raw_size bytes: the fields of the record (TileFields or OrbitFields) and
+// its values
+struct RecordHeader
+{
+    char tag[4];
+    std::uint32_t size;
+    std::uint32_t raw_size;
+    std::uint32_t crc;
+};
+
+// Followed by the smooth iteration counts of the tile, and its distances if
+// channels is 2, row by row
+struct TileFields
+{
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t channels;
+};
+
+// Followed by the limbs of the last point, x then y, and the doubles of the
+// points first, first + 1, ..., x then y
+struct OrbitFields
+{
+    std::int32_t first;
+    std::int32_t count;
+    std::int32_t fraction_limbs;
+    std::int32_t negative_x;
+    std::int32_t negative_y;
+};
+
+
+static std::vector<char> compressRecord(const std::vector<char> &raw)
+{
+    uLongf size = compressBound(raw.size());
+    std::vector<char> data(size);
+    if(compress2(reinterpret_cast<Bytef *>(data.data()), &size, reinterpret_cast<const Bytef *>(raw.data()),
+                 raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+        throw std::runtime_error("Can't compress a checkpoint record");
+    data.resize(size);
+    return data;
+}
+
+// Returns false if the data doesn't inflate to exactly raw_size bytes
+static bool uncompressRecord(const std::vector<char> &data, std::size_t raw_size, std::vector<char> &raw)
+{
+    raw.resize(raw_size);
+    uLongf size = raw_size;
+    return uncompress(reinterpret_cast<Bytef *>(raw.data()), &size, reinterpret_cast<const Bytef *>(data.data()),
+                      data.size()) == Z_OK && size == raw_size;
+}
+
+static std::uint32_t checksum(const std::vector<char> &data)
+{
+    return crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef *>(data.data()), data.size());
+}
+
+
+Checkpoint::Checkpoint(const std::string &path, const std::string &key, bool resume, double interval)
+    : path_(path), interval_(interval), file_(nullptr), last_flush_(std::chrono::steady_clock::now()),
+      resumed_tiles_(0), last_x_negative_(false), last_y_negative_(false)
+{
+    std::FILE *existing = resume ? std::fopen(path.c_str(), "rb") : nullptr;
+    if(existing != nullptr)
+    {
+        CheckpointHeader header;
+        std::string existing_key;
+        const bool read = std::fread(&header, sizeof(header), 1, existing) == 1 &&
+                          std::memcmp(header.magic, magic, sizeof(magic)) == 0;
+        if(read && header.key_length <= key.size())
+        {
+            existing_key.resize(header.key_length);
+            if(std::fread(&existing_key[0], 1, header.key_length, existing) != header.key_length)
+                existing_key.clear();
+        }
+        if(!read || existing_key != key)
+        {
+            std::fclose(existing);
+            throw std::runtime_error(path + (read ? " is a checkpoint of another render" : " is not a checkpoint"));
+        }
+
+        // Carry on after the last complete record
+        load(existing);
+        const long end = std::ftell(existing);
+        std::fclose(existing);
+        if(truncate(path.c_str(), end) != 0 || (file_ = std::fopen(path.c_str(), "ab")) == nullptr)
+            throw std::runtime_error("Can't write " + path);
+        return;
+    }
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if(file_ == nullptr)
+        throw std::runtime_error("Can't write " + path);
+
+    CheckpointHeader header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.key_length = key.size();
+    header.reserved = 0;
+    pending_.insert(pending_.end(), reinterpret_cast<const char *>(&header),
+                    reinterpret_cast<const char *>(&header) + sizeof(header));
+    pending_.insert(pending_.end(), key.begin(), key.end());
+    flushLocked();
+}
+
+
+Checkpoint::~Checkpoint()
+{
+    try
+    {
+        flushLocked();
+    }
+    catch(const std::runtime_error &)
+    {
+        // Whatever didn't make it to the disk gets calculated again on resume
+    }
+    std::fclose(file_);
+}
+
+
+// Read the records up to the end of the file, or up to the first one that is
+// incomplete or doesn't add up, and leave the file there
+void Checkpoint::load(std::FILE *file)
+{
+    long end = std::ftell(file);
+    std::fseek(file, 0, SEEK_END);
+    const long file_size = std::ftell(file);
+    std::fseek(file, end, SEEK_SET);
+
+    RecordHeader header;
+    std::vector<char> data, raw;
+    while(std::fread(&header, sizeof(header), 1, file) == 1)
+    {
+        // The sizes aren't covered by the CRC, so don't trust them with memory:
+        // the data must be in the file, and zlib inflates by at most about 1032:1
+        if(header.size > static_cast<unsigned long>(file_size - std::ftell(file)) ||
+           header.raw_size > 1032ull*header.size + 64)
+            break;
+        data.resize(header.size);
+        if(std::fread(data.data(), 1, data.size(), file) != data.size() || checksum(data) != header.crc)
+            break;
+
+        if(std::memcmp(header.tag, tile_tag, sizeof(tile_tag)) == 0)
+        {
+            TileFields fields;
+            if(!uncompressRecord(data, header.raw_size, raw) || raw.size() < sizeof(fields))
+                break;
+            std::memcpy(&fields, raw.data(), sizeof(fields));
+            const TileId id(fields.x, fields.y, fields.width, fields.height, fields.channels == 2);
+            if(tiles_.count(id) == 0)
+                ++resumed_tiles_;
+            tiles_[id] = data;
+        }
+        else if(std::memcmp(header.tag, orbit_tag, sizeof(orbit_tag)) == 0)
+        {
+            OrbitFields fields;
+            if(!uncompressRecord(data, header.raw_size, raw) || raw.size() < sizeof(fields))
+                break;
+            std::memcpy(&fields, raw.data(), sizeof(fields));
+            const std::size_t limbs = fields.fraction_limbs + 1;
+            if(fields.first != static_cast<int>(orbit_x_.size()) ||
+               raw.size() != sizeof(fields) + 2*limbs*sizeof(std::uint32_t) + 2*fields.count*sizeof(double))
+                break;
+
+            const char *values = raw.data() + sizeof(fields);
+            last_x_limbs_.resize(limbs);
+            last_y_limbs_.resize(limbs);
+            std::memcpy(last_x_limbs_.data(), values, limbs*sizeof(std::uint32_t));
+            std::memcpy(last_y_limbs_.data(), values + limbs*sizeof(std::uint32_t), limbs*sizeof(std::uint32_t));
+            last_x_negative_ = fields.negative_x != 0;
+            last_y_negative_ = fields.negative_y != 0;
+
+            values += 2*limbs*sizeof(std::uint32_t);
+            orbit_x_.resize(fields.first + fields.count);
+            orbit_y_.resize(fields.first + fields.count);
+            std::memcpy(orbit_x_.data() + fields.first, values, fields.count*sizeof(double));
+            std::memcpy(orbit_y_.data() + fields.first, values + fields.count*sizeof(double),
+                        fields.count*sizeof(double));
+        }
+        else
+        {
+            break;
+        }
+        end = std::ftell(file);
+    }
+    std::fseek(file, end, SEEK_SET);
+}
+
+
+bool Checkpoint::loadTile(const Tile &tile, float *smooth, float *distance, int stride)
+{
+    std::vector<char> data;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = tiles_.find(TileId(tile.x, tile.y, tile.width, tile.height, distance != nullptr));
+        if(found == tiles_.end())
+            return false;
+        data = found->second;
+    }
+
+    const int channels = distance != nullptr ? 2 : 1;
+    const std::size_t values = static_cast<std::size_t>(tile.width)*tile.height;
+    std::vector<char> raw;
+    if(!uncompressRecord(data, sizeof(TileFields) + channels*values*sizeof(float), raw))
+        return false;
+
+    const char *plane = raw.data() + sizeof(TileFields);
+    for(int channel = 0; channel < channels; ++channel, plane += values*sizeof(float))
+    {
+        float *out = channel == 0 ? smooth : distance;
+        for(int row = 0; row < tile.height; ++row)
+            std::memcpy(out + static_cast<std::size_t>(row)*stride, plane + sizeof(float)*row*tile.width,
+                        sizeof(float)*tile.width);
+    }
+    return true;
+}
+
+
+void Checkpoint::storeTile(const Tile &tile, const float *smooth, const float *distance, int stride)
+{
+    const int channels = distance != nullptr ? 2 : 1;
+    const std::size_t values = static_cast<std::size_t>(tile.width)*tile.height;
+    const TileFields fields = {tile.x, tile.y, tile.width, tile.height, channels};
+
+    std::vector<char> raw(sizeof(fields) + channels*values*sizeof(float));
+    std::memcpy(raw.data(), &fields, sizeof(fields));
+    char *plane = raw.data() + sizeof(fields);
+    for(int channel = 0; channel < channels; ++channel, plane += values*sizeof(float))
+    {
+        const float *in = channel == 0 ? smooth : distance;
+        for(int row = 0; row < tile.height; ++row)
+            std::memcpy(plane + sizeof(float)*row*tile.width, in + static_cast<std::size_t>(row)*stride,
+                        sizeof(float)*tile.width);
+    }
+
+    append(tile_tag, raw);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(dueLocked())
+        flushLocked();
+}
+
+
+bool Checkpoint::loadOrbit(std::vector<double> &x, std::vector<double> &y, BigFixed &last_x, BigFixed &last_y) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(orbit_x_.empty())
+        return false;
+    x = orbit_x_;
+    y = orbit_y_;
+    last_x = BigFixed(last_x_negative_, last_x_limbs_);
+    last_y = BigFixed(last_y_negative_, last_y_limbs_);
+    return true;
+}
+
+
+void Checkpoint::storeOrbit(const ReferenceOrbit &orbit)
+{
+    // Only the points that the checkpoint doesn't have yet
+    const std::vector<std::uint32_t> &x_limbs = orbit.lastX().limbs();
+    const std::vector<std::uint32_t> &y_limbs = orbit.lastY().limbs();
+    std::size_t first;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        first = orbit_x_.size();
+    }
+    if(static_cast<std::size_t>(orbit.size()) < first)
+        throw std::invalid_argument("The orbit is shorter than the one in the checkpoint");
+
+    const OrbitFields fields = {static_cast<std::int32_t>(first), static_cast<std::int32_t>(orbit.size() - first),
+                                orbit.lastX().fractionLimbs(), orbit.lastX().negative(), orbit.lastY().negative()};
+    std::vector<char> raw(sizeof(fields));
+    std::memcpy(raw.data(), &fields, sizeof(fields));
+    auto add = [&raw](const void *values, std::size_t bytes)
+    {
+        raw.insert(raw.end(), static_cast<const char *>(values), static_cast<const char *>(values) + bytes);
+    };
+    add(x_limbs.data(), x_limbs.size()*sizeof(std::uint32_t));
+    add(y_limbs.data(), y_limbs.size()*sizeof(std::uint32_t));
+    add(orbit.x().data() + first, fields.count*sizeof(double));
+    add(orbit.y().data() + first, fields.count*sizeof(double));
+
+    append(orbit_tag, raw);
+    std::lock_guard<std::mutex> lock(mutex_);
+    orbit_x_.insert(orbit_x_.end(), orbit.x().begin() + first, orbit.x().end());
+    orbit_y_.insert(orbit_y_.end(), orbit.y().begin() + first, orbit.y().end());
+    last_x_limbs_ = x_limbs;
+    last_y_limbs_ = y_limbs;
+    last_x_negative_ = orbit.lastX().negative();
+    last_y_negative_ = orbit.lastY().negative();
+    flushLocked();
+}
+
+
+// Compress a record and add it to the ones waiting to be written
+void Checkpoint::append(const char tag[4], const std::vector<char> &raw)
+{
+    const std::vector<char> data = compressRecord(raw);
+    RecordHeader header;
+    std::memcpy(header.tag, tag, sizeof(header.tag));
+    header.size = data.size();
+    header.raw_size = raw.size();
+    header.crc = checksum(data);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.insert(pending_.end(), reinterpret_cast<const char *>(&header),
+                    reinterpret_cast<const char *>(&header) + sizeof(header));
+    pending_.insert(pending_.end(), data.begin(), data.end());
+}
+
+
+bool Checkpoint::due() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dueLocked();
+}
+
+
+bool Checkpoint::dueLocked() const
+{
+    return std::chrono::steady_clock::now() - last_flush_ >= interval_;
+}
+
+
+void Checkpoint::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushLocked();
+}
+
+
+// The mutex must be held (or the checkpoint not yet shared)
+void Checkpoint::flushLocked()
+{
+    last_flush_ = std::chrono::steady_clock::now();
+    if(pending_.empty())
+        return;
+
+    const bool written = std::fwrite(pending_.data(), 1, pending_.size(), file_) == pending_.size();
+    pending_.clear();
+    if(!written || std::fflush(file_) != 0 || fsync(fileno(file_)) != 0)
+        throw std::runtime_error("Can't write " + path_);
+}
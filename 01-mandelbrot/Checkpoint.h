@@ -0,0 +1,108 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "BigFixed.h"
+#include "Perturbation.h"
+#include "Tiles.h"
+
+// Checkpoints of a long render, so that it can resume after the process is
+// killed.
+//
+// A checkpoint is a single file: a header with the key of the render (like the
+// keys of the tile cache, everything its result depends on), followed by
+// records that are only ever appended.  A tile record holds a finished tile's
+// smooth iteration counts, and its distance estimates with distance shading.
+// An orbit record holds the points of the reference orbit since the previous
+// one, and the last of them in full precision, which is all that resuming the
+// orbit takes.  Records are compressed with zlib and carry a CRC-32, so a
+// record that was cut short by the kill is dropped when the checkpoint is
+// loaded, and the file goes on from the last complete one.
+//
+// Records are collected in memory and written (and synced to the disk) once
+// interval seconds have passed since the last write, so checkpointing costs
+// next to nothing, and a kill loses at most the last interval of work.
+//
+// The checkpoint is safe to use from several threads.  Errors while writing
+// are reported with std::runtime_error.
+
+class Checkpoint
+{
+public:
+
+    // Open the checkpoint at path for the render with the given key.  With
+    // resume, the records of an existing checkpoint are loaded; it is an error
+    // (std::runtime_error) if that is of another render.  Otherwise, or if
+    // there is no checkpoint yet, a new one is started.
+    Checkpoint(const std::string &path, const std::string &key, bool resume, double interval);
+
+    // Writes the records that are still in memory
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+
+    // Load a finished tile into rows of  stride  floats: its smooth iteration
+    // counts, and its distance estimates if distance isn't null.  Returns false
+    // if the checkpoint doesn't have the tile (with distances, if asked for).
+    bool loadTile(const Tile &tile, float *smooth, float *distance, int stride);
+
+    // Add a finished tile, given like loadTile returns it
+    void storeTile(const Tile &tile, const float *smooth, const float *distance, int stride);
+
+    // Load the reference orbit so far: the doubles of its points, and the last
+    // one in full precision.  Returns false if the checkpoint has no orbit.
+    bool loadOrbit(std::vector<double> &x, std::vector<double> &y, BigFixed &last_x, BigFixed &last_y) const;
+
+    // Add the points of the orbit since the last call, and write them right
+    // away.  The orbit must be the one that was loaded, or one that started
+    // from scratch in a new checkpoint.
+    void storeOrbit(const ReferenceOrbit &orbit);
+
+    // Whether interval seconds have passed since the last write
+    bool due() const;
+
+    // Write the records that are in memory, and sync the file
+    void flush();
+
+    // The tiles that were loaded from the file when it was opened
+    int resumedTiles() const {return resumed_tiles_;}
+
+private:
+
+    // A tile's position and size, and whether it has distances
+    typedef std::tuple<int, int, int, int, bool> TileId;
+
+    void load(std::FILE *file);
+    void append(const char tag[4], const std::vector<char> &payload);
+    bool dueLocked() const;
+    void flushLocked();
+
+    const std::string path_;
+    const std::chrono::duration<double> interval_;
+
+    mutable std::mutex mutex_;
+    std::FILE *file_;
+    std::vector<char> pending_;
+    std::chrono::steady_clock::time_point last_flush_;
+
+    // The compressed values of the tiles in the checkpoint, by tile
+    std::map<TileId, std::vector<char>> tiles_;
+    int resumed_tiles_;
+
+    // The orbit in the checkpoint
+    std::vector<double> orbit_x_, orbit_y_;
+    std::vector<std::uint32_t> last_x_limbs_, last_y_limbs_;
+    bool last_x_negative_, last_y_negative_;
+};
+
+
+#endif  // CHECKPOINT_H_
@@ -0,0 +1,467 @@
+#include "EscapeTime.h"
+
+#include <cmath>
+#include <limits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ESCAPE_TIME_X86 1
+#include <immintrin.h>
+#else
+#define ESCAPE_TIME_X86 0
+#endif
+
+
+#if ESCAPE_TIME_X86
+
+// The SIMD kernels iterate several adjacent points per register.
+// Each lane keeps iterating until its point escapes or is found to be inside
+// the set, after which the lane is masked off: its z is frozen and its
+// counter stops.  The loop exits as soon as every lane is done.  Leftover
+// points at the end of the array are handled by the scalar kernel.
+//
+// The cardioid/bulb test and the cycle detection are done exactly like in
+// the scalar kernel.  z is saved on the same iterations for every lane, so
+// the schedule is shared by the whole register.
+
+__attribute__((target("avx2")))
+void escapeTimeAvx2(const double *cx, const double *cy, int count,
+                    int max_iterations, int *iterations, double *norm)
+{
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d quarter = _mm256_set1_pd(0.25);
+    const __m256d sixteenth = _mm256_set1_pd(0.0625);
+    const __m256d radius = _mm256_set1_pd(escape_radius_squared);
+    const __m256d tolerance = _mm256_set1_pd(periodicity_tolerance);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    const __m256d max_n = _mm256_set1_pd(max_iterations);
+
+    int i;
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        const __m256d vcx = _mm256_loadu_pd(cx + i);
+        const __m256d vcy = _mm256_loadu_pd(cy + i);
+
+        // Main cardioid and period-2 bulb
+        __m256d xq = _mm256_sub_pd(vcx, quarter);
+        __m256d q = _mm256_add_pd(_mm256_mul_pd(xq, xq), _mm256_mul_pd(vcy, vcy));
+        __m256d cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, xq)),
+                                         _mm256_mul_pd(_mm256_mul_pd(quarter, vcy), vcy), _CMP_LE_OQ);
+        __m256d xb = _mm256_add_pd(vcx, one);
+        __m256d bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(xb, xb), _mm256_mul_pd(vcy, vcy)),
+                                     sixteenth, _CMP_LE_OQ);
+
+        __m256d interior = _mm256_or_pd(cardioid, bulb);
+        __m256d active = _mm256_andnot_pd(interior, all);
+
+        __m256d x = vcx;
+        __m256d y = vcy;
+        __m256d n = _mm256_setzero_pd();
+        __m256d saved_x = x;
+        __m256d saved_y = y;
+        int period = 1;
+        int steps = 0;
+
+        for(int k = 0; k < max_iterations; ++k)
+        {
+            if(_mm256_movemask_pd(active) == 0)
+                break;
+
+            // Same operations, in the same order, as the scalar kernel
+            __m256d xn = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), vcx);
+            __m256d yn = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, x), y), vcy);
+            __m256d r2 = _mm256_add_pd(_mm256_mul_pd(xn, xn), _mm256_mul_pd(yn, yn));
+
+            // Only lanes that are still iterating take the new value of z
+            x = _mm256_blendv_pd(x, xn, active);
+            y = _mm256_blendv_pd(y, yn, active);
+
+            // A lane that escapes on this iteration stops counting
+            active = _mm256_and_pd(active, _mm256_cmp_pd(r2, radius, _CMP_NGT_UQ));
+
+            // So does a lane whose orbit came back to the saved point
+            __m256d cycle = _mm256_and_pd(
+                _mm256_cmp_pd(_mm256_andnot_pd(sign, _mm256_sub_pd(x, saved_x)), tolerance, _CMP_LT_OQ),
+                _mm256_cmp_pd(_mm256_andnot_pd(sign, _mm256_sub_pd(y, saved_y)), tolerance, _CMP_LT_OQ));
+            cycle = _mm256_and_pd(active, cycle);
+            interior = _mm256_or_pd(interior, cycle);
+            active = _mm256_andnot_pd(cycle, active);
+
+            n = _mm256_add_pd(n, _mm256_and_pd(active, one));
+
+            if(++steps == period)
+            {
+                saved_x = x;
+                saved_y = y;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        n = _mm256_blendv_pd(n, max_n, interior);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(iterations + i), _mm256_cvtpd_epi32(n));
+        _mm256_storeu_pd(norm + i, _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)));
+    }
+
+    escapeTimeScalar(cx + i, cy + i, count - i, max_iterations, iterations + i, norm + i);
+}
+
+
+__attribute__((target("avx512f")))
+void escapeTimeAvx512(const double *cx, const double *cy, int count,
+                      int max_iterations, int *iterations, double *norm)
+{
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d quarter = _mm512_set1_pd(0.25);
+    const __m512d sixteenth = _mm512_set1_pd(0.0625);
+    const __m512d radius = _mm512_set1_pd(escape_radius_squared);
+    const __m512d tolerance = _mm512_set1_pd(periodicity_tolerance);
+    const __m512d max_n = _mm512_set1_pd(max_iterations);
+
+    int i;
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        const __m512d vcx = _mm512_loadu_pd(cx + i);
+        const __m512d vcy = _mm512_loadu_pd(cy + i);
+
+        // Main cardioid and period-2 bulb
+        __m512d xq = _mm512_sub_pd(vcx, quarter);
+        __m512d q = _mm512_add_pd(_mm512_mul_pd(xq, xq), _mm512_mul_pd(vcy, vcy));
+        __mmask8 cardioid = _mm512_cmp_pd_mask(_mm512_mul_pd(q, _mm512_add_pd(q, xq)),
+                                               _mm512_mul_pd(_mm512_mul_pd(quarter, vcy), vcy), _CMP_LE_OQ);
+        __m512d xb = _mm512_add_pd(vcx, one);
+        __mmask8 bulb = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(xb, xb), _mm512_mul_pd(vcy, vcy)),
+                                           sixteenth, _CMP_LE_OQ);
+
+        __mmask8 interior = cardioid | bulb;
+        __mmask8 active = ~interior;
+
+        __m512d x = vcx;
+        __m512d y = vcy;
+        __m512d n = _mm512_setzero_pd();
+        __m512d saved_x = x;
+        __m512d saved_y = y;
+        int period = 1;
+        int steps = 0;
+
+        for(int k = 0; k < max_iterations; ++k)
+        {
+            if(active == 0)
+                break;
+
+            // Same operations, in the same order, as the scalar kernel.
+            // Lanes that are no longer active keep their old value of z.
+            __m512d xn = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y)), vcx);
+            __m512d yn = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, x), y), vcy);
+            x = _mm512_mask_mov_pd(x, active, xn);
+            y = _mm512_mask_mov_pd(y, active, yn);
+
+            __m512d r2 = _mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y));
+            active = _mm512_mask_cmp_pd_mask(active, r2, radius, _CMP_NGT_UQ);
+
+            __mmask8 cycle = _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(_mm512_sub_pd(x, saved_x)),
+                                                     tolerance, _CMP_LT_OQ);
+            cycle = _mm512_mask_cmp_pd_mask(cycle, _mm512_abs_pd(_mm512_sub_pd(y, saved_y)),
+                                            tolerance, _CMP_LT_OQ);
+            interior |= cycle;
+            active &= ~cycle;
+
+            n = _mm512_mask_add_pd(n, active, n, one);
+
+            if(++steps == period)
+            {
+                saved_x = x;
+                saved_y = y;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        n = _mm512_mask_mov_pd(n, interior, max_n);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(iterations + i), _mm512_cvtpd_epi32(n));
+        _mm512_storeu_pd(norm + i, _mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y)));
+    }
+
+    escapeTimeScalar(cx + i, cy + i, count - i, max_iterations, iterations + i, norm + i);
+}
+
+
+// The single precision kernels work the same way, with 8 or 16 lanes.  The
+// counters are integers, since a float can't count past 2^24.
+
+__attribute__((target("avx2")))
+void escapeTimeFloatAvx2(const double *cx, const double *cy, int count,
+                         int max_iterations, int *iterations, double *norm)
+{
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 sixteenth = _mm256_set1_ps(0.0625f);
+    const __m256 radius = _mm256_set1_ps(escape_radius_squared);
+    const __m256 tolerance = _mm256_set1_ps(float_periodicity_tolerance);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    const __m256i max_n = _mm256_set1_epi32(max_iterations);
+
+    int i;
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        const __m256 vcx = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_loadu_pd(cx + i))),
+                                                _mm256_cvtpd_ps(_mm256_loadu_pd(cx + i + 4)), 1);
+        const __m256 vcy = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_loadu_pd(cy + i))),
+                                                _mm256_cvtpd_ps(_mm256_loadu_pd(cy + i + 4)), 1);
+
+        // Main cardioid and period-2 bulb
+        __m256 xq = _mm256_sub_ps(vcx, quarter);
+        __m256 q = _mm256_add_ps(_mm256_mul_ps(xq, xq), _mm256_mul_ps(vcy, vcy));
+        __m256 cardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, xq)),
+                                        _mm256_mul_ps(_mm256_mul_ps(quarter, vcy), vcy), _CMP_LE_OQ);
+        __m256 xb = _mm256_add_ps(vcx, one);
+        __m256 bulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(xb, xb), _mm256_mul_ps(vcy, vcy)),
+                                    sixteenth, _CMP_LE_OQ);
+
+        __m256 interior = _mm256_or_ps(cardioid, bulb);
+        __m256 active = _mm256_andnot_ps(interior, all);
+
+        __m256 x = vcx;
+        __m256 y = vcy;
+        __m256i n = _mm256_setzero_si256();
+        __m256 saved_x = x;
+        __m256 saved_y = y;
+        int period = 1;
+        int steps = 0;
+
+        for(int k = 0; k < max_iterations; ++k)
+        {
+            if(_mm256_movemask_ps(active) == 0)
+                break;
+
+            __m256 xn = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), vcx);
+            __m256 yn = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, x), y), vcy);
+            __m256 r2 = _mm256_add_ps(_mm256_mul_ps(xn, xn), _mm256_mul_ps(yn, yn));
+
+            x = _mm256_blendv_ps(x, xn, active);
+            y = _mm256_blendv_ps(y, yn, active);
+
+            active = _mm256_and_ps(active, _mm256_cmp_ps(r2, radius, _CMP_NGT_UQ));
+
+            __m256 cycle = _mm256_and_ps(
+                _mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(x, saved_x)), tolerance, _CMP_LT_OQ),
+                _mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(y, saved_y)), tolerance, _CMP_LT_OQ));
+            cycle = _mm256_and_ps(active, cycle);
+            interior = _mm256_or_ps(interior, cycle);
+            active = _mm256_andnot_ps(cycle, active);
+
+            // Active lanes are all ones, which is -1
+            n = _mm256_sub_epi32(n, _mm256_castps_si256(active));
+
+            if(++steps == period)
+            {
+                saved_x = x;
+                saved_y = y;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        n = _mm256_blendv_epi8(n, max_n, _mm256_castps_si256(interior));
+
+        const __m256 r2 = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(iterations + i), n);
+        _mm256_storeu_pd(norm + i, _mm256_cvtps_pd(_mm256_castps256_ps128(r2)));
+        _mm256_storeu_pd(norm + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(r2, 1)));
+    }
+
+    escapeTimeFloat(cx + i, cy + i, count - i, max_iterations, iterations + i, norm + i);
+}
+
+
+// Load 16 doubles as floats
+__attribute__((target("avx512f")))
+static inline __m512 loadFloats(const double *p)
+{
+    const __m256 low = _mm512_cvtpd_ps(_mm512_loadu_pd(p));
+    const __m256 high = _mm512_cvtpd_ps(_mm512_loadu_pd(p + 8));
+    return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(low)),
+                                               _mm256_castps_pd(high), 1));
+}
+
+
+__attribute__((target("avx512f")))
+void escapeTimeFloatAvx512(const double *cx, const double *cy, int count,
+                           int max_iterations, int *iterations, double *norm)
+{
+    const __m512 two = _mm512_set1_ps(2.0f);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+    const __m512 sixteenth = _mm512_set1_ps(0.0625f);
+    const __m512 radius = _mm512_set1_ps(escape_radius_squared);
+    const __m512 tolerance = _mm512_set1_ps(float_periodicity_tolerance);
+    const __m512i one_n = _mm512_set1_epi32(1);
+    const __m512i max_n = _mm512_set1_epi32(max_iterations);
+
+    int i;
+    for(i = 0; i + 16 <= count; i += 16)
+    {
+        const __m512 vcx = loadFloats(cx + i);
+        const __m512 vcy = loadFloats(cy + i);
+
+        // Main cardioid and period-2 bulb
+        __m512 xq = _mm512_sub_ps(vcx, quarter);
+        __m512 q = _mm512_add_ps(_mm512_mul_ps(xq, xq), _mm512_mul_ps(vcy, vcy));
+        __mmask16 cardioid = _mm512_cmp_ps_mask(_mm512_mul_ps(q, _mm512_add_ps(q, xq)),
+                                                _mm512_mul_ps(_mm512_mul_ps(quarter, vcy), vcy), _CMP_LE_OQ);
+        __m512 xb = _mm512_add_ps(vcx, one);
+        __mmask16 bulb = _mm512_cmp_ps_mask(_mm512_add_ps(_mm512_mul_ps(xb, xb), _mm512_mul_ps(vcy, vcy)),
+                                            sixteenth, _CMP_LE_OQ);
+
+        __mmask16 interior = cardioid | bulb;
+        __mmask16 active = ~interior;
+
+        __m512 x = vcx;
+        __m512 y = vcy;
+        __m512i n = _mm512_setzero_si512();
+        __m512 saved_x = x;
+        __m512 saved_y = y;
+        int period = 1;
+        int steps = 0;
+
+        for(int k = 0; k < max_iterations; ++k)
+        {
+            if(active == 0)
+                break;
+
+            __m512 xn = _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y)), vcx);
+            __m512 yn = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(two, x), y), vcy);
+            x = _mm512_mask_mov_ps(x, active, xn);
+            y = _mm512_mask_mov_ps(y, active, yn);
+
+            __m512 r2 = _mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y));
+            active = _mm512_mask_cmp_ps_mask(active, r2, radius, _CMP_NGT_UQ);
+
+            __mmask16 cycle = _mm512_mask_cmp_ps_mask(active, _mm512_abs_ps(_mm512_sub_ps(x, saved_x)),
+                                                      tolerance, _CMP_LT_OQ);
+            cycle = _mm512_mask_cmp_ps_mask(cycle, _mm512_abs_ps(_mm512_sub_ps(y, saved_y)),
+                                            tolerance, _CMP_LT_OQ);
+            interior |= cycle;
+            active &= ~cycle;
+
+            n = _mm512_mask_add_epi32(n, active, n, one_n);
+
+            if(++steps == period)
+            {
+                saved_x = x;
+                saved_y = y;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        n = _mm512_mask_mov_epi32(n, interior, max_n);
+
+        const __m512 r2 = _mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y));
+        _mm512_storeu_si512(iterations + i, n);
+        _mm512_storeu_pd(norm + i, _mm512_cvtps_pd(_mm512_castps512_ps256(r2)));
+        _mm512_storeu_pd(norm + i + 8,
+                         _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(r2), 1))));
+    }
+
+    escapeTimeFloat(cx + i, cy + i, count - i, max_iterations, iterations + i, norm + i);
+}
+
+
+bool cpuSupportsAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+bool cpuSupportsAvx512()
+{
+    return __builtin_cpu_supports("avx512f");
+}
+
+#else
+
+// No SIMD kernels on this platform; fall back to the scalar kernel.
+
+void escapeTimeAvx2(const double *cx, const double *cy, int count,
+                    int max_iterations, int *iterations, double *norm)
+{
+    escapeTimeScalar(cx, cy, count, max_iterations, iterations, norm);
+}
+
+void escapeTimeAvx512(const double *cx, const double *cy, int count,
+                      int max_iterations, int *iterations, double *norm)
+{
+    escapeTimeScalar(cx, cy, count, max_iterations, iterations, norm);
+}
+
+void escapeTimeFloatAvx2(const double *cx, const double *cy, int count,
+                         int max_iterations, int *iterations, double *norm)
+{
+    escapeTimeFloat(cx, cy, count, max_iterations, iterations, norm);
+}
+
+void escapeTimeFloatAvx512(const double *cx, const double *cy, int count,
+                           int max_iterations, int *iterations, double *norm)
+{
+    escapeTimeFloat(cx, cy, count, max_iterations, iterations, norm);
+}
+
+bool cpuSupportsAvx2() {return false;}
+bool cpuSupportsAvx512() {return false;}
+
+#endif
+
+
+EscapeKernel selectEscapeKernel()
+{
+    if(cpuSupportsAvx512())
+        return escapeTimeAvx512;
+    if(cpuSupportsAvx2())
+        return escapeTimeAvx2;
+    return escapeTimeScalar;
+}
+
+
+EscapeKernel selectFloatEscapeKernel()
+{
+    if(cpuSupportsAvx512())
+        return escapeTimeFloatAvx512;
+    if(cpuSupportsAvx2())
+        return escapeTimeFloatAvx2;
+    return escapeTimeFloat;
+}
+
+
+Precision selectPrecision(double pixel_spacing)
+{
+    const double escape_radius = std::sqrt(escape_radius_squared);
+    if(pixel_spacing >= precision_margin*std::numeric_limits<float>::epsilon()*escape_radius)
+        return Precision::float32;
+    if(pixel_spacing >= precision_margin*std::numeric_limits<double>::epsilon()*escape_radius)
+        return Precision::float64;
+    return Precision::extended;
+}
+
+
+const char *escapeKernelName(EscapeKernel kernel)
+{
+    if(kernel == escapeTimeAvx512)
+        return "AVX-512";
+    if(kernel == escapeTimeAvx2)
+        return "AVX2";
+    if(kernel == escapeTimeScalar)
+        return "scalar";
+    if(kernel == escapeTimeFloatAvx512)
+        return "single precision AVX-512";
+    if(kernel == escapeTimeFloatAvx2)
+        return "single precision AVX2";
+    if(kernel == escapeTimeFloat)
+        return "single precision scalar";
+    return "unknown";
+}
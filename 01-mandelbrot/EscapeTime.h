@@ -0,0 +1,517 @@
+#ifndef ESCAPE_TIME_H_
+#define ESCAPE_TIME_H_
+
+#include <math.h>
+#include <string>
+
+#include "MultiDouble.h"
+
+// Escape time kernels for the Mandelbrot set, and an escape time loop for the
+// other fractal families below.
+//
+// A kernel calculates the escape time of  count  points (cx[i], cy[i]).
+// On return, iterations[i] holds the escape time n of point i
+// (max_iterations if the point never escaped) and norm[i] holds x*x + y*y
+// for the final value of z, which is needed for the smooth shading.
+//
+// Every kernel performs exactly the same floating point operations in the
+// same order as the scalar kernel, so all of them produce identical output.
+
+typedef void (*EscapeKernel)(const double *cx, const double *cy, int count,
+                             int max_iterations, int *iterations, double *norm);
+
+
+// The squared radius beyond which a point is considered to have escaped
+const double escape_radius_squared = 256;
+
+// Points inside the set never escape, so they would normally run for the full
+// max_iterations.  The kernels cut that short in two ways:
+//
+//  - Points in the main cardioid or the period-2 bulb are recognized
+//    analytically before iterating at all.
+//
+//  - Brent's cycle detection: z is saved at iterations 1, 2, 4, 8, ..., and
+//    if z comes back to (within periodicity_tolerance of) the saved value,
+//    the orbit has fallen into a cycle and will never escape.
+//
+// Either way the point gets n = max_iterations, exactly as if it had been
+// iterated all the way, so the rendered image doesn't change.
+const double periodicity_tolerance = 1e-13;
+
+
+template <>
+struct RealTraits<double>
+{
+    static const char *name() {return "double";}
+    static double toDouble(double x) {return x;}
+    static double fromString(const std::string &text) {return std::stod(text);}
+    static double periodicityTolerance() {return periodicity_tolerance;}
+};
+
+// Single precision can't get within 1e-13 of a cycle, so it gets a tolerance
+// of its own.  It is a power of two, so comparing against it gives the same
+// answer in float and in double.
+const double float_periodicity_tolerance = 1.0/131072;
+
+template <>
+struct RealTraits<float>
+{
+    static const char *name() {return "float";}
+    static double toDouble(float x) {return x;}
+    static float fromString(const std::string &text) {return std::stof(text);}
+    static double periodicityTolerance() {return float_periodicity_tolerance;}
+};
+
+
+template <typename Real>
+inline bool isInMainCardioidOrBulb(const Real &cx, const Real &cy)
+{
+    // Main cardioid
+    const Real x = cx - 0.25;
+    const Real q = x*x + cy*cy;
+    if(q*(q + x) <= 0.25*cy*cy)
+        return true;
+
+    // Period-2 bulb: the disk of radius 1/4 centered on -1
+    return (cx + 1)*(cx + 1) + cy*cy <= 0.0625;
+}
+
+// The same in single precision, without any of it being done in double, like
+// in the single precision SIMD kernels
+inline bool isInMainCardioidOrBulb(const float &cx, const float &cy)
+{
+    const float x = cx - 0.25f;
+    const float q = x*x + cy*cy;
+    if(q*(q + x) <= 0.25f*cy*cy)
+        return true;
+
+    return (cx + 1)*(cx + 1) + cy*cy <= 0.0625f;
+}
+
+
+// Fractal families.  The escape time loop is a template on one of these
+// policies, so every family gets an inner loop of its own with its iteration
+// inlined (and for the multibrots, the power unrolled), instead of a generic
+// loop that branches on the family at every iteration.  A policy has
+//
+//   start(px, py, x, y, cx, cy)   the first z and the c of the point p of the view
+//   step(x, y, cx, cy)            z <- f(z) + c
+//   inside(px, py)                whether p is known to never escape, without
+//                                 iterating it (it may always say no)
+//   degree                        the degree of f, for the smooth iteration count
+//
+// The families of the parameter plane start from z = c, the value after the
+// first iteration from 0, so that the escape times of the Mandelbrot set are
+// the ones the SIMD kernels give.  The Julia sets start from z = p.
+
+struct Mandelbrot
+{
+    static const int degree = 2;
+
+    template <typename Real>
+    void start(const Real &px, const Real &py, Real &x, Real &y, Real &cx, Real &cy) const
+    {
+        x = cx = px;
+        y = cy = py;
+    }
+
+    template <typename Real>
+    void step(Real &x, Real &y, const Real &cx, const Real &cy) const
+    {
+        const Real temp = x;
+        x = x*x - y*y + cx;
+        y = 2*temp*y + cy;
+    }
+
+    template <typename Real>
+    bool inside(const Real &px, const Real &py) const
+    {
+        return isInMainCardioidOrBulb(px, py);
+    }
+};
+
+
+// The filled Julia set of a fixed c.  c is a double whatever the number type
+// of the points, so deep zooms show the Julia set of exactly that double.
+struct Julia
+{
+    static const int degree = 2;
+
+    Julia(double cx, double cy) : cx_(cx), cy_(cy) {}
+
+    template <typename Real>
+    void start(const Real &px, const Real &py, Real &x, Real &y, Real &cx, Real &cy) const
+    {
+        x = px;
+        y = py;
+        cx = cx_;
+        cy = cy_;
+    }
+
+    template <typename Real>
+    void step(Real &x, Real &y, const Real &cx, const Real &cy) const
+    {
+        const Real temp = x;
+        x = x*x - y*y + cx;
+        y = 2*temp*y + cy;
+    }
+
+    template <typename Real>
+    bool inside(const Real &, const Real &) const
+    {
+        return false;
+    }
+
+private:
+
+    double cx_, cy_;
+};
+
+
+// (x + iy)^D, unrolled at compile time into repeated squaring
+template <int D>
+struct ComplexPower
+{
+    template <typename Real>
+    static void apply(const Real &x, const Real &y, Real &px, Real &py)
+    {
+        Real hx, hy;
+        ComplexPower<D/2>::apply(x, y, hx, hy);
+        const Real sx = hx*hx - hy*hy;
+        const Real sy = 2*hx*hy;
+        if(D % 2 == 0)
+        {
+            px = sx;
+            py = sy;
+        }
+        else
+        {
+            px = sx*x - sy*y;
+            py = sx*y + sy*x;
+        }
+    }
+};
+
+template <>
+struct ComplexPower<1>
+{
+    template <typename Real>
+    static void apply(const Real &x, const Real &y, Real &px, Real &py)
+    {
+        px = x;
+        py = y;
+    }
+};
+
+
+// The multibrot set of z^D + c
+template <int D>
+struct Multibrot
+{
+    static_assert(D >= 2, "a multibrot has a degree of at least 2");
+    static const int degree = D;
+
+    template <typename Real>
+    void start(const Real &px, const Real &py, Real &x, Real &y, Real &cx, Real &cy) const
+    {
+        x = cx = px;
+        y = cy = py;
+    }
+
+    template <typename Real>
+    void step(Real &x, Real &y, const Real &cx, const Real &cy) const
+    {
+        Real px, py;
+        ComplexPower<D>::apply(x, y, px, py);
+        x = px + cx;
+        y = py + cy;
+    }
+
+    template <typename Real>
+    bool inside(const Real &, const Real &) const
+    {
+        return false;
+    }
+};
+
+
+// The burning ship: z <- (|x| + i|y|)^2 + c.  The usual pictures have the
+// imaginary axis pointing down, so with the window's y pointing up, the ship
+// is upside down.
+struct BurningShip
+{
+    static const int degree = 2;
+
+    template <typename Real>
+    void start(const Real &px, const Real &py, Real &x, Real &y, Real &cx, Real &cy) const
+    {
+        x = cx = px;
+        y = cy = py;
+    }
+
+    template <typename Real>
+    void step(Real &x, Real &y, const Real &cx, const Real &cy) const
+    {
+        const Real temp = x;
+        x = x*x - y*y + cx;
+        y = 2*fabs(temp*y) + cy;
+    }
+
+    template <typename Real>
+    bool inside(const Real &, const Real &) const
+    {
+        return false;
+    }
+};
+
+
+// The escape time loop of a fractal family, for any of the number types in
+// MultiDouble.h
+template <typename Fractal, typename Real>
+inline void escapeTime(const Fractal &fractal, const Real *px, const Real *py, int count,
+                       int max_iterations, int *iterations, double *norm)
+{
+    const double tolerance = RealTraits<Real>::periodicityTolerance();
+    int i, n;
+    Real x, y, cx, cy;
+    Real saved_x, saved_y;
+    int period, steps;
+
+    for(i = 0; i < count; ++i)
+    {
+        fractal.start(px[i], py[i], x, y, cx, cy);
+
+        if(fractal.inside(px[i], py[i]))
+        {
+            iterations[i] = max_iterations;
+            norm[i] = RealTraits<Real>::toDouble(x*x + y*y);
+            continue;
+        }
+
+        saved_x = x;
+        saved_y = y;
+        period = 1;
+        steps = 0;
+
+        for(n = 0; n < max_iterations; ++n)
+        {
+            fractal.step(x, y, cx, cy);
+
+            if (x*x + y*y > escape_radius_squared)
+                break;
+
+            // Check whether the orbit has come back to the saved point
+            if(fabs(x - saved_x) < tolerance && fabs(y - saved_y) < tolerance)
+            {
+                n = max_iterations;
+                break;
+            }
+
+            if(++steps == period)
+            {
+                saved_x = x;
+                saved_y = y;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        iterations[i] = n;
+        norm[i] = RealTraits<Real>::toDouble(x*x + y*y);
+    }
+}
+
+
+// The escape time loop of the Mandelbrot set, for any of the number types in
+// MultiDouble.h.  With Real = double this is the scalar kernel.
+template <typename Real>
+inline void escapeTime(const Real *cx, const Real *cy, int count,
+                       int max_iterations, int *iterations, double *norm)
+{
+    escapeTime(Mandelbrot(), cx, cy, count, max_iterations, iterations, norm);
+}
+
+
+// The same loop, also tracking the derivative dz/dc, for the exterior distance
+// estimate.  A point that escapes with z gets
+//
+//     distance = |z| log|z| / |dz/dc|,
+//
+// which is between about half and twice its distance to the set (exactly so
+// in the limit of a large escape radius).  So a pixel whose distance is below
+// the pixel spacing has a piece of the set, such as a filament far too thin
+// for the escape times to catch, running through it.
+// Points that never escape get distance 0.  The derivative is kept in double
+// whatever Real is, since only its magnitude matters.  iterations and norm are
+// exactly those of escapeTime.
+template <typename Real>
+inline void escapeTimeWithDistance(const Real *cx, const Real *cy, int count, int max_iterations,
+                                   int *iterations, double *norm, double *distance)
+{
+    const double tolerance = RealTraits<Real>::periodicityTolerance();
+    int i, n;
+    Real x, y, temp;
+    Real saved_x, saved_y;
+    int period, steps;
+    double dx, dy, dtemp, zx, zy;
+
+    for(i = 0; i < count; ++i)
+    {
+        x = cx[i];
+        y = cy[i];
+
+        if(isInMainCardioidOrBulb(x, y))
+        {
+            iterations[i] = max_iterations;
+            norm[i] = RealTraits<Real>::toDouble(x*x + y*y);
+            distance[i] = 0;
+            continue;
+        }
+
+        saved_x = x;
+        saved_y = y;
+        period = 1;
+        steps = 0;
+
+        // z starts out as c, so dz/dc starts out as 1
+        dx = 1;
+        dy = 0;
+
+        for(n = 0; n < max_iterations; ++n)
+        {
+            // dz/dc <- 2 z dz/dc + 1
+            zx = RealTraits<Real>::toDouble(x);
+            zy = RealTraits<Real>::toDouble(y);
+            dtemp = dx;
+            dx = 2*(zx*dx - zy*dy) + 1;
+            dy = 2*(zx*dy + zy*dtemp);
+
+            temp = x;
+            x = x*x - y*y + cx[i];
+            y = 2*temp*y + cy[i];
+
+            if (x*x + y*y > escape_radius_squared)
+                break;
+
+            if(fabs(x - saved_x) < tolerance && fabs(y - saved_y) < tolerance)
+            {
+                n = max_iterations;
+                break;
+            }
+
+            if(++steps == period)
+            {
+                saved_x = x;
+                saved_y = y;
+                steps = 0;
+                period *= 2;
+            }
+        }
+
+        iterations[i] = n;
+        norm[i] = RealTraits<Real>::toDouble(x*x + y*y);
+        if(n == max_iterations)
+        {
+            distance[i] = 0;
+        }
+        else
+        {
+            const double r = sqrt(norm[i]);
+            distance[i] = r*log(r) / sqrt(dx*dx + dy*dy);
+        }
+    }
+}
+
+
+inline void escapeTimeScalar(const double *cx, const double *cy, int count,
+                             int max_iterations, int *iterations, double *norm)
+{
+    escapeTime(cx, cy, count, max_iterations, iterations, norm);
+}
+
+
+// SIMD kernels (see EscapeTime.cpp)
+// These may only be called if the CPU supports the corresponding instruction set.
+void escapeTimeAvx2(const double *cx, const double *cy, int count,
+                    int max_iterations, int *iterations, double *norm);
+void escapeTimeAvx512(const double *cx, const double *cy, int count,
+                      int max_iterations, int *iterations, double *norm);
+
+bool cpuSupportsAvx2();
+bool cpuSupportsAvx512();
+
+
+// Single precision kernels.  They take and return doubles like the others,
+// but round the points to float and iterate in float, so the SIMD kernels fit
+// twice as many points in a register.  Float is only good enough for shallow
+// views (see selectPrecision).  The SIMD kernels produce exactly the same
+// output as escapeTimeFloat.
+inline void escapeTimeFloat(const double *cx, const double *cy, int count,
+                            int max_iterations, int *iterations, double *norm)
+{
+    const int chunk = 256;
+    float fcx[chunk], fcy[chunk];
+    for(int start = 0; start < count; start += chunk)
+    {
+        const int length = count - start < chunk ? count - start : chunk;
+        for(int i = 0; i < length; ++i)
+        {
+            fcx[i] = cx[start + i];
+            fcy[i] = cy[start + i];
+        }
+        escapeTime(fcx, fcy, length, max_iterations, iterations + start, norm + start);
+    }
+}
+
+void escapeTimeFloatAvx2(const double *cx, const double *cy, int count,
+                         int max_iterations, int *iterations, double *norm);
+void escapeTimeFloatAvx512(const double *cx, const double *cy, int count,
+                           int max_iterations, int *iterations, double *norm);
+
+
+// Get the widest escape time kernel that the current CPU supports, in double
+// or in single precision
+EscapeKernel selectEscapeKernel();
+EscapeKernel selectFloatEscapeKernel();
+
+// Get a human readable name for one of the kernels above
+const char *escapeKernelName(EscapeKernel kernel);
+
+
+// The number types that a view can be calculated in: single or double
+// precision, or one of the wider types of MultiDouble.h
+enum class Precision
+{
+    float32,
+    float64,
+    extended
+};
+
+// The rounding error of z near the escape radius must be this many times
+// smaller than the pixel spacing for a precision to be good enough
+const double precision_margin = 256;
+
+// The narrowest precision that renders a view with the given pixel spacing
+// without visible artifacts: float or double if the spacing is at least
+// precision_margin times their epsilon times the escape radius, and the wider
+// types below that
+Precision selectPrecision(double pixel_spacing);
+
+
+// Calculate escape times with the given kernel for doubles, or with the
+// generic escape time loop for the wider number types
+template <typename Real>
+inline void calculateEscapeTimes(EscapeKernel /*kernel*/, const Real *cx, const Real *cy, int count,
+                                 int max_iterations, int *iterations, double *norm)
+{
+    escapeTime(cx, cy, count, max_iterations, iterations, norm);
+}
+
+inline void calculateEscapeTimes(EscapeKernel kernel, const double *cx, const double *cy, int count,
+                                 int max_iterations, int *iterations, double *norm)
+{
+    kernel(cx, cy, count, max_iterations, iterations, norm);
+}
+
+
+#endif  // ESCAPE_TIME_H_
@@ -0,0 +1,181 @@
+#ifndef EXP_MAP_H_
+#define EXP_MAP_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Palette.h"
+#include "ThreadPool.h"
+#include "Tiles.h"
+
+// Exponential map rendering of zoom animations.
+//
+// All the frames of a zoom into one center are cut out of a single log-polar
+// strip: column j of the strip is the angle 2 pi j / columns around the center,
+// and row i is the radius  outer_radius * exp(-2 pi i / columns),  so the
+// samples are square and every row is the one above it, shrunk by the same
+// factor.  The strip runs from the corners of the first frame down to about a
+// pixel of the last one, so every point of the zoom is calculated once, rather
+// than once for every frame it appears in.
+//
+// A frame is resampled from the colored strip with bilinear interpolation.  The
+// strip has the most samples per pixel near the center of a frame and the
+// fewest in the corners, where there is about one sample per pixel when
+// columns is 2 pi times the half diagonal of a frame in pixels.
+//
+// The points are in double precision, so this is for zooms down to about 1e-12.
+
+class ExpMapStrip
+{
+public:
+
+    // A strip around (center_x, center_y) from outer_radius down to inner_radius
+    ExpMapStrip(double center_x, double center_y, double outer_radius, double inner_radius, int columns)
+        : center_x_(center_x), center_y_(center_y), outer_radius_(outer_radius), columns_(columns),
+          rows_(std::ceil(std::log(outer_radius / inner_radius) / rowStep()) + 1),
+          smooth_(static_cast<std::size_t>(columns_)*rows_), frame_width_(0), frame_height_(0)
+    {
+    }
+
+    // The number of columns needed for about one sample per pixel in the
+    // corners of width x height frames
+    static int columnsFor(int width, int height)
+    {
+        return std::ceil(M_PI * std::hypot(width, height));
+    }
+
+    int columns() const {return columns_;}
+    int rows() const {return rows_;}
+
+    // The point of the complex plane at (col, row) of the strip
+    void point(double col, double row, double &cx, double &cy) const
+    {
+        const double angle = 2*M_PI * col / columns_;
+        const double radius = outer_radius_ * std::exp(-row * rowStep());
+        cx = center_x_ + radius*std::cos(angle);
+        cy = center_y_ + radius*std::sin(angle);
+    }
+
+    // Calculate the strip in tiles on the thread pool.  calculate(cx, cy, count,
+    // max_iterations, iterations, norm) is an escape time kernel.
+    template <typename Calculate>
+    void render(ThreadPool &pool, int tile_size, int max_iterations, const Calculate &calculate)
+    {
+        renderTiles(pool, makeTiles(columns_, rows_, tile_size), [&](const Tile &tile)
+        {
+            std::vector<double> cx(tile.width), cy(tile.width), norm(tile.width);
+            std::vector<int> iterations(tile.width);
+            for(int row = tile.y; row < tile.y + tile.height; ++row)
+            {
+                for(int i = 0; i < tile.width; ++i)
+                    point(tile.x + i, row, cx[i], cy[i]);
+                calculate(cx.data(), cy.data(), tile.width, max_iterations, iterations.data(), norm.data());
+
+                float *out = &smooth_[static_cast<std::size_t>(row)*columns_ + tile.x];
+                for(int i = 0; i < tile.width; ++i)
+                    out[i] = smoothIterations(iterations[i], norm[i], max_iterations);
+            }
+        });
+    }
+
+    // The smooth iteration counts of the strip, row by row
+    const std::vector<float> &smooth() const {return smooth_;}
+
+    // Color the strip, before resampling frames from it
+    void colorize(const Palette &palette)
+    {
+        bgr_.resize(3*smooth_.size());
+        ::colorize(smooth_.data(), smooth_.size(), palette, bgr_.data());
+    }
+
+    // Resample a width x height frame centered on the strip's center, with a
+    // distance of  spacing  between pixels, from the colored strip
+    void renderFrame(double spacing, int width, int height, ThreadPool &pool, unsigned char *bgr)
+    {
+        if(width != frame_width_ || height != frame_height_)
+            mapFrame(width, height);
+
+        // Zooming in just moves the frame down the strip
+        const double shift = std::log(outer_radius_ / spacing) / rowStep();
+        renderTiles(pool, makeTiles(width, height, 64), [&](const Tile &tile)
+        {
+            for(int row = tile.y; row < tile.y + tile.height; ++row)
+            {
+                for(int col = tile.x; col < tile.x + tile.width; ++col)
+                {
+                    const std::size_t k = static_cast<std::size_t>(row)*width + col;
+                    const double v = std::min(std::max(frame_v_[k] + shift, 0.0), rows_ - 1.0);
+                    interpolate(frame_u_[k], v, bgr + 3*k);
+                }
+            }
+        });
+    }
+
+private:
+
+    // The step in log(radius) from one row to the next
+    double rowStep() const {return 2*M_PI / columns_;}
+
+    // Where the pixels of a width x height frame are in the strip, apart from
+    // the shift of the rows, which depends on the spacing.  The center of the
+    // frame takes the innermost row.
+    void mapFrame(int width, int height)
+    {
+        frame_width_ = width;
+        frame_height_ = height;
+        frame_u_.resize(static_cast<std::size_t>(width)*height);
+        frame_v_.resize(static_cast<std::size_t>(width)*height);
+        for(int row = 0; row < height; ++row)
+        {
+            const double dy = height/2.0 - row;
+            for(int col = 0; col < width; ++col)
+            {
+                const double dx = col - width/2.0;
+                double u = std::atan2(dy, dx) / (2*M_PI) * columns_;
+                if(u < 0)
+                    u += columns_;
+
+                const std::size_t k = static_cast<std::size_t>(row)*width + col;
+                frame_u_[k] = u;
+                frame_v_[k] = -std::log(std::max(std::hypot(dx, dy), 1e-3)) / rowStep();
+            }
+        }
+    }
+
+    void interpolate(double u, double v, unsigned char *out) const
+    {
+        const int col = std::min(static_cast<int>(u), columns_ - 1);
+        const int row = std::min(static_cast<int>(v), rows_ - 2);
+        const double s = u - col;
+        const double t = v - row;
+
+        const int next_col = col + 1 < columns_ ? col + 1 : 0;
+        const std::size_t top = static_cast<std::size_t>(row)*columns_;
+        const std::size_t bottom = top + columns_;
+        const unsigned char *p00 = &bgr_[3*(top + col)];
+        const unsigned char *p01 = &bgr_[3*(top + next_col)];
+        const unsigned char *p10 = &bgr_[3*(bottom + col)];
+        const unsigned char *p11 = &bgr_[3*(bottom + next_col)];
+        for(int c = 0; c < 3; ++c)
+        {
+            const double value = (1-t)*((1-s)*p00[c] + s*p01[c]) + t*((1-s)*p10[c] + s*p11[c]);
+            out[c] = static_cast<unsigned char>(value + 0.5);
+        }
+    }
+
+    const double center_x_;
+    const double center_y_;
+    const double outer_radius_;
+    const int columns_;
+    const int rows_;
+    std::vector<float> smooth_;
+    std::vector<unsigned char> bgr_;
+
+    int frame_width_;
+    int frame_height_;
+    std::vector<double> frame_u_, frame_v_;
+};
+
+
+#endif  // EXP_MAP_H_
@@ -0,0 +1,467 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <zlib.h>
+
+
+static void checkFile(const std::ofstream &file, const std::string &what)
+{
+    if(!file)
+        throw std::runtime_error("Can't write " + what);
+}
+
+
+// PNG
+
+static void putUint32BigEndian(unsigned char *out, std::uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+
+// A piece of the zlib stream: the raw deflate data of some rows, and the
+// checksum of the uncompressed data
+struct PngWriter::Piece
+{
+    std::vector<unsigned char> data;
+    unsigned long adler;
+    std::size_t length;
+};
+
+
+PngWriter::PngWriter(const std::string &path, int width, int height, int compression_level, ThreadPool *pool)
+    : ImageWriter(width, height), file_(path.c_str(), std::ios::binary),
+      compression_level_(compression_level), pool_(pool), rows_written_(0), adler_(adler32(0, Z_NULL, 0))
+{
+    checkFile(file_, path);
+
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    file_.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    // 8 bit RGB, not interlaced
+    unsigned char header[13] = {0};
+    putUint32BigEndian(header, width);
+    putUint32BigEndian(header + 4, height);
+    header[8] = 8;
+    header[9] = 2;
+    writeChunk("IHDR", header, sizeof(header));
+
+    // The zlib header (deflate with a 32K window, no dictionary)
+    static const unsigned char zlib_header[2] = {0x78, 0x9C};
+    writeChunk("IDAT", zlib_header, sizeof(zlib_header));
+}
+
+
+void PngWriter::writeBand(const unsigned char *bgr, int rows)
+{
+    if(rows_written_ + rows > height_)
+        throw std::runtime_error("Too many rows for the PNG");
+
+    const std::size_t row_bytes = 3*static_cast<std::size_t>(width_);
+    std::vector<Piece> pieces((rows + rows_per_piece - 1) / rows_per_piece);
+    for(std::size_t p = 0; p < pieces.size(); ++p)
+    {
+        const unsigned char *start = bgr + p*rows_per_piece*row_bytes;
+        const int count = std::min(rows_per_piece, rows - static_cast<int>(p)*rows_per_piece);
+        Piece &piece = pieces[p];
+        if(pool_)
+            pool_->submit([this, start, count, &piece]{ compressPiece(start, count, piece); });
+        else
+            compressPiece(start, count, piece);
+    }
+    if(pool_)
+        pool_->wait();
+
+    // Join the pieces in order
+    for(const Piece &piece : pieces)
+    {
+        writeChunk("IDAT", piece.data.data(), piece.data.size());
+        adler_ = adler32_combine(adler_, piece.adler, piece.length);
+    }
+    rows_written_ += rows;
+}
+
+
+void PngWriter::finish()
+{
+    if(rows_written_ != height_)
+        throw std::runtime_error("Not all rows of the PNG were written");
+
+    // An empty final block, then the checksum of all the uncompressed data
+    unsigned char trailer[6] = {0x03, 0x00};
+    putUint32BigEndian(trailer + 2, adler_);
+    writeChunk("IDAT", trailer, sizeof(trailer));
+    writeChunk("IEND", nullptr, 0);
+    file_.close();
+    checkFile(file_, "the PNG");
+}
+
+
+// Filter and compress some rows as raw deflate blocks, ending on a byte
+// boundary so that the next piece can follow directly
+void PngWriter::compressPiece(const unsigned char *bgr, int rows, Piece &piece) const
+{
+    const std::size_t row_bytes = 3*static_cast<std::size_t>(width_);
+    std::vector<unsigned char> previous(row_bytes), row(row_bytes);
+    std::vector<unsigned char> filtered(rows*(row_bytes + 1));
+
+    for(int r = 0; r < rows; ++r)
+    {
+        const unsigned char *in = bgr + r*row_bytes;
+        for(int col = 0; col < width_; ++col)
+        {
+            row[3*col] = in[3*col + 2];
+            row[3*col + 1] = in[3*col + 1];
+            row[3*col + 2] = in[3*col];
+        }
+
+        unsigned char *out = &filtered[r*(row_bytes + 1)];
+        if(r == 0)
+        {
+            // Sub filter: predict each byte from the one to its left
+            out[0] = 1;
+            for(std::size_t k = 0; k < row_bytes; ++k)
+                out[k + 1] = row[k] - (k >= 3 ? row[k-3] : 0);
+        }
+        else
+        {
+            // Paeth filter: predict each byte from the ones to its left, above,
+            // and above left
+            out[0] = 4;
+            for(std::size_t k = 0; k < row_bytes; ++k)
+            {
+                const int a = k >= 3 ? row[k-3] : 0;
+                const int b = previous[k];
+                const int c = k >= 3 ? previous[k-3] : 0;
+                const int p = a + b - c;
+                const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                const int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                out[k + 1] = row[k] - predictor;
+            }
+        }
+        row.swap(previous);
+    }
+
+    piece.length = filtered.size();
+    piece.adler = adler32(adler32(0, Z_NULL, 0), filtered.data(), filtered.size());
+
+    z_stream z;
+    z.zalloc = Z_NULL;
+    z.zfree = Z_NULL;
+    z.opaque = Z_NULL;
+    if(deflateInit2(&z, compression_level_, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("Can't initialize zlib");
+
+    piece.data.resize(deflateBound(&z, filtered.size()) + 16);
+    z.next_in = filtered.data();
+    z.avail_in = filtered.size();
+    z.next_out = piece.data.data();
+    z.avail_out = piece.data.size();
+    const int result = deflate(&z, Z_FULL_FLUSH);
+    const bool complete = z.avail_in == 0 && z.avail_out > 0;
+    piece.data.resize(piece.data.size() - z.avail_out);
+    deflateEnd(&z);
+    if(result != Z_OK || !complete)
+        throw std::runtime_error("zlib error");
+}
+
+
+void PngWriter::writeChunk(const char *type, const unsigned char *data, std::size_t size)
+{
+    unsigned char length[4], crc[4];
+    putUint32BigEndian(length, size);
+
+    uLong checksum = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+    if(size > 0)
+        checksum = crc32(checksum, data, size);
+    putUint32BigEndian(crc, checksum);
+
+    file_.write(reinterpret_cast<const char *>(length), 4);
+    file_.write(type, 4);
+    file_.write(reinterpret_cast<const char *>(data), size);
+    file_.write(reinterpret_cast<const char *>(crc), 4);
+    checkFile(file_, "the PNG");
+}
+
+
+// TIFF
+
+// Field types
+static const std::uint16_t tiff_short = 3;
+static const std::uint16_t tiff_long = 4;
+static const std::uint16_t tiff_long8 = 16;
+
+
+template <typename T>
+static void putLittleEndian(std::ofstream &file, T value)
+{
+    unsigned char bytes[sizeof(T)];
+    for(std::size_t k = 0; k < sizeof(T); ++k)
+        bytes[k] = static_cast<unsigned char>(static_cast<std::uint64_t>(value) >> (8*k));
+    file.write(reinterpret_cast<const char *>(bytes), sizeof(T));
+}
+
+
+TiffWriter::TiffWriter(const std::string &path, int width, int height, int tile_size,
+                       int compression_level, bool big_tiff, ThreadPool *pool)
+    : ImageWriter(width, height), file_(path.c_str(), std::ios::binary), tile_size_(tile_size),
+      compression_level_(compression_level), pool_(pool), rows_written_(0), buffered_rows_(0)
+{
+    if(tile_size <= 0 || tile_size % 16 != 0)
+        throw std::invalid_argument("TIFF tile size must be a multiple of 16");
+    checkFile(file_, path);
+
+    // Use 64 bit offsets if the tiles might not fit in 4 GB, even uncompressed
+    const int tiles_across = (width + tile_size - 1) / tile_size;
+    const int tiles_down = (height + tile_size - 1) / tile_size;
+    const std::uint64_t largest_size = static_cast<std::uint64_t>(tiles_across)*tiles_down*tile_size*tile_size*3;
+    big_ = big_tiff || largest_size > 0xF0000000u;
+
+    buffer_.assign(static_cast<std::size_t>(tiles_across)*tile_size*tile_size*3, 0);
+    tile_offsets_.reserve(static_cast<std::size_t>(tiles_across)*tiles_down);
+
+    // Header, with a placeholder for the offset of the directory
+    file_.write("II", 2);
+    if(big_)
+    {
+        putLittleEndian<std::uint16_t>(file_, 43);
+        putLittleEndian<std::uint16_t>(file_, 8);
+        putLittleEndian<std::uint16_t>(file_, 0);
+        putLittleEndian<std::uint64_t>(file_, 0);
+    }
+    else
+    {
+        putLittleEndian<std::uint16_t>(file_, 42);
+        putLittleEndian<std::uint32_t>(file_, 0);
+    }
+    checkFile(file_, path);
+}
+
+
+void TiffWriter::writeBand(const unsigned char *bgr, int rows)
+{
+    if(rows_written_ + rows > height_)
+        throw std::runtime_error("Too many rows for the TIFF");
+
+    for(int r = 0; r < rows; ++r)
+    {
+        // Copy the row into the tiles, as RGB
+        const unsigned char *in = bgr + static_cast<std::size_t>(r)*3*width_;
+        for(int col = 0; col < width_; ++col)
+        {
+            const int tile = col / tile_size_;
+            unsigned char *out = &buffer_[((static_cast<std::size_t>(tile)*tile_size_ + buffered_rows_)*tile_size_
+                                           + col % tile_size_)*3];
+            out[0] = in[3*col + 2];
+            out[1] = in[3*col + 1];
+            out[2] = in[3*col];
+        }
+
+        ++rows_written_;
+        if(++buffered_rows_ == tile_size_ || rows_written_ == height_)
+            writeTileRow();
+    }
+}
+
+
+// Compress and write the buffered row of tiles
+void TiffWriter::writeTileRow()
+{
+    const std::size_t tile_bytes = static_cast<std::size_t>(tile_size_)*tile_size_*3;
+    std::vector<std::vector<unsigned char> > tiles(buffer_.size() / tile_bytes);
+
+    for(std::size_t t = 0; t < tiles.size(); ++t)
+    {
+        std::vector<unsigned char> &compressed = tiles[t];
+        const unsigned char *tile = &buffer_[t*tile_bytes];
+        auto compressTile = [this, &compressed, tile, tile_bytes]
+        {
+            compressed.resize(compressBound(tile_bytes));
+            uLongf size = compressed.size();
+            if(compress2(compressed.data(), &size, tile, tile_bytes, compression_level_) != Z_OK)
+                throw std::runtime_error("zlib error");
+            compressed.resize(size);
+        };
+
+        if(pool_)
+            pool_->submit(compressTile);
+        else
+            compressTile();
+    }
+    if(pool_)
+        pool_->wait();
+
+    for(const std::vector<unsigned char> &compressed : tiles)
+    {
+        tile_offsets_.push_back(file_.tellp());
+        tile_byte_counts_.push_back(compressed.size());
+        file_.write(reinterpret_cast<const char *>(compressed.data()), compressed.size());
+        if(compressed.size() % 2)
+            file_.put(0);
+    }
+    checkFile(file_, "the TIFF");
+
+    // The rows below the image in the last row of tiles stay zero
+    std::fill(buffer_.begin(), buffer_.end(), 0);
+    buffered_rows_ = 0;
+}
+
+
+void TiffWriter::finish()
+{
+    if(rows_written_ != height_)
+        throw std::runtime_error("Not all rows of the TIFF were written");
+
+    // The arrays that don't fit into their directory entries
+    const std::uint64_t bits_offset = file_.tellp();
+    for(int k = 0; k < 3; ++k)
+        putLittleEndian<std::uint16_t>(file_, 8);
+
+    const std::size_t count = tile_offsets_.size();
+    std::uint64_t offsets_offset = 0, counts_offset = 0;
+    if(count > 1)
+    {
+        offsets_offset = file_.tellp();
+        for(std::uint64_t offset : tile_offsets_)
+            big_ ? putLittleEndian<std::uint64_t>(file_, offset) : putLittleEndian<std::uint32_t>(file_, offset);
+        counts_offset = file_.tellp();
+        for(std::uint64_t size : tile_byte_counts_)
+            big_ ? putLittleEndian<std::uint64_t>(file_, size) : putLittleEndian<std::uint32_t>(file_, size);
+    }
+    else
+    {
+        offsets_offset = tile_offsets_[0];
+        counts_offset = tile_byte_counts_[0];
+    }
+
+    // The directory, with its entries sorted by tag
+    const std::uint64_t directory_offset = file_.tellp();
+    const int entries = 11;
+    big_ ? putLittleEndian<std::uint64_t>(file_, entries) : putLittleEndian<std::uint16_t>(file_, entries);
+    writeEntry(256, tiff_long, 1, width_);                  // ImageWidth
+    writeEntry(257, tiff_long, 1, height_);                 // ImageLength
+    if(big_)                                                // BitsPerSample
+        writeEntry(258, tiff_short, 3, 8 | (8 << 16) | (std::uint64_t(8) << 32));
+    else
+        writeEntry(258, tiff_short, 3, bits_offset);
+    writeEntry(259, tiff_short, 1, 8);                      // Compression: deflate
+    writeEntry(262, tiff_short, 1, 2);                      // PhotometricInterpretation: RGB
+    writeEntry(277, tiff_short, 1, 3);                      // SamplesPerPixel
+    writeEntry(284, tiff_short, 1, 1);                      // PlanarConfiguration: interleaved
+    writeEntry(322, tiff_long, 1, tile_size_);              // TileWidth
+    writeEntry(323, tiff_long, 1, tile_size_);              // TileLength
+    writeEntry(324, big_ ? tiff_long8 : tiff_long, count, offsets_offset);   // TileOffsets
+    writeEntry(325, big_ ? tiff_long8 : tiff_long, count, counts_offset);    // TileByteCounts
+    big_ ? putLittleEndian<std::uint64_t>(file_, 0) : putLittleEndian<std::uint32_t>(file_, 0);
+
+    // Point the header at the directory
+    file_.seekp(big_ ? 8 : 4);
+    big_ ? putLittleEndian<std::uint64_t>(file_, directory_offset)
+         : putLittleEndian<std::uint32_t>(file_, directory_offset);
+
+    file_.close();
+    checkFile(file_, "the TIFF");
+}
+
+
+// A directory entry.  Values that fit into the entry are stored in it directly,
+// otherwise value is the offset of the values.
+void TiffWriter::writeEntry(std::uint16_t tag, std::uint16_t type, std::uint64_t count, std::uint64_t value)
+{
+    putLittleEndian<std::uint16_t>(file_, tag);
+    putLittleEndian<std::uint16_t>(file_, type);
+    if(big_)
+    {
+        putLittleEndian<std::uint64_t>(file_, count);
+        putLittleEndian<std::uint64_t>(file_, value);
+    }
+    else
+    {
+        putLittleEndian<std::uint32_t>(file_, count);
+        // A single SHORT sits in the first two bytes of the field
+        putLittleEndian<std::uint32_t>(file_, value);
+    }
+}
+
+
+// Background encoding
+
+BackgroundWriter::BackgroundWriter(std::unique_ptr<ImageWriter> writer, std::size_t max_queued_bands)
+    : ImageWriter(writer->width(), writer->height()), writer_(std::move(writer)), queue_(max_queued_bands)
+{
+    thread_ = std::thread(&BackgroundWriter::run, this);
+}
+
+
+BackgroundWriter::~BackgroundWriter()
+{
+    if(thread_.joinable())
+    {
+        queue_.close();
+        thread_.join();
+    }
+}
+
+
+void BackgroundWriter::writeBand(const unsigned char *bgr, int rows)
+{
+    Band band;
+    band.bgr.assign(bgr, bgr + 3*static_cast<std::size_t>(width_)*rows);
+    band.rows = rows;
+
+    if(!queue_.push(std::move(band)))
+    {
+        if(error_)
+            std::rethrow_exception(error_);
+        throw std::logic_error("Band written after finish()");
+    }
+}
+
+
+void BackgroundWriter::finish()
+{
+    queue_.close();
+    if(thread_.joinable())
+        thread_.join();
+    if(error_)
+        std::rethrow_exception(error_);
+    writer_->finish();
+}
+
+
+// Encode the bands from the queue until it is closed, or until an error
+void BackgroundWriter::run()
+{
+    Band band;
+    while(queue_.pop(band))
+    {
+        try
+        {
+            writer_->writeBand(band.bgr.data(), band.rows);
+        }
+        catch(...)
+        {
+            error_ = std::current_exception();
+            queue_.close();
+            return;
+        }
+    }
+}
+
+
+std::unique_ptr<ImageWriter> openImageWriter(const std::string &path, int width, int height, ThreadPool *pool)
+{
+    const std::size_t dot = path.rfind('.');
+    const std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+
+    if(extension == ".png")
+        return std::unique_ptr<ImageWriter>(new PngWriter(path, width, height, 6, pool));
+    if(extension == ".tif" || extension == ".tiff")
+        return std::unique_ptr<ImageWriter>(new TiffWriter(path, width, height, 256, 6, false, pool));
+    throw std::invalid_argument("Unsupported image format: " + path);
+}
@@ -0,0 +1,153 @@
+#ifndef IMAGE_WRITER_H_
+#define IMAGE_WRITER_H_
+
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "ThreadPool.h"
+
+// Streaming image output.
+//
+// An ImageWriter takes an image as a sequence of horizontal bands, from top
+// to bottom, and encodes each band as it comes in, so only a band of the image
+// ever needs to be in memory.  That allows images far larger than the RAM.
+//
+// Pixels are 3 bytes, in BGR order like an OpenCV CV_8UC3 image.  Errors are
+// reported with std::runtime_error.
+
+class ImageWriter
+{
+public:
+
+    ImageWriter(int width, int height) : width_(width), height_(height) {}
+    virtual ~ImageWriter() {}
+
+    int width() const {return width_;}
+    int height() const {return height_;}
+
+    // Write the next  rows  rows of the image, each of them width*3 bytes long
+    virtual void writeBand(const unsigned char *bgr, int rows) = 0;
+
+    // Finish the file, after all the rows have been written
+    virtual void finish() = 0;
+
+protected:
+
+    const int width_;
+    const int height_;
+};
+
+
+// An RGB PNG.
+//
+// The rows are split into pieces of up to rows_per_piece rows, which are
+// filtered and compressed independently (on the thread pool, if there is one)
+// and then joined into one zlib stream.  The first row of a piece uses the Sub
+// filter, and the other rows the Paeth filter.
+class PngWriter : public ImageWriter
+{
+public:
+
+    static const int rows_per_piece = 64;
+
+    PngWriter(const std::string &path, int width, int height, int compression_level = 6,
+              ThreadPool *pool = nullptr);
+
+    void writeBand(const unsigned char *bgr, int rows);
+    void finish();
+
+private:
+
+    struct Piece;
+    void compressPiece(const unsigned char *bgr, int rows, Piece &piece) const;
+    void writeChunk(const char *type, const unsigned char *data, std::size_t size);
+
+    std::ofstream file_;
+    int compression_level_;
+    ThreadPool *pool_;
+    int rows_written_;
+    unsigned long adler_;
+};
+
+
+// A tiled RGB TIFF with every tile deflate compressed.  A BigTIFF (with 64
+// bit offsets) is written when the file could grow beyond 4 GB, or when
+// big_tiff is set.
+//
+// Tiles are only complete once all their rows have come in, so a band of
+// tile_size rows is buffered internally.
+class TiffWriter : public ImageWriter
+{
+public:
+
+    // tile_size must be a multiple of 16
+    TiffWriter(const std::string &path, int width, int height, int tile_size = 256,
+               int compression_level = 6, bool big_tiff = false, ThreadPool *pool = nullptr);
+
+    void writeBand(const unsigned char *bgr, int rows);
+    void finish();
+
+    bool isBigTiff() const {return big_;}
+
+private:
+
+    void writeTileRow();
+    void writeEntry(std::uint16_t tag, std::uint16_t type, std::uint64_t count, std::uint64_t value);
+
+    std::ofstream file_;
+    int tile_size_;
+    int compression_level_;
+    ThreadPool *pool_;
+    bool big_;
+    int rows_written_;
+    int buffered_rows_;
+    std::vector<unsigned char> buffer_;
+    std::vector<std::uint64_t> tile_offsets_;
+    std::vector<std::uint64_t> tile_byte_counts_;
+};
+
+
+// Encodes the bands on a background thread, so that the caller can carry on
+// rendering the next band in the meantime.  Up to max_queued_bands bands wait
+// for the encoder; after that, writeBand() blocks until there is room.
+// Errors of the encoder come out of the next writeBand() or finish().
+class BackgroundWriter : public ImageWriter
+{
+public:
+
+    BackgroundWriter(std::unique_ptr<ImageWriter> writer, std::size_t max_queued_bands = 2);
+    ~BackgroundWriter();
+
+    void writeBand(const unsigned char *bgr, int rows);
+    void finish();
+
+private:
+
+    struct Band
+    {
+        std::vector<unsigned char> bgr;
+        int rows;
+    };
+
+    void run();
+
+    std::unique_ptr<ImageWriter> writer_;
+    BoundedQueue<Band> queue_;
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+
+// Open a writer for the format given by the file name extension (.png, .tif or
+// .tiff).  If a thread pool is given, the compression is spread over it.
+std::unique_ptr<ImageWriter> openImageWriter(const std::string &path, int width, int height,
+                                             ThreadPool *pool = nullptr);
+
+
+#endif  // IMAGE_WRITER_H_
@@ -0,0 +1,101 @@
+#ifndef ITERATION_BUDGET_H_
+#define ITERATION_BUDGET_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Estimation of the iteration budget (max_iterations) that a view needs.
+//
+// Zoomed out views are done after a few hundred iterations, while deep ones
+// need many thousands, and with too small a budget pixels outside the set are
+// taken for interior ones.  The estimate iterates a grid of probe pixels over
+// the view, starting with a small budget, and keeps doubling the budget for
+// the pixels that are still unescaped.  Pixels that escaped are done with, so
+// the budget is only ever raised for the ones that need it, and the total work
+// is at most twice that of the final round.  Once a doubling lets fewer than
+// threshold  of the pixels that were left escape, the budget before it is
+// taken; the few pixels that would have escaped come out as part of the set.
+//
+// Until some pixel has escaped the budget keeps doubling, so that a view
+// whose escape times all lie beyond the first budget isn't taken for the
+// inside of the set.  The budget never goes beyond  limit.
+
+
+// The first budget, and the number of probe pixels across the longer side
+const int first_iteration_budget = 64;
+const int iteration_budget_probes = 128;
+
+
+// calculate(x, y, count, max_iterations, iterations, norm) calculates the
+// escape times of  count  points given in pixel coordinates of a width x
+// height image, with the given budget.  It is called on the thread pool.
+template <typename Calculate>
+int estimateMaxIterations(ThreadPool &pool, int width, int height, const Calculate &calculate,
+                          double threshold, int limit)
+{
+    // The probes sit at the centers of a grid of (nearly) square cells
+    const double cell = std::max(1.0, static_cast<double>(std::max(width, height)) / iteration_budget_probes);
+    const int columns = std::max(1, static_cast<int>(std::ceil(width / cell)));
+    const int rows = std::max(1, static_cast<int>(std::ceil(height / cell)));
+    std::vector<double> x, y;
+    for(int row = 0; row < rows; ++row)
+    {
+        for(int col = 0; col < columns; ++col)
+        {
+            x.push_back((col + 0.5)*width/columns);
+            y.push_back((row + 0.5)*height/rows);
+        }
+    }
+
+    const int chunk = 256;
+    int budget = std::min(first_iteration_budget, limit);
+    int previous_budget = 0;
+    int escaped_before = 0;
+
+    while(true)
+    {
+        const int count = x.size();
+        std::vector<int> iterations(count);
+        std::vector<double> norm(count);
+        for(int start = 0; start < count; start += chunk)
+        {
+            pool.submit([&, start]
+            {
+                calculate(&x[start], &y[start], std::min(chunk, count - start), budget,
+                          &iterations[start], &norm[start]);
+            });
+        }
+        pool.wait();
+
+        // Keep the pixels that are still unescaped for the next round
+        int remaining = 0;
+        for(int i = 0; i < count; ++i)
+        {
+            if(iterations[i] == budget)
+            {
+                x[remaining] = x[i];
+                y[remaining] = y[i];
+                ++remaining;
+            }
+        }
+        x.resize(remaining);
+        y.resize(remaining);
+
+        // If raising the budget made hardly any difference, the previous one was enough
+        const int escaped = count - remaining;
+        if(previous_budget > 0 && escaped_before > 0 && escaped < threshold*count)
+            return previous_budget;
+        if(remaining == 0 || budget >= limit)
+            return budget;
+
+        escaped_before += escaped;
+        previous_budget = budget;
+        budget = budget > limit/2 ? limit : 2*budget;
+    }
+}
+
+
+#endif  // ITERATION_BUDGET_H_
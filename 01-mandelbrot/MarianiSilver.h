@@ -0,0 +1,155 @@
+#ifndef MARIANI_SILVER_H_
+#define MARIANI_SILVER_H_
+
+#include <vector>
+
+#include "Tiles.h"
+
+// The Mariani-Silver algorithm, which skips most of the pixels of large
+// uniform regions.
+//
+// The Mandelbrot set is connected, and so are the bands of equal escape time
+// around it, so if every pixel on the border of a rectangle has the same escape
+// time, (nearly) every pixel inside it has too.  The algorithm calculates the
+// border of a rectangle; if it is uniform, the inside is filled without
+// calculating it, and otherwise the rectangle is split in two and each half is
+// handled the same way.  The halves share the dividing line, so it is only
+// calculated once.
+//
+// This is not exact: features thinner than a pixel that cross into a rectangle
+// without touching a border pixel are missed.  Filled pixels get the escape
+// time of the border, and a norm interpolated between the left and right
+// border, so the smooth shading stays smooth.
+
+template <typename CalculateRow>
+class MarianiSilver
+{
+public:
+
+    // Rectangles smaller than this in either direction are calculated in full
+    static const int min_size = 4;
+
+    // Calculate the escape times of the pixels of a tile.  calculateRow(row, col,
+    // count, iterations, norm) calculates  count  pixels of a row of the image,
+    // starting from the given column, and iterations and norm hold the results
+    // for the tile, row by row.
+    MarianiSilver(const Tile &tile, const CalculateRow &calculateRow, int *iterations, double *norm)
+        : tile_(tile), calculateRow_(calculateRow), iterations_(iterations), norm_(norm),
+          known_(tile.width*tile.height, false), calculated_(0)
+    {
+        if(tile.width > 0 && tile.height > 0)
+            subdivide(0, 0, tile.width, tile.height);
+    }
+
+    // The number of pixels that were actually calculated
+    int calculated() const {return calculated_;}
+
+private:
+
+    // Handle the rectangle with its top left corner at (x, y), relative to the tile
+    void subdivide(int x, int y, int width, int height)
+    {
+        if(width < min_size || height < min_size)
+        {
+            for(int row = y; row < y + height; ++row)
+                calculateSpan(x, row, width);
+            return;
+        }
+
+        // Calculate the border
+        const int right = x + width - 1;
+        const int bottom = y + height - 1;
+        calculateSpan(x, y, width);
+        calculateSpan(x, bottom, width);
+        for(int row = y + 1; row < bottom; ++row)
+        {
+            calculateSpan(x, row, 1);
+            calculateSpan(right, row, 1);
+        }
+
+        // Fill the inside if the border is uniform
+        const int n = iterations_[index(x, y)];
+        bool uniform = true;
+        for(int col = x; col <= right && uniform; ++col)
+            uniform = iterations_[index(col, y)] == n && iterations_[index(col, bottom)] == n;
+        for(int row = y + 1; row < bottom && uniform; ++row)
+            uniform = iterations_[index(x, row)] == n && iterations_[index(right, row)] == n;
+
+        if(uniform)
+        {
+            for(int row = y + 1; row < bottom; ++row)
+            {
+                const double left_norm = norm_[index(x, row)];
+                const double right_norm = norm_[index(right, row)];
+                for(int col = x + 1; col < right; ++col)
+                {
+                    const int i = index(col, row);
+                    iterations_[i] = n;
+                    norm_[i] = left_norm + (right_norm - left_norm)*(col - x)/(width - 1);
+                    known_[i] = true;
+                }
+            }
+            return;
+        }
+
+        // Otherwise split it across its longer side
+        if(width >= height)
+        {
+            const int middle = x + width/2;
+            subdivide(x, y, middle - x + 1, height);
+            subdivide(middle, y, right - middle + 1, height);
+        }
+        else
+        {
+            const int middle = y + height/2;
+            subdivide(x, y, width, middle - y + 1);
+            subdivide(x, middle, width, bottom - middle + 1);
+        }
+    }
+
+    // Calculate the pixels of a row that aren't known yet, in runs
+    void calculateSpan(int x, int y, int count)
+    {
+        int col = x;
+        while(col < x + count)
+        {
+            if(known_[index(col, y)])
+            {
+                ++col;
+                continue;
+            }
+
+            int end = col + 1;
+            while(end < x + count && !known_[index(end, y)])
+                ++end;
+
+            const int i = index(col, y);
+            calculateRow_(tile_.y + y, tile_.x + col, end - col, iterations_ + i, norm_ + i);
+            for(int k = i; k < i + end - col; ++k)
+                known_[k] = true;
+            calculated_ += end - col;
+            col = end;
+        }
+    }
+
+    int index(int x, int y) const {return y*tile_.width + x;}
+
+    const Tile &tile_;
+    const CalculateRow &calculateRow_;
+    int *iterations_;
+    double *norm_;
+    std::vector<bool> known_;
+    int calculated_;
+};
+
+
+// Calculate the escape times of the pixels of a tile with the Mariani-Silver
+// algorithm (see above).  Returns the number of pixels that were actually calculated.
+template <typename CalculateRow>
+int marianiSilver(const Tile &tile, const CalculateRow &calculateRow, int *iterations, double *norm)
+{
+    return MarianiSilver<CalculateRow>(tile, calculateRow, iterations, norm).calculated();
+}
+
+
+#endif  // MARIANI_SILVER_H_
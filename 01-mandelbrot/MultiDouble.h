@@ -0,0 +1,416 @@
+#ifndef MULTI_DOUBLE_H_
+#define MULTI_DOUBLE_H_
+
+#include <cmath>
+#include <string>
+
+#include "BigFixed.h"
+
+// Double-double and quad-double numbers, for zooms that are too deep for plain
+// double precision but not deep enough to need perturbation theory.
+//
+// A double-double is the unevaluated sum of two doubles (about 106 bits of
+// precision) and a quad-double is the unevaluated sum of four (about 212 bits).
+// The arithmetic is built on the error-free transformations below, following
+// the QD library by Hida, Li and Bailey.  The "sloppy" variants of the
+// algorithms are used: their error is bounded relative to the size of the
+// operands rather than the result, which is all the escape time loop needs.
+//
+// The error-free transformations only work if the compiler doesn't fuse
+// multiplies and adds on its own, so this must be built with -ffp-contract=off.
+
+
+// s + err = a + b exactly
+inline double twoSum(double a, double b, double &err)
+{
+    const double s = a + b;
+    const double bb = s - a;
+    err = (a - (s - bb)) + (b - bb);
+    return s;
+}
+
+// s + err = a + b exactly, if |a| >= |b|
+inline double quickTwoSum(double a, double b, double &err)
+{
+    const double s = a + b;
+    err = b - (s - a);
+    return s;
+}
+
+// p + err = a * b exactly
+inline double twoProd(double a, double b, double &err)
+{
+    const double p = a * b;
+    err = std::fma(a, b, -p);
+    return p;
+}
+
+
+class DoubleDouble
+{
+public:
+
+    DoubleDouble(double hi = 0.0, double lo = 0.0) : hi_(hi), lo_(lo) {}
+
+    // Parse a decimal number to full double-double precision
+    static DoubleDouble fromString(const std::string &text)
+    {
+        const int limbs = 16;
+        BigFixed x = BigFixed::fromString(text, limbs);
+        double hi = x.toDouble();
+        double lo;
+        hi = quickTwoSum(hi, (x - BigFixed(hi, 0, limbs)).toDouble(), lo);
+        return DoubleDouble(hi, lo);
+    }
+
+    double hi() const {return hi_;}
+    double lo() const {return lo_;}
+
+    friend DoubleDouble operator-(const DoubleDouble &a)
+    {
+        return DoubleDouble(-a.hi_, -a.lo_);
+    }
+
+    friend DoubleDouble operator+(const DoubleDouble &a, const DoubleDouble &b)
+    {
+        double s2, t2;
+        double s1 = twoSum(a.hi_, b.hi_, s2);
+        const double t1 = twoSum(a.lo_, b.lo_, t2);
+        s2 += t1;
+        s1 = quickTwoSum(s1, s2, s2);
+        s2 += t2;
+        s1 = quickTwoSum(s1, s2, s2);
+        return DoubleDouble(s1, s2);
+    }
+
+    friend DoubleDouble operator+(const DoubleDouble &a, double b)
+    {
+        double s2;
+        double s1 = twoSum(a.hi_, b, s2);
+        s2 += a.lo_;
+        s1 = quickTwoSum(s1, s2, s2);
+        return DoubleDouble(s1, s2);
+    }
+
+    friend DoubleDouble operator+(double a, const DoubleDouble &b) {return b + a;}
+    friend DoubleDouble operator-(const DoubleDouble &a, const DoubleDouble &b) {return a + (-b);}
+    friend DoubleDouble operator-(const DoubleDouble &a, double b) {return a + (-b);}
+    friend DoubleDouble operator-(double a, const DoubleDouble &b) {return (-b) + a;}
+
+    friend DoubleDouble operator*(const DoubleDouble &a, const DoubleDouble &b)
+    {
+        double p2;
+        double p1 = twoProd(a.hi_, b.hi_, p2);
+        p2 += a.hi_*b.lo_ + a.lo_*b.hi_;
+        p1 = quickTwoSum(p1, p2, p2);
+        return DoubleDouble(p1, p2);
+    }
+
+    friend DoubleDouble operator*(const DoubleDouble &a, double b)
+    {
+        double p2;
+        double p1 = twoProd(a.hi_, b, p2);
+        p2 += a.lo_*b;
+        p1 = quickTwoSum(p1, p2, p2);
+        return DoubleDouble(p1, p2);
+    }
+
+    friend DoubleDouble operator*(double a, const DoubleDouble &b) {return b * a;}
+
+    friend DoubleDouble operator/(const DoubleDouble &a, const DoubleDouble &b)
+    {
+        double q1 = a.hi_ / b.hi_;
+        DoubleDouble r = a - b*q1;
+        double q2 = r.hi_ / b.hi_;
+        r = r - b*q2;
+        const double q3 = r.hi_ / b.hi_;
+        q1 = quickTwoSum(q1, q2, q2);
+        return DoubleDouble(q1, q2) + q3;
+    }
+
+    friend DoubleDouble operator/(const DoubleDouble &a, double b) {return a / DoubleDouble(b);}
+
+    friend bool operator<(const DoubleDouble &a, const DoubleDouble &b)
+    {
+        return a.hi_ < b.hi_ || (a.hi_ == b.hi_ && a.lo_ < b.lo_);
+    }
+
+    friend bool operator>(const DoubleDouble &a, const DoubleDouble &b) {return b < a;}
+    friend bool operator<=(const DoubleDouble &a, const DoubleDouble &b) {return !(b < a);}
+    friend bool operator>=(const DoubleDouble &a, const DoubleDouble &b) {return !(a < b);}
+
+    friend DoubleDouble fabs(const DoubleDouble &a)
+    {
+        return a.hi_ < 0 ? -a : a;
+    }
+
+private:
+
+    double hi_;
+    double lo_;
+};
+
+
+class QuadDouble
+{
+public:
+
+    QuadDouble(double c0 = 0.0, double c1 = 0.0, double c2 = 0.0, double c3 = 0.0)
+    {
+        c_[0] = c0;
+        c_[1] = c1;
+        c_[2] = c2;
+        c_[3] = c3;
+    }
+
+    // Parse a decimal number to full quad-double precision
+    static QuadDouble fromString(const std::string &text)
+    {
+        const int limbs = 16;
+        BigFixed x = BigFixed::fromString(text, limbs);
+        double c[5] = {0, 0, 0, 0, 0};
+        for(int k = 0; k < 4; ++k)
+        {
+            c[k] = x.toDouble();
+            x = x - BigFixed(c[k], 0, limbs);
+        }
+        renormalize(c[0], c[1], c[2], c[3], c[4]);
+        return QuadDouble(c[0], c[1], c[2], c[3]);
+    }
+
+    double operator[](int k) const {return c_[k];}
+
+    friend QuadDouble operator-(const QuadDouble &a)
+    {
+        return QuadDouble(-a.c_[0], -a.c_[1], -a.c_[2], -a.c_[3]);
+    }
+
+    friend QuadDouble operator+(const QuadDouble &a, const QuadDouble &b)
+    {
+        double t0, t1, t2, t3;
+        double s0 = twoSum(a.c_[0], b.c_[0], t0);
+        double s1 = twoSum(a.c_[1], b.c_[1], t1);
+        double s2 = twoSum(a.c_[2], b.c_[2], t2);
+        double s3 = twoSum(a.c_[3], b.c_[3], t3);
+
+        s1 = twoSum(s1, t0, t0);
+        threeSum(s2, t0, t1);
+        threeSum2(s3, t0, t2);
+        t0 = t0 + t1 + t3;
+
+        renormalize(s0, s1, s2, s3, t0);
+        return QuadDouble(s0, s1, s2, s3);
+    }
+
+    friend QuadDouble operator+(const QuadDouble &a, double b)
+    {
+        double e;
+        double c0 = twoSum(a.c_[0], b, e);
+        double c1 = twoSum(a.c_[1], e, e);
+        double c2 = twoSum(a.c_[2], e, e);
+        double c3 = twoSum(a.c_[3], e, e);
+
+        renormalize(c0, c1, c2, c3, e);
+        return QuadDouble(c0, c1, c2, c3);
+    }
+
+    friend QuadDouble operator+(double a, const QuadDouble &b) {return b + a;}
+    friend QuadDouble operator-(const QuadDouble &a, const QuadDouble &b) {return a + (-b);}
+    friend QuadDouble operator-(const QuadDouble &a, double b) {return a + (-b);}
+    friend QuadDouble operator-(double a, const QuadDouble &b) {return (-b) + a;}
+
+    friend QuadDouble operator*(const QuadDouble &a, const QuadDouble &b)
+    {
+        double q0, q1, q2, q3, q4, q5;
+        double p0 = twoProd(a.c_[0], b.c_[0], q0);
+        double p1 = twoProd(a.c_[0], b.c_[1], q1);
+        double p2 = twoProd(a.c_[1], b.c_[0], q2);
+        double p3 = twoProd(a.c_[0], b.c_[2], q3);
+        double p4 = twoProd(a.c_[1], b.c_[1], q4);
+        double p5 = twoProd(a.c_[2], b.c_[0], q5);
+
+        threeSum(p1, p2, q0);
+
+        // Six-three sum of p2, q1, q2, p3, p4, p5
+        threeSum(p2, q1, q2);
+        threeSum(p3, p4, p5);
+        double t0, t1;
+        double s0 = twoSum(p2, p3, t0);
+        double s1 = twoSum(q1, p4, t1);
+        double s2 = q2 + p5;
+        s1 = twoSum(s1, t0, t0);
+        s2 += t0 + t1;
+
+        // Terms of order eps^3
+        s1 += a.c_[0]*b.c_[3] + a.c_[1]*b.c_[2] + a.c_[2]*b.c_[1] + a.c_[3]*b.c_[0] + q0 + q3 + q4 + q5;
+
+        renormalize(p0, p1, s0, s1, s2);
+        return QuadDouble(p0, p1, s0, s1);
+    }
+
+    friend QuadDouble operator*(const QuadDouble &a, double b)
+    {
+        double q0, q1, q2;
+        double p0 = twoProd(a.c_[0], b, q0);
+        double p1 = twoProd(a.c_[1], b, q1);
+        double p2 = twoProd(a.c_[2], b, q2);
+        double p3 = a.c_[3]*b;
+
+        double s0 = p0;
+        double s2;
+        double s1 = twoSum(q0, p1, s2);
+        threeSum(s2, q1, p2);
+        threeSum2(q1, q2, p3);
+        double s3 = q1;
+        double s4 = q2 + p2;
+
+        renormalize(s0, s1, s2, s3, s4);
+        return QuadDouble(s0, s1, s2, s3);
+    }
+
+    friend QuadDouble operator*(double a, const QuadDouble &b) {return b * a;}
+
+    friend QuadDouble operator/(const QuadDouble &a, const QuadDouble &b)
+    {
+        double q0 = a.c_[0] / b.c_[0];
+        QuadDouble r = a - b*q0;
+        double q1 = r.c_[0] / b.c_[0];
+        r = r - b*q1;
+        double q2 = r.c_[0] / b.c_[0];
+        r = r - b*q2;
+        double q3 = r.c_[0] / b.c_[0];
+        double q4 = 0.0;
+
+        renormalize(q0, q1, q2, q3, q4);
+        return QuadDouble(q0, q1, q2, q3);
+    }
+
+    friend QuadDouble operator/(const QuadDouble &a, double b) {return a / QuadDouble(b);}
+
+    friend bool operator<(const QuadDouble &a, const QuadDouble &b)
+    {
+        for(int k = 0; k < 4; ++k)
+        {
+            if(a.c_[k] != b.c_[k])
+                return a.c_[k] < b.c_[k];
+        }
+        return false;
+    }
+
+    friend bool operator>(const QuadDouble &a, const QuadDouble &b) {return b < a;}
+    friend bool operator<=(const QuadDouble &a, const QuadDouble &b) {return !(b < a);}
+    friend bool operator>=(const QuadDouble &a, const QuadDouble &b) {return !(a < b);}
+
+    friend QuadDouble fabs(const QuadDouble &a)
+    {
+        return a.c_[0] < 0 ? -a : a;
+    }
+
+private:
+
+    static void threeSum(double &a, double &b, double &c)
+    {
+        double t2, t3;
+        const double t1 = twoSum(a, b, t2);
+        a = twoSum(c, t1, t3);
+        b = twoSum(t2, t3, c);
+    }
+
+    static void threeSum2(double &a, double &b, double &c)
+    {
+        double t2, t3;
+        const double t1 = twoSum(a, b, t2);
+        a = twoSum(c, t1, t3);
+        b = t2 + t3;
+    }
+
+    // Turn the sum c0 + ... + c4 into four non-overlapping components
+    static void renormalize(double &c0, double &c1, double &c2, double &c3, double &c4)
+    {
+        if(std::isinf(c0))
+            return;
+
+        double s0 = quickTwoSum(c3, c4, c4);
+        s0 = quickTwoSum(c2, s0, c3);
+        s0 = quickTwoSum(c1, s0, c2);
+        c0 = quickTwoSum(c0, s0, c1);
+
+        double s1 = c1, s2 = 0.0, s3 = 0.0;
+        s0 = c0;
+
+        if(s1 != 0.0)
+        {
+            s1 = quickTwoSum(s1, c2, s2);
+            if(s2 != 0.0)
+            {
+                s2 = quickTwoSum(s2, c3, s3);
+                if(s3 != 0.0)
+                    s3 += c4;
+                else
+                    s2 = quickTwoSum(s2, c4, s3);
+            }
+            else
+            {
+                s1 = quickTwoSum(s1, c3, s2);
+                if(s2 != 0.0)
+                    s2 = quickTwoSum(s2, c4, s3);
+                else
+                    s1 = quickTwoSum(s1, c4, s2);
+            }
+        }
+        else
+        {
+            s0 = quickTwoSum(s0, c2, s1);
+            if(s1 != 0.0)
+            {
+                s1 = quickTwoSum(s1, c3, s2);
+                if(s2 != 0.0)
+                    s2 = quickTwoSum(s2, c4, s3);
+                else
+                    s1 = quickTwoSum(s1, c4, s2);
+            }
+            else
+            {
+                s0 = quickTwoSum(s0, c3, s1);
+                if(s1 != 0.0)
+                    s1 = quickTwoSum(s1, c4, s2);
+                else
+                    s0 = quickTwoSum(s0, c4, s1);
+            }
+        }
+
+        c0 = s0;
+        c1 = s1;
+        c2 = s2;
+        c3 = s3;
+    }
+
+    double c_[4];
+};
+
+
+// The properties of each number type that the escape time loop needs
+// (the specialization for double is in EscapeTime.h)
+template <typename Real>
+struct RealTraits;
+
+template <>
+struct RealTraits<DoubleDouble>
+{
+    static const char *name() {return "double-double";}
+    static double toDouble(const DoubleDouble &x) {return x.hi();}
+    static DoubleDouble fromString(const std::string &text) {return DoubleDouble::fromString(text);}
+    static double periodicityTolerance() {return 1e-29;}
+};
+
+template <>
+struct RealTraits<QuadDouble>
+{
+    static const char *name() {return "quad-double";}
+    static double toDouble(const QuadDouble &x) {return x[0];}
+    static QuadDouble fromString(const std::string &text) {return QuadDouble::fromString(text);}
+    static double periodicityTolerance() {return 1e-60;}
+};
+
+
+#endif  // MULTI_DOUBLE_H_
@@ -0,0 +1,377 @@
+#include "Options.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+
+#include "EscapeTime.h"
+
+
+// An option, with the setting it writes.  Options without an argument are flags.
+struct Option
+{
+    const char *name;
+    const char *argument;
+    std::function<void(RenderOptions &, const std::string &)> set;
+};
+
+
+// The option for a setting: max_iterations -> --max-iterations
+static std::string optionName(const char *member)
+{
+    std::string name = std::string("--") + member;
+    for(char &c : name)
+        if(c == '_')
+            c = '-';
+    return name;
+}
+
+
+// All the whole number settings are counts or sizes, so they can't be negative
+static int toInt(const std::string &name, const std::string &value)
+{
+    std::size_t end = 0;
+    int result = 0;
+    try
+    {
+        result = std::stoi(value, &end);
+    }
+    catch(const std::exception &)
+    {
+        end = 0;
+    }
+    if(value.empty() || end != value.size() || result < 0)
+        throw std::invalid_argument("Bad value for " + optionName(name.c_str()) + ": " + value);
+    return result;
+}
+
+
+static double toDouble(const std::string &name, const std::string &value)
+{
+    std::size_t end = 0;
+    double result = 0;
+    try
+    {
+        result = std::stod(value, &end);
+    }
+    catch(const std::exception &)
+    {
+        end = 0;
+    }
+    if(value.empty() || end != value.size())
+        throw std::invalid_argument("Bad value for " + optionName(name.c_str()) + ": " + value);
+    return result;
+}
+
+
+// Decimal numbers of the view are kept as text, but checked here, so that a
+// typo shows up before the rendering starts.  Deep zooms go far beyond the
+// range of a double, so only the form of the number and its order of
+// magnitude are checked: decimal digits, within max_decimal_exponent.
+static std::string toNumber(const std::string &name, const std::string &value)
+{
+    char *end = nullptr;
+    std::strtod(value.c_str(), &end);
+    bool valid = !value.empty() && value.find_first_not_of("+-.0123456789eE") == std::string::npos &&
+                 end == value.c_str() + value.size();
+
+    const std::size_t e = std::min(value.find_first_of("eE"), value.size());
+    long long magnitude = 0;
+    if(valid && e < value.size())
+    {
+        try
+        {
+            magnitude = std::stoi(value.substr(e + 1));
+        }
+        catch(const std::exception &)
+        {
+            valid = false;
+        }
+    }
+    if(!valid)
+        throw std::invalid_argument("Bad value for " + optionName(name.c_str()) + ": " + value);
+
+    // The order of magnitude is the exponent, moved by the position of the
+    // first digit that isn't 0 relative to the decimal point
+    const std::size_t point = std::min(value.find('.'), e);
+    const std::size_t first = value.find_first_of("123456789");
+    if(first < point)
+        magnitude += point - first - 1;
+    else if(first < e)
+        magnitude -= first - point;
+    if(first < e && std::abs(magnitude) > max_decimal_exponent)
+        throw std::invalid_argument("Bad value for " + optionName(name.c_str()) + ": " + value +
+                                    " (numbers go from 1e-" + std::to_string(max_decimal_exponent) + " to 1e" +
+                                    std::to_string(max_decimal_exponent) + ")");
+    return value;
+}
+
+
+// Whether a number checked by toNumber is positive, even if it is too small
+// for a double
+static bool isPositive(const std::string &number)
+{
+    return number[0] != '-' && number.find_first_of("123456789") < number.find_first_of("eE");
+}
+
+
+#define INT_OPTION(member) \
+    {#member, "N", [](RenderOptions &o, const std::string &v){ o.member = toInt(#member, v); }}
+#define DOUBLE_OPTION(member) \
+    {#member, "X", [](RenderOptions &o, const std::string &v){ o.member = toDouble(#member, v); }}
+#define NUMBER_OPTION(member) \
+    {#member, "X", [](RenderOptions &o, const std::string &v){ o.member = toNumber(#member, v); }}
+#define STRING_OPTION(member, argument) \
+    {#member, argument, [](RenderOptions &o, const std::string &v){ o.member = v; }}
+#define FLAG_OPTION(member) \
+    {#member, nullptr, [](RenderOptions &o, const std::string &){ o.member = true; }}
+
+static const std::vector<Option> &allOptions()
+{
+    static const std::vector<Option> options = {
+        INT_OPTION(max_iterations),
+        FLAG_OPTION(auto_iterations),
+        DOUBLE_OPTION(auto_iterations_threshold),
+        INT_OPTION(auto_iterations_limit),
+        NUMBER_OPTION(window_startx),
+        NUMBER_OPTION(window_width),
+        NUMBER_OPTION(window_starty),
+        NUMBER_OPTION(window_height),
+        INT_OPTION(image_width),
+        {"precision", "auto|float|double|extended", [](RenderOptions &o, const std::string &v)
+            {
+                if(v != "auto" && v != "float" && v != "double" && v != "extended")
+                    throw std::invalid_argument("Bad value for --precision: " + v);
+                o.precision = v;
+            }},
+        {"fractal", "mandelbrot|julia|multibrot|burning-ship", [](RenderOptions &o, const std::string &v)
+            {
+                if(v != "mandelbrot" && v != "julia" && v != "multibrot" && v != "burning-ship")
+                    throw std::invalid_argument("Bad value for --fractal: " + v);
+                o.fractal = v;
+            }},
+        NUMBER_OPTION(julia_cx),
+        NUMBER_OPTION(julia_cy),
+        INT_OPTION(multibrot_degree),
+        INT_OPTION(num_threads),
+        INT_OPTION(tile_size),
+        FLAG_OPTION(mariani_silver),
+        FLAG_OPTION(deep_zoom),
+        NUMBER_OPTION(deep_center_x),
+        NUMBER_OPTION(deep_center_y),
+        NUMBER_OPTION(deep_width),
+        INT_OPTION(zoom_frames),
+        DOUBLE_OPTION(zoom_factor),
+        DOUBLE_OPTION(zoom_center_x),
+        DOUBLE_OPTION(zoom_center_y),
+        FLAG_OPTION(zoom_final),
+        DOUBLE_OPTION(zoom_preview_tolerance),
+        DOUBLE_OPTION(zoom_final_tolerance),
+        FLAG_OPTION(exp_map),
+        STRING_OPTION(exp_map_file, "FILE"),
+        STRING_OPTION(output_file, "FILE"),
+        STRING_OPTION(smooth_file, "FILE"),
+        FLAG_OPTION(recolor_only),
+        DOUBLE_OPTION(palette_breakpoint),
+        FLAG_OPTION(streaming),
+        INT_OPTION(band_height),
+        STRING_OPTION(streaming_file, "FILE"),
+        INT_OPTION(num_encoder_threads),
+        INT_OPTION(max_queued_bands),
+        FLAG_OPTION(use_cache),
+        STRING_OPTION(cache_directory, "DIR"),
+        {"cache_max_bytes", "N", [](RenderOptions &o, const std::string &v)
+            {
+                const double bytes = toDouble("cache_max_bytes", v);
+                if(bytes < 0)
+                    throw std::invalid_argument("Bad value for --cache-max-bytes: " + v);
+                o.cache_max_bytes = bytes;
+            }},
+        FLAG_OPTION(pyramid),
+        STRING_OPTION(pyramid_name, "NAME"),
+        {"pyramid_layout", "dzi|xyz", [](RenderOptions &o, const std::string &v)
+            {
+                if(v != "dzi" && v != "xyz")
+                    throw std::invalid_argument("Bad value for --pyramid-layout: " + v);
+                o.pyramid_layout = v == "dzi" ? PyramidLayout::dzi : PyramidLayout::xyz;
+            }},
+        INT_OPTION(pyramid_tile_size),
+        FLAG_OPTION(antialias),
+        INT_OPTION(aa_grid),
+        DOUBLE_OPTION(aa_threshold),
+        FLAG_OPTION(distance_shading),
+        DOUBLE_OPTION(distance_shading_width),
+        DOUBLE_OPTION(aa_distance),
+        FLAG_OPTION(buddhabrot),
+        {"buddhabrot_samples", "N", [](RenderOptions &o, const std::string &v)
+            {
+                const double samples = toDouble("buddhabrot_samples", v);
+                if(samples < 1 || samples > 1e18)
+                    throw std::invalid_argument("Bad value for --buddhabrot-samples: " + v);
+                o.buddhabrot_samples = samples;
+            }},
+        INT_OPTION(buddhabrot_min_iterations),
+        FLAG_OPTION(buddhabrot_uniform),
+        DOUBLE_OPTION(buddhabrot_gamma),
+        INT_OPTION(buddhabrot_seed),
+        FLAG_OPTION(interactive),
+        STRING_OPTION(checkpoint_file, "FILE"),
+        DOUBLE_OPTION(checkpoint_interval),
+        FLAG_OPTION(resume),
+        STRING_OPTION(stats_file, "FILE"),
+        STRING_OPTION(heatmap_file, "FILE"),
+        STRING_OPTION(jobs_file, "FILE"),
+        FLAG_OPTION(help),
+    };
+    return options;
+}
+
+
+static void check(bool condition, const std::string &message)
+{
+    if(!condition)
+        throw std::invalid_argument(message);
+}
+
+
+void parseOptions(const std::vector<std::string> &args, RenderOptions &options)
+{
+    for(std::size_t k = 0; k < args.size(); ++k)
+    {
+        const Option *option = nullptr;
+        for(const Option &candidate : allOptions())
+            if(args[k] == optionName(candidate.name))
+                option = &candidate;
+        if(option == nullptr)
+            throw std::invalid_argument("Unknown option: " + args[k]);
+
+        if(option->argument == nullptr)
+        {
+            option->set(options, "");
+        }
+        else
+        {
+            if(k + 1 == args.size())
+                throw std::invalid_argument("Missing value for " + args[k]);
+            option->set(options, args[++k]);
+        }
+    }
+
+    check(options.max_iterations > 0, "--max-iterations must be positive");
+    check(options.auto_iterations_threshold > 0 && options.auto_iterations_threshold < 1,
+          "--auto-iterations-threshold must be between 0 and 1");
+    check(options.auto_iterations_limit > 0, "--auto-iterations-limit must be positive");
+    check(options.image_width > 0, "--image-width must be positive");
+    check(options.multibrot_degree >= 3 && options.multibrot_degree <= max_multibrot_degree,
+          "--multibrot-degree must be between 3 and " + std::to_string(max_multibrot_degree));
+    check(options.fractal == "mandelbrot" || (!options.deep_zoom && options.zoom_frames == 0 &&
+                                              !options.buddhabrot && !options.distance_shading),
+          "--fractal " + options.fractal + " doesn't go with deep zooms, zoom animations, the Buddhabrot "
+          "or distance shading");
+    check(options.tile_size > 0, "--tile-size must be positive");
+    check(options.band_height > 0, "--band-height must be positive");
+    check(options.max_queued_bands > 0, "--max-queued-bands must be positive");
+    check(options.aa_grid > 0, "--aa-grid must be positive");
+    check(options.distance_shading_width > 0, "--distance-shading-width must be positive");
+    check(!options.distance_shading || (!options.deep_zoom && options.zoom_frames == 0 &&
+                                        !options.mariani_silver && !options.use_cache && !options.recolor_only),
+          "--distance-shading doesn't go with deep zooms, zoom animations, Mariani-Silver, the tile cache "
+          "or recoloring");
+    check(options.zoom_factor > 0, "--zoom-factor must be positive");
+    check(!options.buddhabrot || options.buddhabrot_min_iterations < options.max_iterations,
+          "--buddhabrot-min-iterations must be less than --max-iterations");
+    check(options.buddhabrot_gamma > 0, "--buddhabrot-gamma must be positive");
+    check(!options.interactive || (!options.deep_zoom && options.zoom_frames == 0 && !options.buddhabrot &&
+                                   !options.distance_shading && !options.recolor_only && !options.streaming &&
+                                   !options.pyramid),
+          "--interactive doesn't go with deep zooms, zoom animations, the Buddhabrot, distance shading, "
+          "recoloring, streaming or pyramids");
+    check(options.checkpoint_interval >= 0, "--checkpoint-interval must not be negative");
+    check(!options.resume || !options.checkpoint_file.empty(), "--resume needs a --checkpoint-file");
+    check(options.checkpoint_file.empty() || (options.zoom_frames == 0 && !options.recolor_only &&
+                                              !options.buddhabrot && !options.interactive),
+          "--checkpoint-file doesn't go with zoom animations, recoloring, the Buddhabrot or interactive mode");
+    check(!options.recolor_only || !options.smooth_file.empty(), "--recolor-only needs a --smooth-file");
+    check(options.pyramid_tile_size > 0 && options.pyramid_tile_size % 2 == 0,
+          "--pyramid-tile-size must be positive and even");
+
+    // The window and the Julia constant are calculated in doubles as well
+    toDouble("window_startx", options.window_startx);
+    toDouble("window_starty", options.window_starty);
+    toDouble("julia_cx", options.julia_cx);
+    toDouble("julia_cy", options.julia_cy);
+    check(toDouble("window_width", options.window_width) > 0 && toDouble("window_height", options.window_height) > 0,
+          "The window must have a positive size");
+    check(isPositive(options.deep_width), "--deep-width must be positive");
+
+    // Zoom animations calculate whole frames in double precision, so they
+    // don't go with the options that change how or in what a view is
+    // calculated, and their last frame must be shallow enough for double
+    check(options.zoom_frames == 0 || (!options.deep_zoom && !options.streaming && !options.pyramid &&
+                                       !options.antialias && !options.mariani_silver && !options.use_cache &&
+                                       !options.recolor_only && !options.buddhabrot &&
+                                       (options.precision == "auto" || options.precision == "double")),
+          "--zoom-frames doesn't go with deep zooms, streaming, pyramids, antialiasing, Mariani-Silver, the tile "
+          "cache, recoloring, the Buddhabrot or a --precision other than double");
+    if(options.zoom_frames > 0)
+    {
+        const double last_spacing = std::stod(options.window_width) / options.image_width *
+                                    std::pow(options.zoom_factor, options.zoom_frames - 1);
+        check(selectPrecision(last_spacing) != Precision::extended,
+              "--zoom-frames " + std::to_string(options.zoom_frames) + " with --zoom-factor " +
+              std::to_string(options.zoom_factor) + " zooms in past double precision");
+    }
+}
+
+
+std::vector<RenderOptions> readJobFile(const std::string &path, const RenderOptions &defaults)
+{
+    std::ifstream file(path.c_str());
+    if(!file)
+        throw std::runtime_error("Can't read " + path);
+
+    std::vector<RenderOptions> jobs;
+    std::string line;
+    for(int number = 1; std::getline(file, line); ++number)
+    {
+        std::istringstream words(line);
+        std::vector<std::string> args;
+        for(std::string word; words >> word; )
+            args.push_back(word);
+        if(args.empty() || args[0][0] == '#')
+            continue;
+
+        RenderOptions job = defaults;
+        job.jobs_file.clear();
+        try
+        {
+            parseOptions(args, job);
+        }
+        catch(const std::invalid_argument &error)
+        {
+            throw std::invalid_argument(path + ":" + std::to_string(number) + ": " + error.what());
+        }
+        if(!job.jobs_file.empty())
+            throw std::invalid_argument(path + ":" + std::to_string(number) + ": jobs can't have jobs of their own");
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+
+std::string usage()
+{
+    std::string text = "Usage: prog [options]\n\nOptions:\n";
+    for(const Option &option : allOptions())
+    {
+        text += "  " + optionName(option.name);
+        if(option.argument != nullptr)
+            text += std::string(" ") + option.argument;
+        text += "\n";
+    }
+    return text;
+}
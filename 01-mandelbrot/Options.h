@@ -0,0 +1,238 @@
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TilePyramid.h"
+
+// The multibrots are instantiated for the degrees from 3 up to this one
+const int max_multibrot_degree = 8;
+
+// The decimal numbers of the view go from 1e-4000 to 1e4000 in magnitude: deep
+// zooms down to that take hundreds of limbs already (see BigFixed.h)
+const int max_decimal_exponent = 4000;
+
+// The settings of a render.  The defaults render the whole set into
+// mandelbrot.png.
+//
+// Every setting can be given on the command line as an option named after
+// it, with dashes for underscores: --image-width 640, --max-iterations 5000,
+// --antialias.  A job file renders a batch of views in one process: each
+// line holds the options of one render, on top of those of the command line.
+struct RenderOptions
+{
+    int max_iterations = 1000;
+
+    // Estimate the budget the view needs instead (see IterationBudget.h): start
+    // small, and double it until a doubling lets fewer than
+    // auto_iterations_threshold of the pixels that were still unescaped escape,
+    // up to auto_iterations_limit.  Zoom animations use max_iterations, and
+    // recoloring the budget that was saved with the smooth file.
+    bool auto_iterations = false;
+    double auto_iterations_threshold = 0.01;
+    int auto_iterations_limit = 1 << 20;
+
+    // The view: the top left corner of the window and its size, as decimal
+    // numbers, so that they can be parsed to the full precision of the number type
+    std::string window_startx = "-1.9";
+    std::string window_width = "2.5";
+    std::string window_starty = "1.2";
+    std::string window_height = "1.2";
+
+    // The height follows from the aspect ratio of the window
+    int image_width = 2000;
+
+    // The fractal family: mandelbrot, julia (the filled Julia set of julia_cx +
+    // julia_cy i), multibrot (z^multibrot_degree + c) or burning-ship.  The
+    // families other than the Mandelbrot set use the generic escape time loop
+    // (see EscapeTime.h) in double or wider, and don't go with deep zooms, zoom
+    // animations, the Buddhabrot or distance shading.
+    std::string fractal = "mandelbrot";
+    std::string julia_cx = "-0.8";
+    std::string julia_cy = "0.156";
+    int multibrot_degree = 3;
+
+    // The precision of the escape time loop: auto, float, double or extended
+    // (see selectPrecision).  auto picks the narrowest one that the pixel
+    // spacing allows, so shallow views get twice as many SIMD lanes.
+    std::string precision = "auto";
+
+    // Rendering is split into tiles, which are run on a work-stealing thread
+    // pool of num_threads threads (0 means one per core)
+    unsigned num_threads = 0;
+    int tile_size = 64;
+
+    // Mariani-Silver subdivision skips the insides of rectangles whose border
+    // has a uniform escape time.  It is much faster, but can miss details
+    // thinner than a pixel.
+    bool mariani_silver = false;
+
+    // Deep zoom mode renders the view centered on (deep_center_x, deep_center_y)
+    // with a width of deep_width, using perturbation theory and BLA iteration
+    // skipping.  The center is given with as many digits as the zoom needs, and
+    // the width can go far below 1e-300.
+    bool deep_zoom = false;
+    std::string deep_center_x = "-0.743643887037158704752191506114774";
+    std::string deep_center_y = "0.131825904205311970493132056385139";
+    std::string deep_width = "1e-30";
+
+    // Zoom animation mode renders zoom_frames frames, zooming in on
+    // (zoom_center_x, zoom_center_y) by zoom_factor per frame from the width of
+    // the window.  Preview frames reuse every sample of the previous frame that
+    // is within zoom_preview_tolerance pixels, and only calculate the rest;
+    // final frames reuse samples within zoom_final_tolerance pixels (0
+    // calculates every pixel).  The two are written to different files, and
+    // final frames never reuse samples of preview frames: frame 12 of a zoom
+    // to output_file mandelbrot.png goes to mandelbrot-00012.png, or as a
+    // preview to mandelbrot-preview-00012.png.  Frames are calculated in double
+    // precision, so the last one must be shallow enough for it, and zooms
+    // don't go with deep zooms, streaming, pyramids, antialiasing,
+    // Mariani-Silver, the tile cache, recoloring or the Buddhabrot.
+    int zoom_frames = 0;
+    double zoom_factor = 0.98;
+    double zoom_center_x = -0.743643887037151;
+    double zoom_center_y = 0.131825904205330;
+    bool zoom_final = false;
+    double zoom_preview_tolerance = 0.5;
+    double zoom_final_tolerance = 0;
+
+    // Exponential map mode renders the frames of the zoom animation from a
+    // single log-polar strip around the zoom center instead, which calculates
+    // every point of the zoom only once.  If exp_map_file is given, the
+    // smooth iteration counts of the strip are saved to it.
+    bool exp_map = false;
+    std::string exp_map_file;
+
+    // The image is written to output_file, and if smooth_file is given, its
+    // smooth iteration counts to smooth_file, so that it can be recolored later
+    // (recolor_only, which reads them back from smooth_file) without
+    // recalculating it.  The iteration budget they were calculated with goes
+    // to smooth_file.budget, and recoloring uses it instead of max_iterations,
+    // which it falls back on for smooth files without one.
+    std::string output_file = "mandelbrot.png";
+    std::string smooth_file;
+    bool recolor_only = false;
+    double palette_breakpoint = 0.28;
+
+    // Streaming mode renders the image in bands of band_height rows, and encodes
+    // every band as soon as it is done, so the memory use depends on the band
+    // size instead of the image size.  It writes streaming_file (.png, .tif or
+    // .tiff), and doesn't save the smooth iteration counts.  With antialiasing,
+    // a band is held back until the next one is rendered, so that the pixels
+    // along the seams are antialiased as in the whole image.  That takes twice
+    // the memory.
+    bool streaming = false;
+    int band_height = 256;
+    std::string streaming_file = "mandelbrot.tiff";
+
+    // When streaming, the bands are compressed by num_encoder_threads encoder
+    // threads (0 means one per core) while the next bands are rendered.  At
+    // most max_queued_bands finished bands wait for the encoders.
+    unsigned num_encoder_threads = 0;
+    int max_queued_bands = 2;
+
+    // The tile cache keeps the smooth iteration counts of rendered tiles in
+    // cache_directory, so rendering a view again (to recolor it, or as part of
+    // a pyramid) loads them instead of calculating them.  Tiles are keyed by
+    // the view as it was given, the image size, their position in the image,
+    // max_iterations and the precision, so only exact repeats of a view hit:
+    // a view that overlaps a cached one, or is panned by a few pixels, misses
+    // every tile.  Beyond cache_max_bytes, the least recently used tiles are
+    // deleted.
+    bool use_cache = false;
+    std::string cache_directory = "mandelbrot-cache";
+    std::uint64_t cache_max_bytes = 1ull << 30;
+
+    // Pyramid mode writes the image as a tile pyramid for pan and zoom viewers
+    // instead: pyramid_name.dzi and pyramid_name_files/ for Deep Zoom, or
+    // pyramid_name/z/x/y.png for XYZ.  Only the tiles of the current path down
+    // the pyramid are in memory, so it works for images of any size.  The
+    // tiles aren't anti-aliased.
+    bool pyramid = false;
+    std::string pyramid_name = "mandelbrot";
+    PyramidLayout pyramid_layout = PyramidLayout::dzi;
+    int pyramid_tile_size = 256;
+
+    // Anti-aliasing supersamples the pixels whose smooth iteration count differs
+    // from a neighbour's by more than aa_threshold, with aa_grid x aa_grid
+    // jittered samples.  Recoloring a saved render leaves out the anti-aliasing.
+    bool antialias = false;
+    int aa_grid = 4;
+    float aa_threshold = 1.0f;
+
+    // Distance shading darkens the pixels within distance_shading_width pixels
+    // of the set by their distance estimate (see escapeTimeWithDistance), which
+    // brings out the filaments too thin for the escape times.  Anti-aliasing then
+    // also supersamples the pixels within aa_distance pixels of the set.  It
+    // needs the distance of every pixel, so it doesn't go with deep zooms, zoom
+    // animations, Mariani-Silver, the tile cache or recoloring.
+    bool distance_shading = false;
+    float distance_shading_width = 1.0f;
+    float aa_distance = 1.0f;
+
+    // Buddhabrot mode renders the density of the escaping orbits in the window
+    // instead, as a gray image in output_file (see Buddhabrot.h).  It draws
+    // buddhabrot_samples points, by the importance map unless buddhabrot_uniform,
+    // and counts the ones that escape after buddhabrot_min_iterations up to
+    // max_iterations.
+    bool buddhabrot = false;
+    long long buddhabrot_samples = 100000000;
+    int buddhabrot_min_iterations = 20;
+    bool buddhabrot_uniform = false;
+    double buddhabrot_gamma = 0.5;
+    int buddhabrot_seed = 1;
+
+    // Interactive mode opens a window on the view instead of writing it (see
+    // runExplorer in main.cpp), to pan and zoom around with the mouse.  Every
+    // view is rendered progressively, starting with previews at 1/16 and 1/4 of
+    // the resolution, and moving on cancels the rendering of the last one.  It
+    // starts with max_iterations, which can be doubled up to
+    // auto_iterations_limit.  It doesn't go with deep zooms, zoom animations,
+    // the Buddhabrot, distance shading, recoloring, streaming or pyramids.
+    bool interactive = false;
+
+    // Checkpointing writes every finished tile, and the reference orbit of a
+    // deep zoom as it is calculated, to checkpoint_file (see Checkpoint.h) every
+    // checkpoint_interval seconds.  With resume, a render that was killed picks
+    // up the checkpoint of its earlier run and only calculates what is missing
+    // from it; if there is no checkpoint yet, it starts from scratch.  Zoom
+    // animations, recoloring, the Buddhabrot and interactive mode aren't
+    // checkpointed, and neither is the anti-aliasing pass.
+    std::string checkpoint_file;
+    double checkpoint_interval = 60;
+    bool resume = false;
+
+    // Instrumentation: the wall time, iteration counts and escape time histogram
+    // of every tile are written to stats_file (.json or .csv), and a heatmap of
+    // the time spent per pixel to heatmap_file (.png, .tif or .tiff).  Either is
+    // left out if its name is empty.  Zoom animations aren't instrumented.
+    std::string stats_file;
+    std::string heatmap_file;
+
+    // Render the views in jobs_file, one per line, instead of a single view.
+    // The jobs share the thread pools, palettes and tile caches, so the thread
+    // counts of the command line apply to all of them.
+    std::string jobs_file;
+
+    bool help = false;
+};
+
+
+// Apply options given as on the command line, e.g. {"--image-width", "640"},
+// and check the result.  Throws std::invalid_argument for unknown options and
+// bad values.
+void parseOptions(const std::vector<std::string> &args, RenderOptions &options);
+
+// Read a job file: one render per line, as options on top of the defaults.
+// Blank lines and lines starting with # are skipped.  Throws
+// std::invalid_argument (naming the line) for bad jobs, and std::runtime_error
+// if the file can't be read.
+std::vector<RenderOptions> readJobFile(const std::string &path, const RenderOptions &defaults);
+
+// The list of options, for --help
+std::string usage();
+
+
+#endif  // OPTIONS_H_
@@ -0,0 +1,148 @@
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Coloring of rendered images.
+//
+// Rendering produces a buffer of smooth iteration counts (see
+// smoothIterations), and colorize() turns that into a BGR image in a separate
+// pass.  The colors come from a lookup table of a fixed size, indexed by the
+// smooth iteration count as a fraction of the iteration budget, so the pass is
+// just a multiply and a table lookup per pixel, the table's size doesn't grow
+// with the budget, and an existing render can be recolored with a different
+// palette without recalculating it.
+
+
+// The smooth iteration count of a pixel with escape time n, where norm is
+// |z|^2 after the last iteration, for a fractal whose iteration has the given
+// degree.  Points that never escaped get max_iterations.
+inline float smoothIterations(int n, double norm, int max_iterations, int degree = 2)
+{
+    if(n == max_iterations)
+        return n;
+    return n + 1 - std::log(std::log(std::sqrt(norm)))/std::log(degree);
+}
+
+
+// A color at a position between 0 and 1 along the palette
+struct PaletteStop
+{
+    double position;
+    unsigned char b, g, r;
+};
+
+
+class Palette
+{
+public:
+
+    // Number of table entries, for evenly spaced fractions of the budget
+    static const int table_size = 65536;
+
+    // A palette that runs through the given stops (sorted by position, from 0
+    // to 1), for smooth iteration counts from 0 to max_iterations.  The position
+    // along the palette is  sqrt(smooth / max_iterations),  which spreads out
+    // the low iteration counts where most of the detail is.
+    Palette(const std::vector<PaletteStop> &stops, int max_iterations)
+        : table_(table_size), scale_(1.0f / max_iterations)
+    {
+        for(std::size_t k = 0; k < table_.size(); ++k)
+        {
+            const double shade = std::sqrt(static_cast<double>(k) / (table_.size() - 1));
+
+            std::size_t s = 1;
+            while(s + 1 < stops.size() && shade >= stops[s].position)
+                ++s;
+            const PaletteStop &from = stops[s-1];
+            const PaletteStop &to = stops[s];
+            const double t = (shade - from.position) / (to.position - from.position);
+
+            const int B = (1-t)*from.b + t*to.b;
+            const int G = (1-t)*from.g + t*to.g;
+            const int R = (1-t)*from.r + t*to.r;
+            table_[k] = B | (G << 8) | (R << 16);
+        }
+    }
+
+    // The original palette: from black to a pale blue at the breakpoint, then to white
+    static Palette standard(int max_iterations, double breakpoint = 0.28)
+    {
+        std::vector<PaletteStop> stops;
+        stops.push_back({0.0, 0, 0, 0});
+        stops.push_back({breakpoint, 240, 180, 190});
+        stops.push_back({1.0, 255, 255, 255});
+        return Palette(stops, max_iterations);
+    }
+
+    // The colors, packed as B | G << 8 | R << 16
+    const std::uint32_t *table() const {return table_.data();}
+    int size() const {return table_.size();}
+
+    // The factor from smooth iteration counts to fractions of the budget
+    float scale() const {return scale_;}
+
+private:
+
+    std::vector<std::uint32_t> table_;
+    float scale_;
+};
+
+
+// Color  count  pixels from their smooth iteration counts, into 3 bytes (BGR) per pixel
+inline void colorize(const float *smooth, int count, const Palette &palette, unsigned char *bgr)
+{
+    const std::uint32_t *table = palette.table();
+    const float last = palette.size() - 1;
+    const float scale = palette.scale()*last;
+
+    // Work in chunks, so that the index calculation is a separate loop that the
+    // compiler can vectorize
+    const int chunk = 256;
+    int index[chunk];
+
+    for(int start = 0; start < count; start += chunk)
+    {
+        const int length = std::min(chunk, count - start);
+
+        for(int i = 0; i < length; ++i)
+        {
+            float k = smooth[start + i]*scale + 0.5f;
+            k = std::min(std::max(k, 0.0f), last);
+            index[i] = static_cast<int>(k);
+        }
+
+        unsigned char *out = bgr + 3*start;
+        for(int i = 0; i < length; ++i)
+        {
+            const std::uint32_t color = table[index[i]];
+            out[3*i] = color;
+            out[3*i + 1] = color >> 8;
+            out[3*i + 2] = color >> 16;
+        }
+    }
+}
+
+
+
+// Distance shading: darken the colors of  count  pixels (3 bytes, BGR) within
+// width  of the set by  distance / width,  where distance is their distance
+// estimate (see escapeTimeWithDistance) in pixels.  Filaments too thin for
+// the escape times to show come out as dark lines, and the set itself, at
+// distance 0, as black.
+inline void shadeByDistance(const float *distance, int count, float width, unsigned char *bgr)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        if(distance[i] >= width)
+            continue;
+        const float shade = std::max(distance[i], 0.0f) / width;
+        for(int c = 0; c < 3; ++c)
+            bgr[3*i + c] = static_cast<unsigned char>(bgr[3*i + c]*shade + 0.5f);
+    }
+}
+
+#endif  // PALETTE_H_
@@ -0,0 +1,388 @@
+#ifndef PERTURBATION_H_
+#define PERTURBATION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BigFixed.h"
+#include "EscapeTime.h"
+
+// Deep zoom rendering with perturbation theory.
+//
+// Past a zoom of about 1e-13 the pixels of a view can no longer be told apart
+// in double precision.  Instead of iterating every pixel with arbitrary
+// precision, only one reference point C at the center of the view is iterated
+// with arbitrary precision, and its orbit Z_n is stored in double precision.
+// Every pixel c = C + dc is then iterated as a small difference d_n from the
+// reference orbit, which only needs double precision:
+//
+//     z_n = Z_n + d_n
+//     d_n+1 = 2*Z_n*d_n + d_n^2 + dc
+//
+// Glitches (where the pixel's orbit gets much closer to 0 than the reference
+// orbit does, so that d_n loses all its precision) are detected with the test
+// |z_n| < |d_n|, and fixed by rebasing: the pixel carries on with d_n = z_n
+// from the start of the reference orbit (Z_0 = 0).  The same rebasing lets a
+// pixel carry on after the reference orbit has escaped.
+//
+// Beyond a zoom of about 1e-290, dc and d_n are smaller than the smallest
+// double, so they are kept as a double times a power of two 2^e instead.  The
+// exponent e is shared by d_n and dc, and is moved up in big steps as d_n
+// grows.  Once d_n is back in the normal range of a double, the pixel
+// carries on with plain doubles.
+
+
+// Parse a positive decimal number that may be far outside the range of a double
+// (such as "2.5e-1000") into  mantissa * 2^exponent,  with 0.5 <= mantissa < 1
+inline void parseScale(const std::string &text, double &mantissa, int &exponent)
+{
+    std::size_t e = text.find_first_of("eE");
+    long double significand = std::stold(text.substr(0, e));
+    long decimal_exponent = e == std::string::npos ? 0 : std::stol(text.substr(e + 1));
+
+    long double log2_value = std::log2(significand) + decimal_exponent*std::log2(10.0L);
+    exponent = static_cast<int>(std::floor(log2_value)) + 1;
+    mantissa = static_cast<double>(std::exp2(log2_value - exponent));
+}
+
+
+// The orbit Z_0 = 0, Z_1 = C, ... of a reference point C, calculated with
+// arbitrary precision and stored in double precision.  The orbit ends at the
+// first point that escapes, or after max_iterations + 1 iterations.
+//
+// At high iteration counts and precisions the orbit takes long enough to be
+// worth calculating in steps (see extend), and resuming from a checkpoint: the
+// doubles of the points so far and the last point in full precision are all
+// it takes to carry on.
+class ReferenceOrbit
+{
+public:
+
+    // Calculate the first  iterations  iterations of the orbit of (cx, cy), all of
+    // them by default
+    ReferenceOrbit(const BigFixed &cx, const BigFixed &cy, int max_iterations,
+                   int iterations = std::numeric_limits<int>::max())
+        : cx_(cx), cy_(cy), max_iterations_(max_iterations), last_x_(cx.fractionLimbs()),
+          last_y_(cy.fractionLimbs()), x_(1, 0.0), y_(1, 0.0)
+    {
+        extend(iterations);
+    }
+
+    // Resume an orbit from its points so far and the last of them, last_x + last_y i,
+    // in full precision
+    ReferenceOrbit(const BigFixed &cx, const BigFixed &cy, int max_iterations, const std::vector<double> &x,
+                   const std::vector<double> &y, const BigFixed &last_x, const BigFixed &last_y)
+        : cx_(cx), cy_(cy), max_iterations_(max_iterations), last_x_(last_x), last_y_(last_y), x_(x), y_(y)
+    {
+        if(x_.empty() || x_.size() != y_.size())
+            throw std::invalid_argument("A reference orbit needs its first point");
+    }
+
+    // Calculate up to  iterations  more iterations.  Returns finished().
+    bool extend(int iterations)
+    {
+        for(; iterations > 0 && !finished(); --iterations)
+        {
+            BigFixed temp = last_x_;
+            last_x_ = (last_x_ + last_y_)*(last_x_ - last_y_) + cx_;
+            last_y_ = (temp*last_y_).twice() + cy_;
+
+            x_.push_back(last_x_.toDouble());
+            y_.push_back(last_y_.toDouble());
+        }
+        return finished();
+    }
+
+    // Whether the orbit has escaped, or has all of its iterations
+    bool finished() const
+    {
+        return size() > max_iterations_ + 1 || x_.back()*x_.back() + y_.back()*y_.back() > escape_radius_squared;
+    }
+
+    const std::vector<double> &x() const {return x_;}
+    const std::vector<double> &y() const {return y_;}
+    int size() const {return x_.size();}
+
+    const BigFixed &lastX() const {return last_x_;}
+    const BigFixed &lastY() const {return last_y_;}
+
+private:
+
+    BigFixed cx_, cy_;
+    int max_iterations_;
+    BigFixed last_x_, last_y_;
+    std::vector<double> x_;
+    std::vector<double> y_;
+};
+
+
+// A table of bivariate linear approximations (BLA) of the perturbed iteration.
+//
+// While d_n is small next to Z_n, the d_n^2 term hardly matters, and one step
+// is just the linear map  d -> A*d + B*dc  with A = 2*Z_n and B = 1.  A run of
+// linear steps merges into a single linear step, so a pixel can skip a whole
+// block of iterations with one complex multiply-add, as long as |d| stays
+// within the block's radius of validity.  At deep zooms, where every pixel
+// follows the reference orbit closely for most of its iterations, this skips
+// nearly all of the work.
+//
+// The table is a binary tree: level k holds blocks of 2^k steps that start at
+// the reference iterations 1 + j*2^k.  Merging block x followed by block y
+// gives
+//
+//     A = Ay*Ax,   B = Ay*Bx + By,   r = min(rx, (ry - |Bx|*max|dc|) / |Ax|)
+//
+// where the radius of a single step is  epsilon*|Z_n|,  which keeps the
+// neglected d_n^2 term below epsilon times the linear term.
+
+class BlaTable
+{
+public:
+
+    // One block of steps:  d -> A*d + B*dc,  valid while |d| < r
+    struct Step
+    {
+        double ax, ay;
+        double bx, by;
+        double r;
+        double growth;  // |A|
+        int length;
+    };
+
+    // max_dc is the largest |dc| of any pixel in the view
+    BlaTable(const ReferenceOrbit &orbit, double max_dc, double epsilon = std::ldexp(1.0, -53))
+    {
+        const double *X = orbit.x().data();
+        const double *Y = orbit.y().data();
+        const int last = orbit.size() - 1;
+
+        // Single steps, from Z_1 up to the end of the reference orbit
+        std::vector<Step> level;
+        for(int m = 1; m < last; ++m)
+        {
+            Step step;
+            step.ax = 2*X[m];
+            step.ay = 2*Y[m];
+            step.bx = 1;
+            step.by = 0;
+            step.r = epsilon*std::hypot(X[m], Y[m]);
+            step.growth = 2*std::hypot(X[m], Y[m]);
+            step.length = 1;
+            level.push_back(step);
+        }
+        levels_.push_back(level);
+
+        // Merge pairs of blocks into blocks twice as long
+        while(levels_.back().size() > 1)
+        {
+            const std::vector<Step> &previous = levels_.back();
+            std::vector<Step> next;
+            for(std::size_t j = 0; j + 1 < previous.size(); j += 2)
+                next.push_back(merge(previous[j], previous[j+1], max_dc));
+            levels_.push_back(next);
+        }
+    }
+
+    // Find the longest block that starts at reference iteration m, is valid for
+    // |d| = d, is no longer than max_length, and doesn't grow d by more than a
+    // factor of max_growth.  Returns nullptr if there is none.
+    const Step *find(int m, double d, int max_length, double max_growth = HUGE_VAL) const
+    {
+        // A merged block is never valid for a larger |d| than its first step,
+        // so there is nothing to find if the single step isn't valid
+        if(m < 1 || m > static_cast<int>(levels_[0].size()) || !(d < levels_[0][m-1].r))
+            return nullptr;
+
+        // Blocks on level k only start at multiples of 2^k
+        const int j = m - 1;
+        int k = levels_.size() - 1;
+        while(k > 0 && (j & ((1 << k) - 1)) != 0)
+            --k;
+
+        for(; k >= 0; --k)
+        {
+            const std::vector<Step> &level = levels_[k];
+            const std::size_t index = j >> k;
+            if(index < level.size() && d < level[index].r && level[index].length <= max_length &&
+               level[index].growth <= max_growth)
+                return &level[index];
+        }
+        return nullptr;
+    }
+
+    int levels() const {return levels_.size();}
+
+private:
+
+    static Step merge(const Step &x, const Step &y, double max_dc)
+    {
+        Step step;
+        step.ax = y.ax*x.ax - y.ay*x.ay;
+        step.ay = y.ax*x.ay + y.ay*x.ax;
+        step.bx = y.ax*x.bx - y.ay*x.by + y.bx;
+        step.by = y.ax*x.by + y.ay*x.bx + y.by;
+        step.length = x.length + y.length;
+
+        // Long blocks along a chaotic orbit can overflow; those are never valid
+        const double ax = std::hypot(x.ax, x.ay);
+        const double ry = y.r - std::hypot(x.bx, x.by)*max_dc;
+        step.growth = std::hypot(step.ax, step.ay);
+        if(!std::isfinite(step.growth) || !std::isfinite(step.bx) || !std::isfinite(step.by) || !(ry > 0))
+            step.r = 0;
+        else if(ax == 0)
+            step.r = x.r;
+        else
+            step.r = std::min(x.r, ry / ax);
+
+        return step;
+    }
+
+    std::vector<std::vector<Step> > levels_;
+};
+
+
+// Calculate the escape time of  count  points  c = C + dc  relative to the
+// reference point C, where  dc = (dcx[i], dcy[i]) * 2^exponent.
+// If a BLA table is given, it is used to skip iterations.
+// The results are the same as for an EscapeKernel.
+inline void perturbationEscapeTime(const ReferenceOrbit &orbit, const BlaTable *table,
+                                   const double *dcx, const double *dcy, int exponent, int count,
+                                   int max_iterations, int *iterations, double *norm)
+{
+    // Smallest exponent at which d_n and dc are still plain doubles
+    const int min_exponent = -960;
+
+    // How far apart the exponent moves while d_n is scaled
+    const int rescale_step = 256;
+    const double rescale_limit = std::ldexp(1.0, rescale_step);
+
+    const double *X = orbit.x().data();
+    const double *Y = orbit.y().data();
+    const int last = orbit.size() - 1;
+
+    for(int i = 0; i < count; ++i)
+    {
+        // Start at z_1 = c, so that the count matches the plain escape time
+        // loop.  n counts the iterations done so far.
+        int n = 0;
+        int m = 1;
+        int e = exponent;
+        double dx = dcx[i];
+        double dy = dcy[i];
+        double zx = X[1];
+        double zy = Y[1];
+        bool escaped = false;
+
+        if(e >= min_exponent)
+        {
+            dx = std::ldexp(dx, e);
+            dy = std::ldexp(dy, e);
+            e = 0;
+        }
+
+        // dc in the same scale as d_n
+        double ux = dx;
+        double uy = dy;
+
+        // Scaled iterations, while d_n is too small for a double.
+        // z_n is just Z_n here, since d_n is far below its precision.
+        while(e != 0 && n < max_iterations)
+        {
+            // Scaled d_n must not overflow, so limit how much a block may grow it
+            const BlaTable::Step *step = table ? table->find(m, std::ldexp(std::sqrt(dx*dx + dy*dy), e),
+                                                             max_iterations - n, rescale_limit) : nullptr;
+            if(step)
+            {
+                const double tx = step->ax*dx - step->ay*dy + step->bx*ux - step->by*uy;
+                dy = step->ax*dy + step->ay*dx + step->bx*uy + step->by*ux;
+                dx = tx;
+                m += step->length;
+                n += step->length;
+            }
+            else
+            {
+                const double tx = 2*(X[m]*dx - Y[m]*dy) + std::ldexp(dx*dx - dy*dy, e) + ux;
+                dy = 2*(X[m]*dy + Y[m]*dx) + std::ldexp(2*dx*dy, e) + uy;
+                dx = tx;
+                ++m;
+                ++n;
+            }
+
+            zx = X[m];
+            zy = Y[m];
+            if(zx*zx + zy*zy > escape_radius_squared)
+            {
+                escaped = true;
+                break;
+            }
+
+            while(e != 0 && std::max(std::fabs(dx), std::fabs(dy)) > rescale_limit)
+            {
+                dx = std::ldexp(dx, -rescale_step);
+                dy = std::ldexp(dy, -rescale_step);
+                ux = std::ldexp(ux, -rescale_step);
+                uy = std::ldexp(uy, -rescale_step);
+                e += rescale_step;
+
+                if(e >= min_exponent)
+                {
+                    dx = std::ldexp(dx, e);
+                    dy = std::ldexp(dy, e);
+                    ux = std::ldexp(ux, e);
+                    uy = std::ldexp(uy, e);
+                    e = 0;
+                }
+            }
+        }
+
+        // Plain double iterations
+        while(!escaped && n < max_iterations)
+        {
+            const BlaTable::Step *step = table ? table->find(m, std::sqrt(dx*dx + dy*dy), max_iterations - n) : nullptr;
+            if(step)
+            {
+                const double tx = step->ax*dx - step->ay*dy + step->bx*ux - step->by*uy;
+                dy = step->ax*dy + step->ay*dx + step->bx*uy + step->by*ux;
+                dx = tx;
+                m += step->length;
+                n += step->length;
+            }
+            else
+            {
+                const double tx = 2*(X[m]*dx - Y[m]*dy) + (dx*dx - dy*dy) + ux;
+                dy = 2*(X[m]*dy + Y[m]*dx) + 2*dx*dy + uy;
+                dx = tx;
+                ++m;
+                ++n;
+            }
+
+            zx = X[m] + dx;
+            zy = Y[m] + dy;
+            const double r2 = zx*zx + zy*zy;
+            if(r2 > escape_radius_squared)
+            {
+                escaped = true;
+                break;
+            }
+
+            // Rebase on a glitch, or when the reference orbit runs out
+            if(r2 < dx*dx + dy*dy || m == last)
+            {
+                dx = zx;
+                dy = zy;
+                m = 0;
+            }
+        }
+
+        // The escape time is the number of iterations before the one that escaped
+        iterations[i] = escaped ? n - 1 : n;
+        norm[i] = zx*zx + zy*zy;
+    }
+}
+
+
+#endif  // PERTURBATION_H_
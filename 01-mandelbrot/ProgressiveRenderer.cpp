@@ -0,0 +1,190 @@
+#include "ProgressiveRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+ProgressiveRenderer::ProgressiveRenderer(ThreadPool &pool, int width, int height)
+    : pool_(pool), width_(width), height_(height), frame_(static_cast<std::size_t>(width)*height*3, 0),
+      requested_(0), completed_(0), published_(frame_.size(), 0), published_step_(0), stopping_(false),
+      latest_(0), thread_(&ProgressiveRenderer::run, this)
+{
+}
+
+
+ProgressiveRenderer::~ProgressiveRenderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        ++latest_;
+    }
+    changed_.notify_all();
+    thread_.join();
+}
+
+
+void ProgressiveRenderer::start(ColorPoints colorPoints)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        request_ = std::move(colorPoints);
+        latest_ = ++requested_;
+    }
+    changed_.notify_all();
+}
+
+
+int ProgressiveRenderer::takeFrame(unsigned char *bgr)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(exception_)
+    {
+        std::exception_ptr exception = exception_;
+        exception_ = nullptr;
+        std::rethrow_exception(exception);
+    }
+
+    const int step = published_step_;
+    if(step != 0)
+        std::memcpy(bgr, published_.data(), published_.size());
+    published_step_ = 0;
+    return step;
+}
+
+
+void ProgressiveRenderer::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this]{ return completed_ == requested_ || exception_; });
+    if(exception_)
+    {
+        std::exception_ptr exception = exception_;
+        exception_ = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+
+bool ProgressiveRenderer::renderPass(unsigned frame, const ColorPoints &colorPoints, int step, int previous_step)
+{
+    for(int row = 0; row < height_; row += step)
+    {
+        pool_.submit([=, &colorPoints]
+        {
+            if(latest_ != frame)
+                return;
+
+            // The points of the row that the earlier passes skipped
+            std::vector<double> x, y;
+            const bool on_previous_row = previous_step != 0 && row % previous_step == 0;
+            for(int col = 0; col < width_; col += step)
+            {
+                if(on_previous_row && col % previous_step == 0)
+                    continue;
+                x.push_back(col);
+                y.push_back(row);
+            }
+            if(x.empty())
+                return;
+
+            std::vector<unsigned char> colors(x.size()*3);
+            colorPoints(x.data(), y.data(), x.size(), colors.data());
+
+            // Paint their blocks; the blocks of different rows don't overlap
+            const int rows = std::min(step, height_ - row);
+            for(std::size_t i = 0; i < x.size(); ++i)
+            {
+                const int col = static_cast<int>(x[i]);
+                const int cols = std::min(step, width_ - col);
+                for(int r = 0; r < rows; ++r)
+                {
+                    unsigned char *pixel = &frame_[(static_cast<std::size_t>(row + r)*width_ + col)*3];
+                    for(int c = 0; c < cols; ++c, pixel += 3)
+                        std::memcpy(pixel, &colors[i*3], 3);
+                }
+            }
+        });
+    }
+    pool_.wait();
+    return latest_ == frame;
+}
+
+
+void ProgressiveRenderer::run()
+{
+    while(true)
+    {
+        unsigned frame;
+        ColorPoints colorPoints;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this]{ return stopping_ || completed_ != requested_; });
+            if(stopping_)
+                return;
+            frame = requested_;
+            colorPoints = request_;
+        }
+
+        try
+        {
+            int previous_step = 0;
+            for(int step : progressive_steps)
+            {
+                if(!renderPass(frame, colorPoints, step, previous_step))
+                    break;
+                previous_step = step;
+
+                // A newer frame may have been started after the pass
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(requested_ != frame)
+                    break;
+                published_ = frame_;
+                published_step_ = step;
+                if(step == 1)
+                    completed_ = frame;
+            }
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            exception_ = std::current_exception();
+            completed_ = frame;
+        }
+        changed_.notify_all();
+    }
+}
+
+
+void reprojectFrame(const unsigned char *previous, int width, int height, double origin_x, double origin_y,
+                    double scale, unsigned char *bgr)
+{
+    // The source column of every destination column, or -1 outside of the frame
+    std::vector<int> source_col(width);
+    for(int col = 0; col < width; ++col)
+    {
+        const double x = std::floor(origin_x + col*scale + 0.5);
+        source_col[col] = x >= 0 && x < width ? static_cast<int>(x) : -1;
+    }
+
+    for(int row = 0; row < height; ++row)
+    {
+        unsigned char *out = bgr + static_cast<std::size_t>(row)*width*3;
+        const double y = std::floor(origin_y + row*scale + 0.5);
+        if(!(y >= 0 && y < height))
+        {
+            std::memset(out, 0, static_cast<std::size_t>(width)*3);
+            continue;
+        }
+
+        const unsigned char *in = previous + static_cast<std::size_t>(y)*width*3;
+        for(int col = 0; col < width; ++col, out += 3)
+        {
+            if(source_col[col] < 0)
+                std::memset(out, 0, 3);
+            else
+                std::memcpy(out, in + source_col[col]*3, 3);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef PROGRESSIVE_RENDERER_H_
+#define PROGRESSIVE_RENDERER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Progressive rendering for the interactive explorer.
+//
+// A frame is rendered in passes on grids of every 16th, every 4th and every
+// pixel.  Every pass calculates the points of its grid that the earlier passes
+// haven't, and paints each one over the step x step block of pixels it stands
+// for, so the first pass gives a preview from 1/256 of the points, and the
+// last one leaves every pixel with its own color.  No point is calculated
+// twice.
+//
+// The passes run on the thread pool, driven by a thread of the renderer, so
+// starting a frame never blocks.  Starting a frame cancels the one in flight:
+// its tasks see that a newer frame was started, and return before their next
+// row of points, so a new frame is delayed by at most a row of the old one.
+
+// The grid steps of the passes, coarsest first
+const int progressive_steps[] = {16, 4, 1};
+
+
+class ProgressiveRenderer
+{
+public:
+
+    // colorPoints(x, y, count, bgr) colors  count  points, given in pixel
+    // coordinates, into 3 bytes (BGR) each.  It is called from the workers of
+    // the thread pool.
+    typedef std::function<void(const double *, const double *, int, unsigned char *)> ColorPoints;
+
+    ProgressiveRenderer(ThreadPool &pool, int width, int height);
+    ~ProgressiveRenderer();
+
+    ProgressiveRenderer(const ProgressiveRenderer &) = delete;
+    ProgressiveRenderer &operator=(const ProgressiveRenderer &) = delete;
+
+    int width() const {return width_;}
+    int height() const {return height_;}
+
+    // Start rendering a frame, cancelling the one in flight
+    void start(ColorPoints colorPoints);
+
+    // If a pass has finished since the last call, copy its frame into bgr
+    // (width x height x 3 bytes) and return its step, otherwise return 0.
+    // Rethrows the exception of colorPoints if it threw.
+    int takeFrame(unsigned char *bgr);
+
+    // Wait until the frame that was started last is complete
+    void wait();
+
+private:
+
+    void run();
+
+    // Render the points of the grid of  step  that aren't on the grid of
+    // previous_step (0 for the first pass); false if the frame was cancelled
+    bool renderPass(unsigned frame, const ColorPoints &colorPoints, int step, int previous_step);
+
+    ThreadPool &pool_;
+    const int width_, height_;
+
+    // Written by the passes, and copied to published_ after each one
+    std::vector<unsigned char> frame_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    ColorPoints request_;
+    unsigned requested_;
+    unsigned completed_;
+    std::vector<unsigned char> published_;
+    int published_step_;
+    std::exception_ptr exception_;
+    bool stopping_;
+
+    // The last frame started, which the tasks of older frames check
+    std::atomic<unsigned> latest_;
+
+    std::thread thread_;
+};
+
+
+// Reproject a frame for a new view, for feedback before the new view's first
+// pass: pixel (col, row) of bgr takes pixel (origin_x + col*scale, origin_y +
+// row*scale) of previous, or black if that is outside of it.  Both are
+// width x height x 3 bytes.
+void reprojectFrame(const unsigned char *previous, int width, int height, double origin_x, double origin_y,
+                    double scale, unsigned char *bgr);
+
+
+#endif  // PROGRESSIVE_RENDERER_H_
@@ -0,0 +1,235 @@
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#include "ImageWriter.h"
+#include "ThreadPool.h"
+
+
+RenderStats::RenderStats(int max_iterations)
+    : max_iterations_(max_iterations), histogram_bins_(histogramBin(std::max(max_iterations - 1, 0)) + 1),
+      start_(std::chrono::steady_clock::now())
+{
+}
+
+
+int RenderStats::histogramBin(int n)
+{
+    int bin = 0;
+    for(unsigned m = n + 1; m > 1; m >>= 1)
+        ++bin;
+    return bin;
+}
+
+
+double RenderStats::now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+
+void RenderStats::record(const Tile &tile, double start, const int *iterations, int calculated)
+{
+    TileStats stats;
+    stats.tile = tile;
+    stats.thread = ThreadPool::workerIndex();
+    stats.start = start;
+    stats.seconds = now() - start;
+    stats.cached = false;
+    stats.calculated = calculated;
+    stats.iterations = 0;
+    stats.escaped = 0;
+    stats.max_iteration = 0;
+    stats.histogram.assign(histogram_bins_, 0);
+
+    for(int i = 0; i < tile.width*tile.height; ++i)
+    {
+        const int n = iterations[i];
+        stats.iterations += n;
+        if(n >= max_iterations_)
+        {
+            ++stats.max_iteration;
+        }
+        else
+        {
+            ++stats.escaped;
+            ++stats.histogram[histogramBin(n)];
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    tiles_.push_back(std::move(stats));
+}
+
+
+void RenderStats::recordCached(const Tile &tile, double start)
+{
+    TileStats stats;
+    stats.tile = tile;
+    stats.thread = ThreadPool::workerIndex();
+    stats.start = start;
+    stats.seconds = now() - start;
+    stats.cached = true;
+    stats.calculated = 0;
+    stats.iterations = 0;
+    stats.escaped = 0;
+    stats.max_iteration = 0;
+    stats.histogram.assign(histogram_bins_, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    tiles_.push_back(std::move(stats));
+}
+
+
+std::vector<TileStats> RenderStats::tiles() const
+{
+    std::vector<TileStats> tiles;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tiles = tiles_;
+    }
+    std::stable_sort(tiles.begin(), tiles.end(), [](const TileStats &a, const TileStats &b)
+    {
+        return a.start < b.start;
+    });
+    return tiles;
+}
+
+
+static bool endsWith(const std::string &text, const std::string &suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+void RenderStats::write(const std::string &path) const
+{
+    if(endsWith(path, ".json"))
+        writeJson(path);
+    else if(endsWith(path, ".csv"))
+        writeCsv(path);
+    else
+        throw std::runtime_error("Can't write " + path + ": the statistics are written as .json or .csv");
+}
+
+
+void RenderStats::writeJson(const std::string &path) const
+{
+    std::ofstream file(path.c_str());
+    file.precision(9);
+
+    file << "{\n  \"max_iterations\": " << max_iterations_ << ",\n  \"histogram_bins\": [";
+    for(int k = 0; k < histogram_bins_; ++k)
+        file << (k > 0 ? ", " : "") << "[" << (1ll << k) - 1 << ", "
+             << std::min((2ll << k) - 1, static_cast<long long>(max_iterations_)) << "]";
+    file << "],\n  \"tiles\": [";
+
+    const std::vector<TileStats> tiles = this->tiles();
+    for(std::size_t t = 0; t < tiles.size(); ++t)
+    {
+        const TileStats &stats = tiles[t];
+        file << (t > 0 ? "," : "") << "\n    {\"x\": " << stats.tile.x << ", \"y\": " << stats.tile.y
+             << ", \"width\": " << stats.tile.width << ", \"height\": " << stats.tile.height
+             << ", \"thread\": " << stats.thread << ", \"start\": " << stats.start
+             << ", \"seconds\": " << stats.seconds << ", \"cached\": " << (stats.cached ? "true" : "false")
+             << ", \"calculated\": " << stats.calculated << ", \"iterations\": " << stats.iterations
+             << ", \"escaped\": " << stats.escaped << ", \"max_iteration\": " << stats.max_iteration
+             << ", \"histogram\": [";
+        for(int k = 0; k < histogram_bins_; ++k)
+            file << (k > 0 ? ", " : "") << stats.histogram[k];
+        file << "]}";
+    }
+    file << "\n  ]\n}\n";
+
+    if(!file)
+        throw std::runtime_error("Can't write " + path);
+}
+
+
+void RenderStats::writeCsv(const std::string &path) const
+{
+    std::ofstream file(path.c_str());
+    file.precision(9);
+
+    // The histogram columns are named after the lowest escape time of their bin
+    file << "x,y,width,height,thread,start,seconds,cached,calculated,iterations,escaped,max_iteration";
+    for(int k = 0; k < histogram_bins_; ++k)
+        file << ",n>=" << (1ll << k) - 1;
+    file << "\n";
+
+    for(const TileStats &stats : tiles())
+    {
+        file << stats.tile.x << "," << stats.tile.y << "," << stats.tile.width << "," << stats.tile.height << ","
+             << stats.thread << "," << stats.start << "," << stats.seconds << "," << stats.cached << ","
+             << stats.calculated << "," << stats.iterations << "," << stats.escaped << "," << stats.max_iteration;
+        for(int count : stats.histogram)
+            file << "," << count;
+        file << "\n";
+    }
+
+    if(!file)
+        throw std::runtime_error("Can't write " + path);
+}
+
+
+// Black -> red -> yellow -> white, for t from 0 to 1
+static void heatColor(double t, unsigned char *bgr)
+{
+    const double r = std::min(std::max(3*t, 0.0), 1.0);
+    const double g = std::min(std::max(3*t - 1, 0.0), 1.0);
+    const double b = std::min(std::max(3*t - 2, 0.0), 1.0);
+    bgr[0] = std::lround(255*b);
+    bgr[1] = std::lround(255*g);
+    bgr[2] = std::lround(255*r);
+}
+
+
+std::vector<unsigned char> RenderStats::heatmap(int &width, int &height, int max_size) const
+{
+    const std::vector<TileStats> tiles = this->tiles();
+
+    int image_width = 0, image_height = 0;
+    double max_density = 0;
+    for(const TileStats &stats : tiles)
+    {
+        image_width = std::max(image_width, stats.tile.x + stats.tile.width);
+        image_height = std::max(image_height, stats.tile.y + stats.tile.height);
+        max_density = std::max(max_density, stats.seconds / (stats.tile.width*stats.tile.height));
+    }
+
+    // Every pixel of the heatmap shows the image pixel at its top left corner
+    const int scale = std::max(1, (std::max(image_width, image_height) + max_size - 1) / max_size);
+    width = (image_width + scale - 1) / scale;
+    height = (image_height + scale - 1) / scale;
+
+    std::vector<unsigned char> bgr(3*width*height, 0);
+    for(const TileStats &stats : tiles)
+    {
+        const double density = stats.seconds / (stats.tile.width*stats.tile.height);
+        unsigned char color[3];
+        heatColor(max_density > 0 ? density / max_density : 0, color);
+
+        const Tile &tile = stats.tile;
+        for(int y = (tile.y + scale - 1) / scale; y < (tile.y + tile.height + scale - 1) / scale; ++y)
+            for(int x = (tile.x + scale - 1) / scale; x < (tile.x + tile.width + scale - 1) / scale; ++x)
+                std::copy(color, color + 3, &bgr[3*(y*width + x)]);
+    }
+    return bgr;
+}
+
+
+void RenderStats::writeHeatmap(const std::string &path, int max_size) const
+{
+    int width, height;
+    const std::vector<unsigned char> bgr = heatmap(width, height, max_size);
+    if(width == 0 || height == 0)
+        throw std::runtime_error("Can't write " + path + ": no tiles were recorded");
+
+    std::unique_ptr<ImageWriter> writer = openImageWriter(path, width, height);
+    writer->writeBand(bgr.data(), height);
+    writer->finish();
+}
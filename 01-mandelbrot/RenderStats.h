@@ -0,0 +1,102 @@
+#ifndef RENDER_STATS_H_
+#define RENDER_STATS_H_
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Tiles.h"
+
+// Per tile instrumentation of a render.
+//
+// For every tile, the renderer records when and on which worker it ran, its
+// wall time, the number of pixels it actually calculated, the sum of their
+// escape times, how many escaped and how many ran into max_iterations, and a
+// histogram of the escape times.  The statistics are written as JSON or CSV
+// (for tuning tile sizes, iteration budgets and scheduling), and as a heatmap
+// of the time spent per pixel.
+//
+// The histogram bins are powers of two: bin k counts the escaped pixels with
+// an escape time n in [2^k - 1, 2^(k+1) - 1).  Pixels that reached
+// max_iterations are only counted in max_iteration.  The JSON lists the bins
+// as [first, end) pairs; the CSV names their columns after the first.
+//
+// Recording is safe from several threads.  Errors while writing are reported
+// with std::runtime_error.
+
+struct TileStats
+{
+    Tile tile;
+
+    // The worker of the thread pool that rendered the tile (-1 if none)
+    int thread;
+
+    // When the tile was started, in seconds since the start of the render, and
+    // how long it took
+    double start;
+    double seconds;
+
+    // Whether it was loaded from the tile cache, in which case there are no
+    // escape times to count
+    bool cached;
+
+    // Pixels that were calculated; fewer than the tile has with Mariani-Silver
+    int calculated;
+
+    long long iterations;
+    int escaped;
+    int max_iteration;
+    std::vector<int> histogram;
+};
+
+
+class RenderStats
+{
+public:
+
+    explicit RenderStats(int max_iterations);
+
+    // The histogram bin of an escape time, and the number of bins
+    static int histogramBin(int n);
+    int histogramBins() const {return histogram_bins_;}
+
+    // Seconds since the start of the render
+    double now() const;
+
+    // Record a tile that was started at  start  (see now()) and calculated
+    // just now; iterations holds the escape times of its pixels, row by row
+    void record(const Tile &tile, double start, const int *iterations, int calculated);
+
+    // Record a tile that was loaded from the tile cache
+    void recordCached(const Tile &tile, double start);
+
+    // The tiles in the order they were started
+    std::vector<TileStats> tiles() const;
+
+    // Write the statistics as JSON (.json) or CSV (.csv)
+    void write(const std::string &path) const;
+    void writeJson(const std::string &path) const;
+    void writeCsv(const std::string &path) const;
+
+    // A heatmap of the time spent per pixel, over the area covered by the
+    // tiles, from black through red and yellow to white for the slowest tile.
+    // It is shrunk by a whole factor to at most max_size pixels across and
+    // down; width and height are set to its size.  The pixels are 3 bytes (BGR).
+    std::vector<unsigned char> heatmap(int &width, int &height, int max_size = 1024) const;
+
+    // Write the heatmap to a .png, .tif or .tiff file
+    void writeHeatmap(const std::string &path, int max_size = 1024) const;
+
+private:
+
+    const int max_iterations_;
+    const int histogram_bins_;
+    const std::chrono::steady_clock::time_point start_;
+
+    mutable std::mutex mutex_;
+    std::vector<TileStats> tiles_;
+};
+
+
+#endif  // RENDER_STATS_H_
@@ -0,0 +1,209 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A work-stealing thread pool.
+//
+// Every worker thread has its own deque of tasks.  A worker takes tasks from
+// the back of its own deque, and when that runs dry it steals tasks from the
+// front of the other workers' deques.  So workers that finish their cheap
+// tasks early keep busy by taking work from the ones that got expensive tasks.
+//
+// Tasks submitted from outside the pool are dealt out to the workers in turn.
+// Tasks submitted from inside a running task go onto that worker's own deque.
+
+class ThreadPool
+{
+public:
+
+    typedef std::function<void()> Task;
+
+    // Start the pool with num_threads workers (0 means one per hardware thread)
+    explicit ThreadPool(unsigned num_threads = 0)
+    {
+        if(num_threads == 0)
+            num_threads = std::thread::hardware_concurrency();
+        if(num_threads == 0)
+            num_threads = 1;
+
+        for(unsigned i = 0; i < num_threads; ++i)
+            workers_.emplace_back(new Worker);
+        for(unsigned i = 0; i < num_threads; ++i)
+            threads_.emplace_back(&ThreadPool::run, this, i);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for(std::thread &thread : threads_)
+            thread.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(Task task)
+    {
+        const Current &current = currentWorker();
+        unsigned index = current.pool == this ? current.index : next_++ % workers_.size();
+
+        ++pending_;
+        ++queued_;
+        {
+            Worker &worker = *workers_[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+
+        // Taking the lock here makes sure that a worker can't miss the wake up
+        // between checking queued_ and going to sleep
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        wake_.notify_one();
+    }
+
+    // Wait until every submitted task has finished.
+    // If any task threw an exception, the first one is rethrown here.
+    // Must not be called from inside a task.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]{ return pending_ == 0; });
+
+        if(exception_)
+        {
+            std::exception_ptr exception = exception_;
+            exception_ = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+
+    unsigned size() const {return workers_.size();}
+
+    // The index of the worker running the current task, or -1 outside of any pool
+    static int workerIndex()
+    {
+        const Current &current = currentWorker();
+        return current.pool != nullptr ? static_cast<int>(current.index) : -1;
+    }
+
+private:
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // The pool and worker index that the current thread belongs to, if any
+    struct Current
+    {
+        const ThreadPool *pool;
+        unsigned index;
+    };
+
+    static Current &currentWorker()
+    {
+        static thread_local Current current = {nullptr, 0};
+        return current;
+    }
+
+    bool popTask(unsigned index, Task &task)
+    {
+        // Take from the back of our own deque first...
+        {
+            Worker &worker = *workers_[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if(!worker.tasks.empty())
+            {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // ...then steal from the front of the others
+        for(std::size_t i = 1; i < workers_.size(); ++i)
+        {
+            Worker &victim = *workers_[(index + i) % workers_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void run(unsigned index)
+    {
+        currentWorker().pool = this;
+        currentWorker().index = index;
+
+        Task task;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this]{ return queued_ > 0 || stopping_; });
+                if(queued_ == 0 && stopping_)
+                    return;
+            }
+
+            if(!popTask(index, task))
+                continue;
+            --queued_;
+
+            try
+            {
+                task();
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(!exception_)
+                    exception_ = std::current_exception();
+            }
+            task = nullptr;
+
+            if(--pending_ == 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker> > workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::exception_ptr exception_;
+    bool stopping_ = false;
+
+    std::atomic<std::size_t> pending_ {0};  // tasks submitted but not yet finished
+    std::atomic<std::size_t> queued_ {0};   // tasks sitting in a deque
+    std::atomic<unsigned> next_ {0};
+};
+
+
+#endif  // THREAD_POOL_H_
@@ -0,0 +1,222 @@
+#include "TileCache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+// A tile file is the header, the key, and the smooth iteration counts row by row
+static const char magic[8] = {'M', 'B', 'T', 'I', 'L', 'E', '0', '1'};
+static const char *const suffix = ".tile";
+
+struct TileHeader
+{
+    char magic[8];
+    std::uint32_t key_length;
+    std::int32_t width;
+    std::int32_t height;
+    std::uint32_t reserved;
+};
+
+
+// FNV-1a
+static std::string hashName(const std::string &key)
+{
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    for(unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 0x100000001B3ull;
+    }
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+
+static std::int64_t modificationTime(const struct stat &info)
+{
+    return static_cast<std::int64_t>(info.st_mtim.tv_sec)*1000000000 + info.st_mtim.tv_nsec;
+}
+
+
+TileCache::TileCache(const std::string &directory, std::uint64_t max_bytes)
+    : directory_(directory), max_bytes_(max_bytes), size_(0), clock_(0), hits_(0), misses_(0)
+{
+    if(mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST)
+        throw std::runtime_error("Can't create directory " + directory);
+
+    // Pick up the files of earlier runs, in the order they were last used
+    DIR *dir = opendir(directory.c_str());
+    if(dir == nullptr)
+        throw std::runtime_error("Can't read directory " + directory);
+    while(dirent *file = readdir(dir))
+    {
+        const std::string name = file->d_name;
+        if(name.size() <= std::strlen(suffix) || name.compare(name.size() - std::strlen(suffix), std::string::npos, suffix) != 0)
+            continue;
+
+        struct stat info;
+        if(stat(path(name).c_str(), &info) == 0)
+        {
+            Entry entry = {static_cast<std::uint64_t>(info.st_size), modificationTime(info)};
+            entries_[name] = entry;
+            size_ += entry.bytes;
+            clock_ = std::max(clock_, entry.last_use);
+        }
+    }
+    closedir(dir);
+
+    evict();
+}
+
+
+std::string TileCache::path(const std::string &name) const
+{
+    return directory_ + "/" + name;
+}
+
+
+bool TileCache::load(const std::string &key, int width, int height, float *smooth, int stride)
+{
+    const std::string name = hashName(key) + suffix;
+    const std::string file_path = path(name);
+
+    bool hit = false;
+    const int fd = open(file_path.c_str(), O_RDONLY);
+    if(fd >= 0)
+    {
+        struct stat info;
+        const std::size_t expected = sizeof(TileHeader) + key.size() + sizeof(float)*width*height;
+        if(fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) == expected)
+        {
+            void *mapping = mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapping != MAP_FAILED)
+            {
+                const char *data = static_cast<const char *>(mapping);
+                TileHeader header;
+                std::memcpy(&header, data, sizeof(header));
+                if(std::memcmp(header.magic, magic, sizeof(magic)) == 0 && header.key_length == key.size() &&
+                   header.width == width && header.height == height &&
+                   std::memcmp(data + sizeof(header), key.data(), key.size()) == 0)
+                {
+                    const char *values = data + sizeof(header) + key.size();
+                    for(int row = 0; row < height; ++row)
+                        std::memcpy(smooth + static_cast<std::size_t>(row)*stride,
+                                    values + sizeof(float)*row*width, sizeof(float)*width);
+                    hit = true;
+                }
+                munmap(mapping, expected);
+            }
+        }
+        close(fd);
+    }
+
+    if(!hit)
+    {
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+
+    // Mark it as just used, here and for later runs
+    utimes(file_path.c_str(), nullptr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = entries_.find(name);
+    if(entry != entries_.end())
+        entry->second.last_use = ++clock_;
+    return true;
+}
+
+
+void TileCache::store(const std::string &key, int width, int height, const float *smooth, int stride)
+{
+    const std::string name = hashName(key) + suffix;
+
+    TileHeader header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.key_length = key.size();
+    header.width = width;
+    header.height = height;
+    header.reserved = 0;
+
+    std::vector<char> data(sizeof(header) + key.size() + sizeof(float)*width*height);
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::memcpy(data.data() + sizeof(header), key.data(), key.size());
+    char *values = data.data() + sizeof(header) + key.size();
+    for(int row = 0; row < height; ++row)
+        std::memcpy(values + sizeof(float)*row*width, smooth + static_cast<std::size_t>(row)*stride,
+                    sizeof(float)*width);
+
+    // Write to a file of this thread's own, then move it into place, so that
+    // a reader never sees a partly written tile
+    const std::hash<std::thread::id> hash_thread;
+    const std::string temporary = path(name + "." + std::to_string(getpid()) + "." +
+                                       std::to_string(hash_thread(std::this_thread::get_id())) + ".tmp");
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    if(file == nullptr)
+        throw std::runtime_error("Can't write " + temporary);
+    const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    if(std::fclose(file) != 0 || !written || std::rename(temporary.c_str(), path(name).c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Can't write " + path(name));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry &entry = entries_[name];
+    size_ -= entry.bytes;
+    entry.bytes = data.size();
+    entry.last_use = ++clock_;
+    size_ += entry.bytes;
+    evict();
+}
+
+
+std::uint64_t TileCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+
+// Delete the least recently used files until the cache fits in max_bytes.
+// The mutex must be held (or the cache not yet shared).
+void TileCache::evict()
+{
+    if(size_ <= max_bytes_)
+        return;
+
+    std::vector<std::pair<std::int64_t, std::string>> by_use;
+    for(const auto &entry : entries_)
+        by_use.push_back(std::make_pair(entry.second.last_use, entry.first));
+    std::sort(by_use.begin(), by_use.end());
+
+    for(const auto &file : by_use)
+    {
+        if(size_ <= max_bytes_)
+            break;
+        std::remove(path(file.second).c_str());
+        size_ -= entries_[file.second].bytes;
+        entries_.erase(file.second);
+    }
+}
+
+
+std::string tileKey(const std::string &view, const Tile &tile, int max_iterations, const std::string &precision)
+{
+    return view + "|tile " + std::to_string(tile.x) + " " + std::to_string(tile.y) + " " +
+           std::to_string(tile.width) + " " + std::to_string(tile.height) + "|max_iterations " +
+           std::to_string(max_iterations) + "|" + precision;
+}
@@ -0,0 +1,80 @@
+#ifndef TILE_CACHE_H_
+#define TILE_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Tiles.h"
+
+// A persistent cache of rendered tiles on disk.
+//
+// Each tile's smooth iteration counts are stored in a file of their own in
+// the cache directory, named after a hash of the tile's key: the view, the
+// position and size of the tile, the iteration budget and the precision (see
+// tileKey).  The key is stored in the file as well, so a hash collision is
+// just a miss.  Files are read through a memory mapping, and written to a
+// temporary file that is renamed into place, so several renders can share a
+// cache directory.
+//
+// When the files add up to more than max_bytes, the least recently used ones
+// are deleted.  A hit touches the file's modification time, which is what
+// the least recently used order is taken from, so it carries over between runs.
+//
+// The cache is safe to use from several threads.  Errors while writing are
+// reported with std::runtime_error; unreadable files are misses.
+
+class TileCache
+{
+public:
+
+    TileCache(const std::string &directory, std::uint64_t max_bytes);
+
+    // Load the tile with the given key into rows of  stride  floats.
+    // Returns false if it isn't in the cache.
+    bool load(const std::string &key, int width, int height, float *smooth, int stride);
+
+    // Store a tile, given in rows of  stride  floats
+    void store(const std::string &key, int width, int height, const float *smooth, int stride);
+
+    // The total size of the cached files in bytes
+    std::uint64_t size() const;
+
+    long hits() const {return hits_;}
+    long misses() const {return misses_;}
+
+private:
+
+    struct Entry
+    {
+        std::uint64_t bytes;
+        std::int64_t last_use;
+    };
+
+    std::string path(const std::string &name) const;
+    void evict();
+
+    const std::string directory_;
+    const std::uint64_t max_bytes_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    std::uint64_t size_;
+    std::int64_t clock_;
+
+    std::atomic<long> hits_;
+    std::atomic<long> misses_;
+};
+
+
+// The key of a tile.  view describes the view exactly (its center and scale,
+// as they were given, and the image size), precision the number type and
+// algorithm, so that anything that changes the result of a tile changes its
+// key.  The tile's position is relative to the image, so tiles are only
+// shared between renders of the same view, not between overlapping ones.
+std::string tileKey(const std::string &view, const Tile &tile, int max_iterations, const std::string &precision);
+
+
+#endif  // TILE_CACHE_H_
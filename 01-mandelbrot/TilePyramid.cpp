@@ -0,0 +1,231 @@
+#include "TilePyramid.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "ImageWriter.h"
+
+
+static void makeDirectory(const std::string &path)
+{
+    if(mkdir(path.c_str(), 0777) != 0 && errno != EEXIST)
+        throw std::runtime_error("Can't create directory " + path);
+}
+
+
+TilePyramid::TilePyramid(const std::string &name, int width, int height, int tile_size, PyramidLayout layout)
+    : name_(name), width_(width), height_(height), tile_size_(tile_size), layout_(layout),
+      levels_(1), top_level_(0), split_level_(0)
+{
+    if(width <= 0 || height <= 0 || tile_size <= 0 || tile_size % 2 != 0)
+        throw std::invalid_argument("Bad size for a tile pyramid");
+
+    // Level 0 is 1x1, so there are  ceil(log2(max(width, height))) + 1  levels
+    while((1 << (levels_ - 1)) < std::max(width, height))
+        ++levels_;
+
+    // XYZ starts at the deepest level that fits in one tile
+    if(layout_ == PyramidLayout::xyz)
+    {
+        top_level_ = levels_ - 1;
+        while(top_level_ > 0 && std::max(levelWidth(top_level_), levelHeight(top_level_)) > tile_size_)
+            --top_level_;
+    }
+}
+
+
+int TilePyramid::levelWidth(int level) const
+{
+    const int shift = levels_ - 1 - level;
+    return (width_ + (1 << shift) - 1) >> shift;
+}
+
+
+int TilePyramid::levelHeight(int level) const
+{
+    const int shift = levels_ - 1 - level;
+    return (height_ + (1 << shift) - 1) >> shift;
+}
+
+
+int TilePyramid::tileColumns(int level) const
+{
+    return (levelWidth(level) + tile_size_ - 1) / tile_size_;
+}
+
+
+int TilePyramid::tileRows(int level) const
+{
+    return (levelHeight(level) + tile_size_ - 1) / tile_size_;
+}
+
+
+std::string TilePyramid::tilePath(int level, int col, int row) const
+{
+    if(layout_ == PyramidLayout::dzi)
+        return name_ + "_files/" + std::to_string(level) + "/" + std::to_string(col) + "_" + std::to_string(row) + ".png";
+    return name_ + "/" + std::to_string(level - top_level_) + "/" + std::to_string(col) + "/" + std::to_string(row) + ".png";
+}
+
+
+void TilePyramid::makeDirectories() const
+{
+    if(layout_ == PyramidLayout::dzi)
+    {
+        makeDirectory(name_ + "_files");
+        for(int level = top_level_; level < levels_; ++level)
+            makeDirectory(name_ + "_files/" + std::to_string(level));
+    }
+    else
+    {
+        makeDirectory(name_);
+        for(int level = top_level_; level < levels_; ++level)
+        {
+            const std::string z = name_ + "/" + std::to_string(level - top_level_);
+            makeDirectory(z);
+            for(int col = 0; col < tileColumns(level); ++col)
+                makeDirectory(z + "/" + std::to_string(col));
+        }
+    }
+}
+
+
+int TilePyramid::build(ThreadPool &pool, const RenderTile &renderTile)
+{
+    makeDirectories();
+
+    // Split the tree into subtrees at the first level with a few tiles for
+    // every thread, and build those in parallel
+    split_level_ = top_level_;
+    while(split_level_ < levels_ - 1 && tileColumns(split_level_)*tileRows(split_level_) < 4*int(pool.size()))
+        ++split_level_;
+
+    const int columns = tileColumns(split_level_);
+    const int rows = tileRows(split_level_);
+    std::vector<std::vector<unsigned char>> roots(columns*rows);
+    for(int row = 0; row < rows; ++row)
+    {
+        for(int col = 0; col < columns; ++col)
+        {
+            std::vector<unsigned char> &root = roots[row*columns + col];
+            const int level = split_level_;
+            pool.submit([this, level, col, row, &root, &renderTile]
+            {
+                root = buildTile(level, col, row, renderTile);
+            });
+        }
+    }
+    pool.wait();
+
+    // Then the levels above, from the roots of the subtrees
+    split_tiles_.swap(roots);
+    for(int row = 0; row < tileRows(top_level_); ++row)
+        for(int col = 0; col < tileColumns(top_level_); ++col)
+            buildTile(top_level_, col, row, renderTile);
+    split_tiles_.clear();
+
+    if(layout_ == PyramidLayout::dzi)
+    {
+        std::ofstream descriptor((name_ + ".dzi").c_str());
+        descriptor << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                   << "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"" << tile_size_
+                   << "\" Overlap=\"0\" Format=\"png\">\n"
+                   << "  <Size Width=\"" << width_ << "\" Height=\"" << height_ << "\"/>\n"
+                   << "</Image>\n";
+        if(!descriptor)
+            throw std::runtime_error("Can't write " + name_ + ".dzi");
+    }
+
+    int total = 0;
+    for(int level = top_level_; level < levels_; ++level)
+        total += tileColumns(level)*tileRows(level);
+    return total;
+}
+
+
+// Build the tile and all the tiles below it, write them, and return the tile
+std::vector<unsigned char> TilePyramid::buildTile(int level, int col, int row, const RenderTile &renderTile)
+{
+    if(level == split_level_ && !split_tiles_.empty())
+        return std::move(split_tiles_[row*tileColumns(level) + col]);
+
+    const Tile tile = {col*tile_size_, row*tile_size_,
+                       std::min(tile_size_, levelWidth(level) - col*tile_size_),
+                       std::min(tile_size_, levelHeight(level) - row*tile_size_)};
+    std::vector<unsigned char> bgr(3*tile.width*tile.height);
+
+    if(level == levels_ - 1)
+    {
+        renderTile(tile, bgr.data());
+    }
+    else
+    {
+        // Shrink the children into the four quarters of the tile.  At the
+        // right and bottom edges of the level, a pixel may cover fewer than
+        // 2x2 pixels of the level below.
+        std::vector<int> sum(3*tile.width*tile.height, 0), count(tile.width*tile.height, 0);
+        const int child_width = levelWidth(level + 1);
+        const int child_height = levelHeight(level + 1);
+        for(int j = 0; j < 2; ++j)
+        {
+            for(int i = 0; i < 2; ++i)
+            {
+                const int child_col = 2*col + i;
+                const int child_row = 2*row + j;
+                if(child_col*tile_size_ >= child_width || child_row*tile_size_ >= child_height)
+                    continue;
+
+                const std::vector<unsigned char> child = buildTile(level + 1, child_col, child_row, renderTile);
+                const int w = std::min(tile_size_, child_width - child_col*tile_size_);
+                const int h = std::min(tile_size_, child_height - child_row*tile_size_);
+                for(int y = 0; y < h; ++y)
+                {
+                    const int out_y = (j*tile_size_ + y)/2;
+                    for(int x = 0; x < w; ++x)
+                    {
+                        const int out = out_y*tile.width + (i*tile_size_ + x)/2;
+                        const unsigned char *in = &child[3*(y*w + x)];
+                        sum[3*out] += in[0];
+                        sum[3*out + 1] += in[1];
+                        sum[3*out + 2] += in[2];
+                        ++count[out];
+                    }
+                }
+            }
+        }
+
+        for(int k = 0; k < tile.width*tile.height; ++k)
+            for(int c = 0; c < 3; ++c)
+                bgr[3*k + c] = (sum[3*k + c] + count[k]/2) / count[k];
+    }
+
+    if(level >= top_level_)
+        writeTile(level, col, row, bgr);
+    return bgr;
+}
+
+
+void TilePyramid::writeTile(int level, int col, int row, const std::vector<unsigned char> &bgr)
+{
+    const int width = std::min(tile_size_, levelWidth(level) - col*tile_size_);
+    const int height = std::min(tile_size_, levelHeight(level) - row*tile_size_);
+
+    if(layout_ == PyramidLayout::dzi || (width == tile_size_ && height == tile_size_))
+    {
+        PngWriter writer(tilePath(level, col, row), width, height);
+        writer.writeBand(bgr.data(), height);
+        writer.finish();
+        return;
+    }
+
+    // XYZ tiles are always full size
+    std::vector<unsigned char> padded(3*tile_size_*tile_size_, 0);
+    for(int y = 0; y < height; ++y)
+        std::copy(&bgr[3*y*width], &bgr[3*(y + 1)*width], &padded[3*y*tile_size_]);
+    PngWriter writer(tilePath(level, col, row), tile_size_, tile_size_);
+    writer.writeBand(padded.data(), tile_size_);
+    writer.finish();
+}
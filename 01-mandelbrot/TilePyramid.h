@@ -0,0 +1,89 @@
+#ifndef TILE_PYRAMID_H_
+#define TILE_PYRAMID_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "Tiles.h"
+
+// Tile pyramids for pan and zoom viewers.
+//
+// Level 0 of a pyramid is the image shrunk to a single pixel, and every
+// further level doubles the size, up to the full image at the deepest level.
+// Each level is cut into tile_size x tile_size PNG tiles.
+//
+// Only the tiles of the deepest level are rendered; every other tile is
+// shrunk from its (up to) four children, by averaging 2x2 pixels.  The tree is
+// built depth first, one subtree per task on the thread pool, and each tile
+// is written as soon as it is done, so only the tiles of the current path
+// down the tree (plus the roots of the subtrees) are ever in memory.
+//
+// Two layouts are written:
+//   dzi   Deep Zoom: name.dzi, and the tiles in name_files/level/col_row.png
+//   xyz   name/z/x/y.png, where z = 0 is the first level that fits in one
+//         tile.  Tiles on the right and bottom edges are padded to full size
+//         with black.
+//
+// Errors are reported with std::runtime_error.
+
+enum class PyramidLayout
+{
+    dzi,
+    xyz
+};
+
+
+class TilePyramid
+{
+public:
+
+    // renderTile(tile, bgr) renders a tile of the full size image into bgr,
+    // tile.width*3 bytes per row.  It is called on the thread pool.
+    typedef std::function<void(const Tile &, unsigned char *)> RenderTile;
+
+    // tile_size must be even
+    TilePyramid(const std::string &name, int width, int height, int tile_size = 256,
+                PyramidLayout layout = PyramidLayout::dzi);
+
+    // The number of levels; the deepest one is levels() - 1
+    int levels() const {return levels_;}
+
+    // The size of a level in pixels, and its number of tiles across and down
+    int levelWidth(int level) const;
+    int levelHeight(int level) const;
+    int tileColumns(int level) const;
+    int tileRows(int level) const;
+
+    // The file of a tile
+    std::string tilePath(int level, int col, int row) const;
+
+    // Render the whole pyramid, and write all its files.  Returns the number
+    // of tiles written.
+    int build(ThreadPool &pool, const RenderTile &renderTile);
+
+private:
+
+    std::vector<unsigned char> buildTile(int level, int col, int row, const RenderTile &renderTile);
+    void writeTile(int level, int col, int row, const std::vector<unsigned char> &bgr);
+    void makeDirectories() const;
+
+    const std::string name_;
+    const int width_;
+    const int height_;
+    const int tile_size_;
+    const PyramidLayout layout_;
+    int levels_;
+
+    // The highest level that is written
+    int top_level_;
+
+    // The level whose tiles are the roots of the subtrees built in parallel,
+    // and those tiles, once built
+    int split_level_;
+    std::vector<std::vector<unsigned char>> split_tiles_;
+};
+
+
+#endif  // TILE_PYRAMID_H_
@@ -0,0 +1,60 @@
+#ifndef TILES_H_
+#define TILES_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// A rectangular block of pixels of the output image
+struct Tile
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+
+// Split a rectangular area of an image into tiles of (at most) tile_size x
+// tile_size pixels, in row major order.  Tiles along the right and bottom
+// edges may be smaller.
+inline std::vector<Tile> makeTiles(const Tile &area, int tile_size)
+{
+    std::vector<Tile> tiles;
+    for(int y = area.y; y < area.y + area.height; y += tile_size)
+    {
+        for(int x = area.x; x < area.x + area.width; x += tile_size)
+        {
+            Tile tile;
+            tile.x = x;
+            tile.y = y;
+            tile.width = std::min(tile_size, area.x + area.width - x);
+            tile.height = std::min(tile_size, area.y + area.height - y);
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
+
+
+// Split a whole image into tiles
+inline std::vector<Tile> makeTiles(int image_width, int image_height, int tile_size)
+{
+    Tile image = {0, 0, image_width, image_height};
+    return makeTiles(image, tile_size);
+}
+
+
+// Call renderTile(tile) for every tile on the thread pool, and wait for them all to finish.
+// Tiles are rendered concurrently, so renderTile must only touch the pixels of its own tile.
+template <typename F>
+void renderTiles(ThreadPool &pool, const std::vector<Tile> &tiles, const F &renderTile)
+{
+    for(const Tile &tile : tiles)
+        pool.submit([&renderTile, tile]{ renderTile(tile); });
+    pool.wait();
+}
+
+
+#endif  // TILES_H_
@@ -0,0 +1,190 @@
+#ifndef ZOOM_SEQUENCE_H_
+#define ZOOM_SEQUENCE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "Palette.h"
+#include "ThreadPool.h"
+#include "Tiles.h"
+
+// Rendering of zoom animations, reusing the samples of the previous frame.
+//
+// Consecutive frames of a zoom overlap almost entirely, so most pixels of a
+// new frame have a sample of the previous frame close to them.  Each frame
+// is reprojected from the previous one: every pixel takes over the nearest
+// sample of the previous frame if it is within  tolerance  pixels (of the new
+// frame, in either direction), and only the pixels without such a sample are
+// calculated.
+//
+// A reused sample keeps its own exact position, and the offset from the pixel
+// it ends up in is stored along with it, so the error doesn't pile up from
+// frame to frame: every pixel shows a sample from within  tolerance  of its
+// own position.  A tolerance of 0.5 makes fast preview frames; a small
+// tolerance (or 0, which calculates everything) makes final quality frames.
+// Final quality frames should be rendered by a sequence of their own, so
+// they never pick up samples of a preview frame.
+//
+// The views are in double precision, so this is for zooms down to about 1e-12.
+
+
+// A view of the complex plane.  Pixel (col, row) of a width x height frame is
+// the point  (center_x + (col - width/2)*spacing, center_y + (height/2 - row)*spacing)
+struct ZoomView
+{
+    double center_x;
+    double center_y;
+    double spacing;
+};
+
+
+// The distance of a pixel that has no sample to reuse
+const float no_sample = 1;
+
+
+class ZoomSequence
+{
+public:
+
+    // tolerance is in pixels, at most 0.5
+    ZoomSequence(int width, int height, double tolerance)
+        : width_(width), height_(height), tolerance_(std::min(tolerance, 0.5)), has_previous_(false),
+          smooth_(width*height), offset_x_(width*height), offset_y_(width*height)
+    {
+    }
+
+    // Render the next frame.  calculate(cx, cy, count, max_iterations, iterations, norm)
+    // is an escape time kernel.  Returns the number of pixels that were calculated.
+    template <typename Calculate>
+    int renderFrame(const ZoomView &view, ThreadPool &pool, int tile_size, int max_iterations,
+                    const Calculate &calculate)
+    {
+        previous_smooth_.swap(smooth_);
+        previous_offset_x_.swap(offset_x_);
+        previous_offset_y_.swap(offset_y_);
+        smooth_.resize(width_*height_);
+        offset_x_.resize(width_*height_);
+        offset_y_.resize(width_*height_);
+
+        distance_.assign(width_*height_, no_sample);
+        if(has_previous_ && tolerance_ > 0)
+            reproject(view);
+
+        std::atomic<int> calculated(0);
+        renderTiles(pool, makeTiles(width_, height_, tile_size), [&](const Tile &tile)
+        {
+            calculated += renderTile(tile, view, max_iterations, calculate);
+        });
+
+        previous_view_ = view;
+        has_previous_ = true;
+        return calculated;
+    }
+
+    // The smooth iteration counts of the last frame, row by row
+    const std::vector<float> &smooth() const {return smooth_;}
+
+    // Where the samples of the last frame are, relative to their pixels: pixel
+    // (col, row) shows the point at (col + offsetX()[k], row + offsetY()[k]),
+    // with k = row*width + col.
+    const std::vector<double> &offsetX() const {return offset_x_;}
+    const std::vector<double> &offsetY() const {return offset_y_;}
+
+private:
+
+    // Move every sample of the previous frame into the pixel of the new frame
+    // that it falls in, if it is within the tolerance of its position.  With a
+    // tolerance of at most half a pixel that's the only pixel it could serve;
+    // if several samples fall in one pixel, the nearest one wins.
+    void reproject(const ZoomView &view)
+    {
+        // A point at (x, y) in pixels of the previous frame is at
+        // ((x - origin_x)/scale, (y - origin_y)/scale) in pixels of the new one
+        const ZoomView &old = previous_view_;
+        const double scale = view.spacing / old.spacing;
+        const double origin_x = (view.center_x - old.center_x)/old.spacing + width_/2.0*(1 - scale);
+        const double origin_y = (old.center_y - view.center_y)/old.spacing + height_/2.0*(1 - scale);
+
+        for(int j = 0; j < height_; ++j)
+        {
+            for(int i = 0; i < width_; ++i)
+            {
+                const int k = j*width_ + i;
+                const double x = (i + previous_offset_x_[k] - origin_x) / scale;
+                const double y = (j + previous_offset_y_[k] - origin_y) / scale;
+                const double col = std::floor(x + 0.5);
+                const double row = std::floor(y + 0.5);
+                if(col < 0 || col >= width_ || row < 0 || row >= height_)
+                    continue;
+
+                const double dx = x - col;
+                const double dy = y - row;
+                const float distance = std::max(std::fabs(dx), std::fabs(dy));
+                const int pixel = row*width_ + col;
+                if(distance <= tolerance_ && distance < distance_[pixel])
+                {
+                    distance_[pixel] = distance;
+                    smooth_[pixel] = previous_smooth_[k];
+                    offset_x_[pixel] = dx;
+                    offset_y_[pixel] = dy;
+                }
+            }
+        }
+    }
+
+    template <typename Calculate>
+    int renderTile(const Tile &tile, const ZoomView &view, int max_iterations, const Calculate &calculate)
+    {
+        // The pixels that have no sample to reuse
+        std::vector<int> pending;
+        std::vector<double> cx, cy;
+
+        for(int row = tile.y; row < tile.y + tile.height; ++row)
+        {
+            for(int col = tile.x; col < tile.x + tile.width; ++col)
+            {
+                if(distance_[row*width_ + col] == no_sample)
+                {
+                    pending.push_back(row*width_ + col);
+                    cx.push_back(view.center_x + (col - width_/2.0)*view.spacing);
+                    cy.push_back(view.center_y + (height_/2.0 - row)*view.spacing);
+                }
+            }
+        }
+
+        const int count = pending.size();
+        std::vector<int> iterations(count);
+        std::vector<double> norm(count);
+        if(count > 0)
+            calculate(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+        for(int i = 0; i < count; ++i)
+        {
+            const int k = pending[i];
+            smooth_[k] = smoothIterations(iterations[i], norm[i], max_iterations);
+            offset_x_[k] = 0;
+            offset_y_[k] = 0;
+        }
+        return count;
+    }
+
+    const int width_;
+    const int height_;
+    const double tolerance_;
+    bool has_previous_;
+    ZoomView previous_view_;
+
+    // The smooth iteration counts of the frames, and the offsets of their
+    // samples from the pixel positions, in pixels
+    std::vector<float> smooth_, previous_smooth_;
+    std::vector<double> offset_x_, previous_offset_x_;
+    std::vector<double> offset_y_, previous_offset_y_;
+
+    // How far the sample of each pixel of the new frame is from it, or no_sample
+    std::vector<float> distance_;
+};
+
+
+#endif  // ZOOM_SEQUENCE_H_
@@ -0,0 +1,365 @@
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "BigFixed.h"
+#include "EscapeTime.h"
+#include "ImageWriter.h"
+#include "MultiDouble.h"
+#include "Palette.h"
+#include "Perturbation.h"
+#include "ProgressiveRenderer.h"
+
+// Benchmarks of the hot path of the renderer: the escape time kernels, the
+// colorization pass and the image encoders, over a few canonical views, and
+// the latency of the interactive explorer.
+//
+// Every benchmark reports pixels/s.  The kernels also report iterations/s,
+// counted as the sum of the escape times, so points that are cut short by the
+// cardioid test or the cycle detection count for the full max_iterations;
+// that is the rate a renderer sees, and it doesn't change when the kernel
+// gets faster for a reason other than iterating faster.
+//
+//   bench_mandelbrot --benchmark_filter=kernel/avx2
+
+
+// The images are small enough for every benchmark to finish in about a second.
+// The wider number types are so much slower that they get a quarter of the
+// width and height.
+const int image_width = 320;
+const int image_height = 240;
+const int wide_reduction = 4;
+
+
+// A view: its center and width, as decimal numbers, so that the deep zoom can
+// be parsed with arbitrary precision
+struct View
+{
+    const char *name;
+    const char *center_x;
+    const char *center_y;
+    const char *width;
+    int max_iterations;
+};
+
+const View shallow_views[] = {
+    // The default view of the program
+    {"full_set", "-0.65", "0", "2.5", 1000},
+    // Long escape times next to the edge of the set
+    {"seahorse_valley", "-0.7453", "0.1127", "0.0065", 1000},
+    // Mostly inside the period-3 bulb, which neither the cardioid test nor the
+    // period-2 bulb test catches, so it is down to the cycle detection
+    {"interior", "-0.1225", "0.7449", "0.15", 1000},
+};
+
+const View deep_view = {"deep_zoom", "-0.743643887037158704752191506114774",
+                        "0.131825904205311970493132056385139", "1e-30", 5000};
+
+
+// The points of the pixels of a view, rendered at width x height
+template <typename Real>
+static void makePoints(const View &view, int width, int height, std::vector<Real> &cx, std::vector<Real> &cy)
+{
+    const Real center_x = RealTraits<Real>::fromString(view.center_x);
+    const Real center_y = RealTraits<Real>::fromString(view.center_y);
+    const Real spacing = RealTraits<Real>::fromString(view.width) / width;
+
+    cx.clear();
+    cy.clear();
+    for(int row = 0; row < height; ++row)
+    {
+        for(int col = 0; col < width; ++col)
+        {
+            cx.push_back(center_x + spacing*(col - width/2));
+            cy.push_back(center_y + spacing*(height/2 - row));
+        }
+    }
+}
+
+
+static void setCounters(benchmark::State &state, const std::vector<int> &iterations)
+{
+    long long total = 0;
+    for(int n : iterations)
+        total += n;
+
+    state.counters["pixels/s"] = benchmark::Counter(static_cast<double>(state.iterations())*iterations.size(),
+                                                    benchmark::Counter::kIsRate);
+    state.counters["iterations/s"] = benchmark::Counter(static_cast<double>(state.iterations())*total,
+                                                        benchmark::Counter::kIsRate);
+}
+
+
+// One of the double precision kernels
+static void kernelBenchmark(benchmark::State &state, EscapeKernel kernel, bool supported, View view)
+{
+    if(!supported)
+    {
+        state.SkipWithError("not supported by this CPU");
+        return;
+    }
+
+    std::vector<double> cx, cy;
+    makePoints(view, image_width, image_height, cx, cy);
+    std::vector<int> iterations(cx.size());
+    std::vector<double> norm(cx.size());
+
+    for(auto _ : state)
+    {
+        kernel(cx.data(), cy.data(), cx.size(), view.max_iterations, iterations.data(), norm.data());
+        benchmark::DoNotOptimize(iterations.data());
+        benchmark::ClobberMemory();
+    }
+    setCounters(state, iterations);
+}
+
+
+// The generic escape time loop with one of the wider number types
+template <typename Real>
+static void wideKernelBenchmark(benchmark::State &state, View view)
+{
+    std::vector<Real> cx, cy;
+    makePoints(view, image_width/wide_reduction, image_height/wide_reduction, cx, cy);
+    std::vector<int> iterations(cx.size());
+    std::vector<double> norm(cx.size());
+
+    for(auto _ : state)
+    {
+        escapeTime(cx.data(), cy.data(), cx.size(), view.max_iterations, iterations.data(), norm.data());
+        benchmark::DoNotOptimize(iterations.data());
+        benchmark::ClobberMemory();
+    }
+    setCounters(state, iterations);
+}
+
+
+// The escape time loop of another fractal family, in double precision
+template <typename Fractal>
+static void fractalBenchmark(benchmark::State &state, Fractal fractal, View view)
+{
+    std::vector<double> cx, cy;
+    makePoints(view, image_width, image_height, cx, cy);
+    std::vector<int> iterations(cx.size());
+    std::vector<double> norm(cx.size());
+
+    for(auto _ : state)
+    {
+        escapeTime(fractal, cx.data(), cy.data(), cx.size(), view.max_iterations, iterations.data(), norm.data());
+        benchmark::DoNotOptimize(iterations.data());
+        benchmark::ClobberMemory();
+    }
+    setCounters(state, iterations);
+}
+
+
+// Perturbation with and without BLA iteration skipping.  The reference orbit
+// and the BLA table are built once per view, outside of the timing, as the
+// renderer does.
+static void perturbationBenchmark(benchmark::State &state, View view, bool use_bla)
+{
+    double spacing;
+    int spacing_exponent;
+    parseScale(view.width, spacing, spacing_exponent);
+    spacing /= image_width;
+
+    const int limbs = BigFixed::limbsForBits(-spacing_exponent + 64);
+    const ReferenceOrbit orbit(BigFixed::fromString(view.center_x, limbs),
+                               BigFixed::fromString(view.center_y, limbs), view.max_iterations);
+    const double max_dc = std::ldexp(spacing*std::hypot(image_width, image_height)/2, spacing_exponent);
+    const BlaTable bla(orbit, max_dc);
+
+    std::vector<double> dcx, dcy;
+    for(int row = 0; row < image_height; ++row)
+    {
+        for(int col = 0; col < image_width; ++col)
+        {
+            dcx.push_back((col - image_width/2)*spacing);
+            dcy.push_back((image_height/2 - row)*spacing);
+        }
+    }
+    std::vector<int> iterations(dcx.size());
+    std::vector<double> norm(dcx.size());
+
+    for(auto _ : state)
+    {
+        perturbationEscapeTime(orbit, use_bla ? &bla : nullptr, dcx.data(), dcy.data(), spacing_exponent,
+                               dcx.size(), view.max_iterations, iterations.data(), norm.data());
+        benchmark::DoNotOptimize(iterations.data());
+        benchmark::ClobberMemory();
+    }
+    setCounters(state, iterations);
+}
+
+
+// The smooth iteration counts of the full set view, which the colorization
+// and encoder benchmarks start from
+static std::vector<float> fullSetSmooth()
+{
+    const View &view = shallow_views[0];
+    std::vector<double> cx, cy;
+    makePoints(view, image_width, image_height, cx, cy);
+    std::vector<int> iterations(cx.size());
+    std::vector<double> norm(cx.size());
+    escapeTimeScalar(cx.data(), cy.data(), cx.size(), view.max_iterations, iterations.data(), norm.data());
+
+    std::vector<float> smooth(cx.size());
+    for(std::size_t i = 0; i < smooth.size(); ++i)
+        smooth[i] = smoothIterations(iterations[i], norm[i], view.max_iterations);
+    return smooth;
+}
+
+
+static void setPixelCounter(benchmark::State &state)
+{
+    state.counters["pixels/s"] = benchmark::Counter(static_cast<double>(state.iterations())*image_width*image_height,
+                                                    benchmark::Counter::kIsRate);
+}
+
+
+static void colorizeBenchmark(benchmark::State &state)
+{
+    const std::vector<float> smooth = fullSetSmooth();
+    const Palette palette = Palette::standard(shallow_views[0].max_iterations);
+    std::vector<unsigned char> bgr(3*smooth.size());
+
+    for(auto _ : state)
+    {
+        colorize(smooth.data(), smooth.size(), palette, bgr.data());
+        benchmark::DoNotOptimize(bgr.data());
+        benchmark::ClobberMemory();
+    }
+    setPixelCounter(state);
+}
+
+
+// Encode the colored full set view into a file of the given format, in bands
+// of 64 rows, optionally compressing on a thread pool
+static void encodeBenchmark(benchmark::State &state, std::string path, bool use_pool)
+{
+    const std::vector<float> smooth = fullSetSmooth();
+    const Palette palette = Palette::standard(shallow_views[0].max_iterations);
+    std::vector<unsigned char> bgr(3*smooth.size());
+    colorize(smooth.data(), smooth.size(), palette, bgr.data());
+
+    const int band_height = 64;
+    std::unique_ptr<ThreadPool> pool;
+    if(use_pool)
+        pool.reset(new ThreadPool());
+
+    for(auto _ : state)
+    {
+        std::unique_ptr<ImageWriter> writer = openImageWriter(path, image_width, image_height, pool.get());
+        for(int row = 0; row < image_height; row += band_height)
+            writer->writeBand(&bgr[3*row*image_width], std::min(band_height, image_height - row));
+        writer->finish();
+    }
+    setPixelCounter(state);
+    std::remove(path.c_str());
+}
+
+
+// The latency of the interactive explorer: the time from starting a frame of
+// the full set view at 4K until its first pass is on screen, cancelling the
+// frame of the previous iteration like a pan does
+static void explorerBenchmark(benchmark::State &state)
+{
+    const int width = 3840, height = 2160;
+    const View &view = shallow_views[0];
+    const double spacing = std::stod(view.width) / width;
+    const double startx = std::stod(view.center_x) - width/2.0*spacing;
+    const double starty = std::stod(view.center_y) + height/2.0*spacing;
+    const EscapeKernel kernel = selectFloatEscapeKernel();
+    const Palette palette = Palette::standard(view.max_iterations);
+
+    ThreadPool pool;
+    ProgressiveRenderer renderer(pool, width, height);
+    std::vector<unsigned char> frame(3*width*height);
+    auto colorPoints = [&](const double *x, const double *y, int count, unsigned char *bgr)
+    {
+        std::vector<double> cx(count), cy(count), norm(count);
+        std::vector<int> iterations(count);
+        std::vector<float> smooth(count);
+        for(int i = 0; i < count; ++i)
+        {
+            cx[i] = startx + x[i]*spacing;
+            cy[i] = starty - y[i]*spacing;
+        }
+        calculateEscapeTimes(kernel, cx.data(), cy.data(), count, view.max_iterations, iterations.data(),
+                             norm.data());
+        for(int i = 0; i < count; ++i)
+            smooth[i] = smoothIterations(iterations[i], norm[i], view.max_iterations);
+        colorize(smooth.data(), count, palette, bgr);
+    };
+
+    for(auto _ : state)
+    {
+        renderer.start(colorPoints);
+        while(renderer.takeFrame(frame.data()) == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    // The rates are per second of wall clock time, which is what counts when
+    // the work is spread over a thread pool
+    for(const View &view : shallow_views)
+    {
+        const std::string name = view.name;
+        benchmark::RegisterBenchmark(("kernel/scalar/" + name).c_str(), kernelBenchmark,
+                                     escapeTimeScalar, true, view)->UseRealTime();
+        benchmark::RegisterBenchmark(("kernel/avx2/" + name).c_str(), kernelBenchmark,
+                                     escapeTimeAvx2, cpuSupportsAvx2(), view)->UseRealTime();
+        benchmark::RegisterBenchmark(("kernel/avx512/" + name).c_str(), kernelBenchmark,
+                                     escapeTimeAvx512, cpuSupportsAvx512(), view)->UseRealTime();
+        benchmark::RegisterBenchmark(("kernel/float-scalar/" + name).c_str(), kernelBenchmark,
+                                     escapeTimeFloat, true, view)->UseRealTime();
+        benchmark::RegisterBenchmark(("kernel/float-avx2/" + name).c_str(), kernelBenchmark,
+                                     escapeTimeFloatAvx2, cpuSupportsAvx2(), view)->UseRealTime();
+        benchmark::RegisterBenchmark(("kernel/float-avx512/" + name).c_str(), kernelBenchmark,
+                                     escapeTimeFloatAvx512, cpuSupportsAvx512(), view)->UseRealTime();
+        benchmark::RegisterBenchmark(("kernel/double-double/" + name).c_str(),
+                                     wideKernelBenchmark<DoubleDouble>, view)->UseRealTime();
+        benchmark::RegisterBenchmark(("kernel/quad-double/" + name).c_str(),
+                                     wideKernelBenchmark<QuadDouble>, view)->UseRealTime();
+    }
+
+    // The other fractal families over their whole sets, next to kernel/scalar/full_set
+    const View julia_view = {"full_set", "0", "0", "3.2", 1000};
+    const View burning_ship_view = {"full_set", "-0.4", "-0.5", "3.6", 1000};
+    benchmark::RegisterBenchmark("kernel/julia/full_set", fractalBenchmark<Julia>, Julia(-0.8, 0.156),
+                                 julia_view)->UseRealTime();
+    benchmark::RegisterBenchmark("kernel/multibrot-3/full_set", fractalBenchmark<Multibrot<3>>, Multibrot<3>(),
+                                 shallow_views[0])->UseRealTime();
+    benchmark::RegisterBenchmark("kernel/multibrot-8/full_set", fractalBenchmark<Multibrot<8>>, Multibrot<8>(),
+                                 shallow_views[0])->UseRealTime();
+    benchmark::RegisterBenchmark("kernel/burning-ship/full_set", fractalBenchmark<BurningShip>, BurningShip(),
+                                 burning_ship_view)->UseRealTime();
+
+    const std::string deep_name = deep_view.name;
+    benchmark::RegisterBenchmark(("kernel/perturbation/" + deep_name).c_str(), perturbationBenchmark,
+                                 deep_view, false)->UseRealTime();
+    benchmark::RegisterBenchmark(("kernel/perturbation-bla/" + deep_name).c_str(), perturbationBenchmark,
+                                 deep_view, true)->UseRealTime();
+
+    benchmark::RegisterBenchmark("explorer/first-pass-4k/full_set", explorerBenchmark)->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark("colorize/full_set", colorizeBenchmark)->UseRealTime();
+    benchmark::RegisterBenchmark("encode/png/full_set", encodeBenchmark, "bench-encode.png", false)->UseRealTime();
+    benchmark::RegisterBenchmark("encode/png-pool/full_set", encodeBenchmark, "bench-encode.png", true)->UseRealTime();
+    benchmark::RegisterBenchmark("encode/tiff/full_set", encodeBenchmark, "bench-encode.tiff", false)->UseRealTime();
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
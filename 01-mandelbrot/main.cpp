@@ -1,81 +1,1206 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <math.h>
+#include <string>
+#include <type_traits>
+#include <vector>
 
-int main(int argc, char *argv[])
+#include "BigFixed.h"
+#include "Antialias.h"
+#include "Buddhabrot.h"
+#include "Checkpoint.h"
+#include "EscapeTime.h"
+#include "ExpMap.h"
+#include "ImageWriter.h"
+#include "IterationBudget.h"
+#include "MarianiSilver.h"
+#include "MultiDouble.h"
+#include "Options.h"
+#include "Palette.h"
+#include "Perturbation.h"
+#include "ProgressiveRenderer.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+#include "TileCache.h"
+#include "TilePyramid.h"
+#include "Tiles.h"
+#include "ZoomSequence.h"
+
+// The number type used for the points of the view: double, DoubleDouble or
+// QuadDouble.  The wider types allow zooms down to a width of about 1e-28
+// (double-double) or 1e-60 (quad-double) without perturbation theory, at the
+// cost of giving up the SIMD kernels.
+//
+// With double, each view is calculated in the narrowest precision that its
+// pixel spacing allows (see selectPrecision): single precision, double
+// precision, or double-double for the views that are too deep for double.
+// With the wider types, every view is calculated in that type.
+#ifndef MANDELBROT_REAL
+#define MANDELBROT_REAL double
+#endif
+typedef MANDELBROT_REAL Real;
+typedef std::conditional<std::is_same<Real, double>::value, DoubleDouble, Real>::type ExtendedReal;
+
+// What the jobs of a batch share, so that each of them doesn't pay for
+// setting it up again: the thread pools, the palettes and the tile caches
+class RenderContext
 {
-    const int max_iterations = 1000;
+public:
+
+    RenderContext(unsigned num_threads, unsigned num_encoder_threads)
+        : kernel(selectEscapeKernel()), float_kernel(selectFloatEscapeKernel()), pool(num_threads),
+          num_encoder_threads_(num_encoder_threads)
+    {
+    }
 
-    const double window_startx = -1.9;
-    const double window_width = 2.5;
-    const double window_starty = 1.2;
-    const double window_height = 1.2;
+    // The widest SIMD kernels that this CPU supports
+    const EscapeKernel kernel;
+    const EscapeKernel float_kernel;
 
-    const int image_width = 2000;
-    const int image_height = round(image_width * window_height / window_width);
-    
-    cv::Mat image(image_height, image_width, CV_8UC3);
+    ThreadPool pool;
 
-    int row, col, n;
-    double x, y, cx, cy, temp;
-    double shade;
-    int B, G, R;
+    // The encoder threads for streaming, started when they are first needed
+    ThreadPool &encoders()
+    {
+        if(!encoders_)
+            encoders_.reset(new ThreadPool(num_encoder_threads_));
+        return *encoders_;
+    }
+
+    const Palette &palette(int max_iterations, double breakpoint)
+    {
+        const std::pair<int, double> key(max_iterations, breakpoint);
+        auto palette = palettes_.find(key);
+        if(palette == palettes_.end())
+            palette = palettes_.insert(std::make_pair(key, Palette::standard(max_iterations, breakpoint))).first;
+        return palette->second;
+    }
 
-    // Loop through each pixel of the output image
-    for(row = 0; row < image_height; ++row)
+    TileCache &cache(const std::string &directory, std::uint64_t max_bytes)
     {
-        for(col = 0; col < image_width; ++col)
+        std::unique_ptr<TileCache> &cache = caches_[directory];
+        if(!cache)
+            cache.reset(new TileCache(directory, max_bytes));
+        return *cache;
+    }
+
+private:
+
+    const unsigned num_encoder_threads_;
+    std::unique_ptr<ThreadPool> encoders_;
+    std::map<std::pair<int, double>, Palette> palettes_;
+    std::map<std::string, std::unique_ptr<TileCache>> caches_;
+};
+
+
+// The points of the pixels of the window, in the number type R
+template <typename R>
+class WindowPoints
+{
+public:
+
+    WindowPoints(const RenderOptions &options, int image_width, int image_height)
+        : startx_(RealTraits<R>::fromString(options.window_startx)),
+          width_(RealTraits<R>::fromString(options.window_width)),
+          starty_(RealTraits<R>::fromString(options.window_starty)),
+          height_(RealTraits<R>::fromString(options.window_height)),
+          image_width_(image_width), image_height_(image_height)
+    {
+    }
+
+    WindowPoints(const R &startx, const R &width, const R &starty, const R &height, int image_width,
+                 int image_height)
+        : startx_(startx), width_(width), starty_(starty), height_(height), image_width_(image_width),
+          image_height_(image_height)
+    {
+    }
+
+    // Calculate the escape times of  count  points given in pixel coordinates,
+    // which need not be whole numbers, with the kernel if R is double
+    void calculate(EscapeKernel kernel, const double *x, const double *y, int count, int max_iterations,
+                   int *iterations, double *norm) const
+    {
+        std::vector<R> cx(count), cy(count);
+        points(x, y, count, cx.data(), cy.data());
+        calculateEscapeTimes(kernel, cx.data(), cy.data(), count, max_iterations, iterations, norm);
+    }
+
+    // The same for another fractal family, with the generic escape time loop
+    template <typename Fractal>
+    void calculate(const Fractal &fractal, const double *x, const double *y, int count, int max_iterations,
+                   int *iterations, double *norm) const
+    {
+        std::vector<R> cx(count), cy(count);
+        points(x, y, count, cx.data(), cy.data());
+        escapeTime(fractal, cx.data(), cy.data(), count, max_iterations, iterations, norm);
+    }
+
+    // The same with the distance estimates, which have no SIMD kernels
+    void calculateWithDistance(const double *x, const double *y, int count, int max_iterations,
+                               int *iterations, double *norm, double *distance) const
+    {
+        std::vector<R> cx(count), cy(count);
+        points(x, y, count, cx.data(), cy.data());
+        escapeTimeWithDistance(cx.data(), cy.data(), count, max_iterations, iterations, norm, distance);
+    }
+
+private:
+
+    void points(const double *x, const double *y, int count, R *cx, R *cy) const
+    {
+        for(int i = 0; i < count; ++i)
         {
-            // Get the point (cx, cy) corresponding to the current pixel
-            cx = window_startx + col*window_width/image_width;
-            cy = window_starty - row*window_height/image_height;
+            cx[i] = startx_ + x[i]*width_/image_width_;
+            cy[i] = starty_ - y[i]*height_/image_height_;
+        }
+    }
 
-            // Calculate the escape time n for point (cx, cy)
-            x = cx;
-            y = cy;
-            for(n = 0; n < max_iterations; ++n)
-            {
-                temp = x;
-                x = x*x - y*y + cx;
-                y = 2*temp*y + cy;
+    R startx_, width_, starty_, height_;
+    int image_width_, image_height_;
+};
 
-                if (x*x + y*y > 256)
-                    break;
-            }
 
-            // Calculate a smooth shade
-            if(n == max_iterations)
-                shade = n;
+// calculate(x, y, count, max_iterations, iterations, norm) calculates the
+// escape times of  count  points given in pixel coordinates
+typedef std::function<void(const double *, const double *, int, int, int *, double *)> CalculateFunction;
+
+template <typename R, typename Fractal>
+static CalculateFunction fractalFunction(const WindowPoints<R> &window, const Fractal &fractal)
+{
+    return [window, fractal](const double *x, const double *y, int count, int max_iterations,
+                             int *iterations, double *norm)
+    {
+        window.calculate(fractal, x, y, count, max_iterations, iterations, norm);
+    };
+}
+
+// The escape times of the fractal family of the options other than the
+// Mandelbrot set.  The family is picked here, once per view, so the escape
+// time loop doesn't branch on it.
+template <typename R>
+static CalculateFunction fractalFunction(const RenderOptions &options, const WindowPoints<R> &window)
+{
+    if(options.fractal == "julia")
+        return fractalFunction(window, Julia(std::stod(options.julia_cx), std::stod(options.julia_cy)));
+    if(options.fractal == "burning-ship")
+        return fractalFunction(window, BurningShip());
+
+    static_assert(max_multibrot_degree == 8, "instantiate the multibrots up to max_multibrot_degree");
+    switch(options.multibrot_degree)
+    {
+    case 3: return fractalFunction(window, Multibrot<3>());
+    case 4: return fractalFunction(window, Multibrot<4>());
+    case 5: return fractalFunction(window, Multibrot<5>());
+    case 6: return fractalFunction(window, Multibrot<6>());
+    case 7: return fractalFunction(window, Multibrot<7>());
+    default: return fractalFunction(window, Multibrot<8>());
+    }
+}
+
+// The family of the options as text, for the messages and the tile cache
+static std::string fractalName(const RenderOptions &options)
+{
+    if(options.fractal == "julia")
+        return "julia " + options.julia_cx + " " + options.julia_cy;
+    if(options.fractal == "multibrot")
+        return "multibrot " + std::to_string(options.multibrot_degree);
+    return options.fractal;
+}
+
+
+// The precision of the escape time loop for a view: the narrowest one that
+// suits the pixel spacing, unless it is given.  Only the Mandelbrot set has
+// single precision kernels.
+static Precision viewPrecision(const RenderOptions &options, double pixel_spacing)
+{
+    Precision precision = Precision::extended;
+    if(std::is_same<Real, double>::value)
+    {
+        if(options.precision == "float")
+            precision = Precision::float32;
+        else if(options.precision == "double")
+            precision = Precision::float64;
+        else if(options.precision == "auto")
+            precision = selectPrecision(pixel_spacing);
+    }
+
+    if(options.fractal != "mandelbrot" && precision == Precision::float32)
+        precision = Precision::float64;
+    return precision;
+}
+
+static std::string precisionName(Precision precision)
+{
+    return precision == Precision::float32 ? RealTraits<float>::name() :
+           precision == Precision::float64 ? RealTraits<double>::name() :
+           RealTraits<ExtendedReal>::name();
+}
+
+
+// The file of a frame of a zoom animation: output_file with the suffix and
+// the frame (a number, or * for the messages) before its extension, such as
+// mandelbrot-preview-00012.png
+static std::string frameFile(const std::string &output_file, const std::string &suffix, const std::string &frame)
+{
+    const std::size_t slash = output_file.find_last_of('/');
+    std::size_t dot = output_file.find_last_of('.');
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = output_file.size();
+    return output_file.substr(0, dot) + suffix + "-" + frame + output_file.substr(dot);
+}
+
+
+static std::string frameNumber(int frame)
+{
+    char number[16];
+    snprintf(number, sizeof(number), "%05d", frame);
+    return number;
+}
+
+
+// The smooth iteration counts of a render only make sense with its budget, so
+// a smooth file has its budget next to it, in smooth_file.budget
+static bool saveBudget(const std::string &smooth_file, int max_iterations)
+{
+    std::ofstream file((smooth_file + ".budget").c_str());
+    file << max_iterations << std::endl;
+    return bool(file);
+}
+
+
+// The budget of a smooth file, or fallback for one without it
+static int loadBudget(const std::string &smooth_file, int fallback)
+{
+    std::ifstream file((smooth_file + ".budget").c_str());
+    int max_iterations;
+    if(!(file >> max_iterations) || max_iterations <= 0)
+        return fallback;
+    return max_iterations;
+}
+
+
+// Render the Buddhabrot of the window instead of its escape times
+static int renderBuddhabrot(const RenderOptions &options, RenderContext &context, int image_width,
+                            int image_height)
+{
+    Buddhabrot buddhabrot(std::stod(options.window_startx), std::stod(options.window_starty),
+                          std::stod(options.window_width), std::stod(options.window_height), image_width,
+                          image_height, options.buddhabrot_min_iterations, options.max_iterations,
+                          options.buddhabrot_seed);
+
+    auto start = std::chrono::steady_clock::now();
+    if(!options.buddhabrot_uniform)
+    {
+        buddhabrot.buildImportanceMap(context.pool);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Built the importance map in " << elapsed.count() << " s" << std::endl;
+        start = std::chrono::steady_clock::now();
+    }
+
+    buddhabrot.render(context.pool, options.buddhabrot_samples);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Drew " << buddhabrot.samples() << " samples in " << elapsed.count() << " s, with "
+              << static_cast<double>(buddhabrot.visits()) / buddhabrot.samples()
+              << " orbit points per sample in the view" << std::endl;
+
+    std::vector<unsigned char> gray = buddhabrot.image(options.buddhabrot_gamma);
+    cv::imwrite(options.output_file, cv::Mat(image_height, image_width, CV_8U, gray.data()));
+    std::cout << "Saved output image to " << options.output_file << std::endl;
+    return 0;
+}
+
+
+// A view of the interactive explorer: the point at the center of the frame and
+// the pixel spacing.  The center is in ExtendedReal, so the view can be zoomed
+// past double precision.
+struct ExplorerView
+{
+    ExtendedReal center_x;
+    ExtendedReal center_y;
+    double spacing;
+};
+
+// The explorer stops zooming in at this pixel spacing, below which double-double
+// runs out of precision; deeper views are for --deep-zoom
+const double explorer_min_spacing = 1e-30;
+
+// The escape times of the pixels of an explorer view, as render() calculates
+// them for a view of its own
+static CalculateFunction explorerFunction(const RenderOptions &options, RenderContext &context,
+                                          const ExplorerView &view, int width, int height, Precision precision)
+{
+    const ExtendedReal startx = view.center_x - width/2.0*view.spacing;
+    const ExtendedReal starty = view.center_y + height/2.0*view.spacing;
+    const ExtendedReal view_width = ExtendedReal(width*view.spacing);
+    const ExtendedReal view_height = ExtendedReal(height*view.spacing);
+
+    if(precision == Precision::extended)
+    {
+        const WindowPoints<ExtendedReal> window(startx, view_width, starty, view_height, width, height);
+        if(options.fractal != "mandelbrot")
+            return fractalFunction(options, window);
+
+        const EscapeKernel kernel = context.kernel;
+        return [window, kernel](const double *x, const double *y, int count, int max_iterations, int *iterations,
+                                double *norm)
+        {
+            window.calculate(kernel, x, y, count, max_iterations, iterations, norm);
+        };
+    }
+
+    // Single and double precision only come up when Real is double
+    const WindowPoints<double> window(RealTraits<ExtendedReal>::toDouble(startx), width*view.spacing,
+                                      RealTraits<ExtendedReal>::toDouble(starty), height*view.spacing,
+                                      width, height);
+    if(options.fractal != "mandelbrot")
+        return fractalFunction(options, window);
+
+    const EscapeKernel kernel = precision == Precision::float32 ? context.float_kernel : context.kernel;
+    return [window, kernel](const double *x, const double *y, int count, int max_iterations, int *iterations,
+                            double *norm)
+    {
+        window.calculate(kernel, x, y, count, max_iterations, iterations, norm);
+    };
+}
+
+
+// The mouse input of the explorer since the last frame was started, as the map
+// from the pixels of the new view to those of the current one:  pixel (col, row)
+// of the new view is pixel (origin_x + col*scale, origin_y + row*scale) of the
+// current one.  OpenCV calls the callback from waitKey, on the thread of the
+// explorer, so it needs no locking.
+struct ExplorerInput
+{
+    double origin_x = 0;
+    double origin_y = 0;
+    double scale = 1;
+
+    bool dragging = false;
+    int drag_x = 0;
+    int drag_y = 0;
+
+    bool moved() const {return origin_x != 0 || origin_y != 0 || scale != 1;}
+
+    // Move the view by (dx, dy) pixels
+    void pan(double dx, double dy)
+    {
+        origin_x += scale*dx;
+        origin_y += scale*dy;
+    }
+
+    // Scale the pixel spacing by factor, keeping pixel (col, row) in place
+    void zoom(double factor, double col, double row)
+    {
+        origin_x += scale*col*(1 - factor);
+        origin_y += scale*row*(1 - factor);
+        scale *= factor;
+    }
+};
+
+// Drag with the left button to pan, turn the wheel to zoom on the pointer, and
+// click the right button to zoom out
+static void onExplorerMouse(int event, int x, int y, int flags, void *data)
+{
+    ExplorerInput &input = *static_cast<ExplorerInput *>(data);
+    if(event == cv::EVENT_LBUTTONDOWN)
+    {
+        input.dragging = true;
+        input.drag_x = x;
+        input.drag_y = y;
+    }
+    else if(event == cv::EVENT_LBUTTONUP)
+    {
+        input.dragging = false;
+    }
+    else if(event == cv::EVENT_MOUSEMOVE && input.dragging)
+    {
+        input.pan(input.drag_x - x, input.drag_y - y);
+        input.drag_x = x;
+        input.drag_y = y;
+    }
+    else if(event == cv::EVENT_MOUSEWHEEL)
+    {
+        // A notch of the wheel is 120, and zooms in or out by a factor of 2
+        input.zoom(std::pow(0.5, cv::getMouseWheelDelta(flags) / 120.0), x, y);
+    }
+    else if(event == cv::EVENT_RBUTTONDOWN)
+    {
+        input.zoom(2, x, y);
+    }
+}
+
+
+// Explore the set interactively, starting from the window of the options.
+// Every view is rendered progressively (see ProgressiveRenderer.h): the frame
+// on screen is reprojected as soon as the view moves, and the passes replace
+// it as they finish.  Keys: + and - zoom on the center, [ and ] halve and
+// double max_iterations (up to auto_iterations_limit), r goes back to the
+// first view, s saves the frame to output_file, and q or Esc quits.
+static int runExplorer(const RenderOptions &options, RenderContext &context, int width, int height)
+{
+    const ExplorerView first_view = {
+        RealTraits<ExtendedReal>::fromString(options.window_startx) +
+            RealTraits<ExtendedReal>::fromString(options.window_width)/2.0,
+        RealTraits<ExtendedReal>::fromString(options.window_starty) -
+            RealTraits<ExtendedReal>::fromString(options.window_height)/2.0,
+        std::stod(options.window_width) / width};
+    ExplorerView view = first_view;
+    int max_iterations = options.max_iterations;
+    const int iterations_limit = std::max(options.auto_iterations_limit, options.max_iterations);
+    const int degree = options.fractal == "multibrot" ? options.multibrot_degree : 2;
+
+    const std::string title = "mandelbrot";
+    cv::namedWindow(title);
+    ExplorerInput input;
+    cv::setMouseCallback(title, onExplorerMouse, &input);
+
+    ProgressiveRenderer renderer(context.pool, width, height);
+    cv::Mat frame(height, width, CV_8UC3, cv::Scalar(0, 0, 0));
+    cv::Mat reprojected(height, width, CV_8UC3);
+    auto started = std::chrono::steady_clock::now();
+
+    auto startFrame = [&]()
+    {
+        const Precision precision = viewPrecision(options, view.spacing);
+        const CalculateFunction calculate = explorerFunction(options, context, view, width, height, precision);
+        const Palette *palette = &context.palette(max_iterations, options.palette_breakpoint);
+        const int frame_iterations = max_iterations;
+        renderer.start([calculate, palette, frame_iterations, degree](const double *x, const double *y, int count,
+                                                                      unsigned char *bgr)
+        {
+            std::vector<int> iterations(count);
+            std::vector<double> norm(count);
+            std::vector<float> smooth(count);
+            calculate(x, y, count, frame_iterations, iterations.data(), norm.data());
+            for(int i = 0; i < count; ++i)
+                smooth[i] = smoothIterations(iterations[i], norm[i], frame_iterations, degree);
+            colorize(smooth.data(), count, *palette, bgr);
+        });
+        started = std::chrono::steady_clock::now();
+    };
+
+    std::cout << "Exploring: drag to pan, wheel, + and - to zoom, [ and ] to change the iterations, "
+                 "r to reset, s to save, q to quit" << std::endl;
+    startFrame();
+    while(true)
+    {
+        const int key = cv::waitKey(5);
+        if(key == 'q' || key == 27)
+            break;
+        else if(key == '+' || key == '=')
+            input.zoom(0.5, width/2.0, height/2.0);
+        else if(key == '-')
+            input.zoom(2, width/2.0, height/2.0);
+        else if((key == ']' && max_iterations < iterations_limit) || (key == '[' && max_iterations > 1))
+        {
+            if(key == ']')
+                max_iterations = max_iterations > iterations_limit/2 ? iterations_limit : 2*max_iterations;
             else
-                shade = n + 1 - log(log(sqrt(x*x + y*y)))/log(2);
-            shade = sqrt(shade / max_iterations);
+                max_iterations /= 2;
+            std::cout << "Using " << max_iterations << " iterations" << std::endl;
+            startFrame();
+        }
+        else if(key == 'r')
+        {
+            view = first_view;
+            max_iterations = options.max_iterations;
+            startFrame();
+        }
+        else if(key == 's')
+        {
+            cv::imwrite(options.output_file, frame);
+            std::cout << "Saved output image to " << options.output_file << std::endl;
+        }
+
+        if(input.moved())
+        {
+            if(view.spacing*input.scale < explorer_min_spacing)
+                input.zoom(explorer_min_spacing / (view.spacing*input.scale), width/2.0, height/2.0);
+
+            // Show the current frame moved to the new view right away...
+            reprojectFrame(frame.ptr<unsigned char>(), width, height, input.origin_x, input.origin_y,
+                           input.scale, reprojected.ptr<unsigned char>());
+            std::swap(frame, reprojected);
+            cv::imshow(title, frame);
+
+            // ...and start rendering it, which cancels the frame in flight
+            const double center_col = input.origin_x + input.scale*width/2.0;
+            const double center_row = input.origin_y + input.scale*height/2.0;
+            view.center_x = view.center_x + (center_col - width/2.0)*view.spacing;
+            view.center_y = view.center_y - (center_row - height/2.0)*view.spacing;
+            view.spacing *= input.scale;
+            input.origin_x = input.origin_y = 0;
+            input.scale = 1;
+            startFrame();
+        }
+
+        const int step = renderer.takeFrame(frame.ptr<unsigned char>());
+        if(step != 0)
+            cv::imshow(title, frame);
+        if(step == 1)
+        {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - started;
+            std::cout << "Rendered the view centered on (" << RealTraits<ExtendedReal>::toDouble(view.center_x)
+                      << ", " << RealTraits<ExtendedReal>::toDouble(view.center_y) << ") with a width of "
+                      << width*view.spacing << " in " << precisionName(viewPrecision(options, view.spacing))
+                      << " precision in " << elapsed.count() << " ms" << std::endl;
+        }
+    }
+
+    cv::destroyAllWindows();
+    return 0;
+}
+
+
+// Render one view.  Returns the exit status.
+static int render(const RenderOptions &options, RenderContext &context)
+{
+    const Real window_width = RealTraits<Real>::fromString(options.window_width);
+    const Real window_height = RealTraits<Real>::fromString(options.window_height);
+
+    const int image_width = options.image_width;
+    const int image_height = round(image_width * RealTraits<Real>::toDouble(window_height / window_width));
+
+    if(options.buddhabrot)
+        return renderBuddhabrot(options, context, image_width, image_height);
+    if(options.interactive)
+        return runExplorer(options, context, image_width, image_height);
+
+    const bool deep_zoom = options.deep_zoom;
+    const bool streaming = options.streaming;
+    const int band_height = options.band_height;
+    const bool antialias = options.antialias;
+    const bool mariani_silver = options.mariani_silver;
+    const int tile_size = options.tile_size;
+    const int zoom_frames = options.zoom_frames;
+    const double zoom_factor = options.zoom_factor;
+
+    const EscapeKernel kernel = context.kernel;
+    ThreadPool &pool = context.pool;
 
-            // Calculate a pretty color based on the shade
-            const double breakpoint = 0.28;
-            if (shade < breakpoint)
+    // Recoloring and zoom animations don't calculate the view itself
+    const bool calculate_view = !options.recolor_only && zoom_frames == 0;
+    const bool auto_iterations = options.auto_iterations && calculate_view;
+
+    const double pixel_spacing = RealTraits<Real>::toDouble(window_width) / image_width;
+    const Precision precision = viewPrecision(options, pixel_spacing);
+    const std::string precision_name = precisionName(precision);
+    const bool mandelbrot = options.fractal == "mandelbrot";
+    const int degree = options.fractal == "multibrot" ? options.multibrot_degree : 2;
+    if(calculate_view && !deep_zoom)
+        std::cout << "Calculating " << (mandelbrot ? "" : fractalName(options) + " ") << "in " << precision_name
+                  << " precision" << std::endl;
+
+    // Everything the result of a tile depends on, apart from the tile itself
+    const std::string image_size = std::to_string(image_width) + "x" + std::to_string(image_height);
+    const std::string cache_view = (mandelbrot ? "" : fractalName(options) + " ") + (deep_zoom ?
+        "deep " + options.deep_center_x + " " + options.deep_center_y + " " + options.deep_width + " " + image_size :
+        "window " + options.window_startx + " " + options.window_width + " " + options.window_starty + " " +
+        options.window_height + " " + image_size);
+    const std::string cache_precision = (deep_zoom ? "perturbation" : precision_name) +
+                                        (mariani_silver ? " mariani-silver" : "");
+
+    // The checkpoint of the render, keyed like the tiles of the cache, with the
+    // settings of the iteration budget instead of the budget, which isn't known
+    // before the reference orbit is
+    std::unique_ptr<Checkpoint> checkpoint;
+    if(!options.checkpoint_file.empty())
+    {
+        const std::string budget = auto_iterations ?
+            "auto " + std::to_string(options.auto_iterations_threshold) + " " +
+            std::to_string(options.auto_iterations_limit) : std::to_string(options.max_iterations);
+        checkpoint.reset(new Checkpoint(options.checkpoint_file, cache_view + " " + budget + " " + cache_precision +
+                                        (options.distance_shading ? " distance" : ""),
+                                        options.resume, options.checkpoint_interval));
+        if(checkpoint->resumedTiles() > 0)
+            std::cout << "Resuming with " << checkpoint->resumedTiles() << " tiles from "
+                      << options.checkpoint_file << std::endl;
+    }
+
+    // calculateWithBudget(x, y, count, max_iterations, iterations, norm) calculates
+    // the escape times of  count  points given in pixel coordinates, which need
+    // not be whole numbers
+    CalculateFunction calculateWithBudget;
+
+    // calculateWithDistance(x, y, count, max_iterations, iterations, norm, distance)
+    // does the same with the distance estimates, for distance shading
+    std::function<void(const double *, const double *, int, int, int *, double *, double *)> calculateWithDistance;
+
+    std::unique_ptr<ReferenceOrbit> orbit;
+    std::unique_ptr<BlaTable> bla;
+
+    if(!deep_zoom && !mandelbrot && precision == Precision::extended)
+    {
+        calculateWithBudget = fractalFunction(options, WindowPoints<ExtendedReal>(options, image_width, image_height));
+    }
+    else if(!deep_zoom && !mandelbrot)
+    {
+        calculateWithBudget = fractalFunction(options, WindowPoints<Real>(options, image_width, image_height));
+    }
+    else if(!deep_zoom && precision == Precision::extended)
+    {
+        const WindowPoints<ExtendedReal> window(options, image_width, image_height);
+        calculateWithBudget = [window, kernel](const double *x, const double *y, int count, int max_iterations,
+                                               int *iterations, double *norm)
+        {
+            window.calculate(kernel, x, y, count, max_iterations, iterations, norm);
+        };
+        calculateWithDistance = [window](const double *x, const double *y, int count, int max_iterations,
+                                         int *iterations, double *norm, double *distance)
+        {
+            window.calculateWithDistance(x, y, count, max_iterations, iterations, norm, distance);
+        };
+    }
+    else if(!deep_zoom)
+    {
+        const WindowPoints<Real> window(options, image_width, image_height);
+        const EscapeKernel window_kernel = precision == Precision::float32 ? context.float_kernel : kernel;
+        calculateWithBudget = [window, window_kernel](const double *x, const double *y, int count,
+                                                      int max_iterations, int *iterations, double *norm)
+        {
+            window.calculate(window_kernel, x, y, count, max_iterations, iterations, norm);
+        };
+        calculateWithDistance = [window](const double *x, const double *y, int count, int max_iterations,
+                                         int *iterations, double *norm, double *distance)
+        {
+            window.calculateWithDistance(x, y, count, max_iterations, iterations, norm, distance);
+        };
+    }
+    else if(calculate_view)
+    {
+        // The pixel spacing is  spacing * 2^spacing_exponent
+        double spacing;
+        int spacing_exponent;
+        parseScale(options.deep_width, spacing, spacing_exponent);
+        spacing /= image_width;
+
+        // Calculate the reference orbit at the center of the view, with enough
+        // precision to tell the pixels apart.  When the budget is estimated, the
+        // orbit must be long enough for any budget up to the limit.
+        const int limbs = BigFixed::limbsForBits(-spacing_exponent + 64);
+        const BigFixed center_x = BigFixed::fromString(options.deep_center_x, limbs);
+        const BigFixed center_y = BigFixed::fromString(options.deep_center_y, limbs);
+        const int orbit_iterations = auto_iterations ? options.auto_iterations_limit : options.max_iterations;
+        std::cout << "Calculating the reference orbit with " << 32*limbs << " bits of precision" << std::endl;
+        if(!checkpoint)
+        {
+            orbit.reset(new ReferenceOrbit(center_x, center_y, orbit_iterations));
+        }
+        else
+        {
+            // Resume the orbit of the checkpoint, and checkpoint it as it goes,
+            // checking the time every orbit_steps iterations
+            const int orbit_steps = 1000;
+            std::vector<double> x, y;
+            BigFixed last_x, last_y;
+            if(checkpoint->loadOrbit(x, y, last_x, last_y))
             {
-                shade = shade / breakpoint;
-                B = shade*240;
-                G = shade*180;
-                R = shade*190;
+                orbit.reset(new ReferenceOrbit(center_x, center_y, orbit_iterations, x, y, last_x, last_y));
+                std::cout << "Resuming the reference orbit at iteration " << orbit->size() - 1 << std::endl;
             }
             else
             {
-                shade = (shade - breakpoint) / (1 - breakpoint);
-                B = (1-shade)*240 + shade*255;
-                G = (1-shade)*180 + shade*255;
-                R = (1-shade)*190 + shade*255;
+                orbit.reset(new ReferenceOrbit(center_x, center_y, orbit_iterations, 0));
+            }
+
+            while(!orbit->extend(orbit_steps))
+                if(checkpoint->due())
+                    checkpoint->storeOrbit(*orbit);
+            checkpoint->storeOrbit(*orbit);
+        }
+
+        // Build the BLA table that lets pixels skip blocks of iterations
+        const double max_dc = std::ldexp(spacing*std::hypot(image_width, image_height)/2, spacing_exponent);
+        bla.reset(new BlaTable(*orbit, max_dc));
+
+        calculateWithBudget = [&, spacing, spacing_exponent](const double *x, const double *y, int count,
+                                                             int max_iterations, int *iterations, double *norm)
+        {
+            // Get the offsets (dcx, dcy) of the pixels from the center of the view
+            std::vector<double> dcx(count), dcy(count);
+            for(int i = 0; i < count; ++i)
+            {
+                dcx[i] = (x[i] - image_width/2.0)*spacing;
+                dcy[i] = (image_height/2.0 - y[i])*spacing;
+            }
+
+            perturbationEscapeTime(*orbit, bla.get(), dcx.data(), dcy.data(), spacing_exponent, count,
+                                   max_iterations, iterations, norm);
+        };
+    }
+
+    int estimated_iterations = 0;
+    if(auto_iterations)
+    {
+        auto start = std::chrono::steady_clock::now();
+        estimated_iterations = estimateMaxIterations(pool, image_width, image_height, calculateWithBudget,
+                                                     options.auto_iterations_threshold,
+                                                     options.auto_iterations_limit);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Estimated a budget of " << estimated_iterations << " iterations in " << elapsed.count()
+                  << " ms" << std::endl;
+    }
+    const int max_iterations = auto_iterations ? estimated_iterations :
+                               options.recolor_only ? loadBudget(options.smooth_file, options.max_iterations) :
+                               options.max_iterations;
+
+    // calculatePoints(x, y, count, iterations, norm) does the same with max_iterations
+    auto calculatePoints = [&](const double *x, const double *y, int count, int *iterations, double *norm)
+    {
+        calculateWithBudget(x, y, count, max_iterations, iterations, norm);
+    };
+
+    // calculatePointsWithDistance(x, y, count, iterations, norm, distance) also
+    // gets the distance estimates, in pixels
+    const bool distance_shading = options.distance_shading;
+    auto calculatePointsWithDistance = [&](const double *x, const double *y, int count, int *iterations,
+                                           double *norm, double *distance)
+    {
+        calculateWithDistance(x, y, count, max_iterations, iterations, norm, distance);
+        for(int i = 0; i < count; ++i)
+            distance[i] /= pixel_spacing;
+    };
+
+    const Palette &palette = context.palette(max_iterations, options.palette_breakpoint);
+
+    // The smooth iteration counts and colors of the image, or when streaming,
+    // of the rows around the current band; row 0 of the buffers is row buffer_y
+    // of the image.  Antialiasing the last row of a band takes the first row of
+    // the next one, so with antialiasing, a band is antialiased and written
+    // once the next one is rendered, and the buffers hold the row above the
+    // band, the band and the next one.
+    const bool whole_image = !streaming && !options.pyramid;
+    const int buffer_rows = whole_image ? image_height : antialias ? 2*band_height + 1 : band_height;
+    cv::Mat smooth(buffer_rows, image_width, CV_32F);
+    cv::Mat image(buffer_rows, image_width, CV_8UC3);
+    cv::Mat distance;
+    if(distance_shading)
+        distance.create(smooth.rows, smooth.cols, CV_32F);
+    int buffer_y = 0;
+
+    // The rows of the image whose smooth iteration counts antialiasing compares
+    // the pixels with: the band being antialiased, and a row on either side
+    int context_y = 0, context_rows = image_height;
+
+    auto colorizeImage = [&](int first, int rows)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for(int row = first; row < first + rows; ++row)
+        {
+            colorize(smooth.ptr<float>(row), image.cols, palette, image.ptr<unsigned char>(row));
+            if(distance_shading)
+                shadeByDistance(distance.ptr<float>(row), image.cols, options.distance_shading_width,
+                                image.ptr<unsigned char>(row));
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if(!streaming)
+            std::cout << "Colorized in " << elapsed.count() << " ms" << std::endl;
+    };
+
+    auto saveImage = [&]()
+    {
+        cv::imwrite(options.output_file, image);
+        std::cout << "Saved output image to " << options.output_file << std::endl;
+    };
+
+    if(options.recolor_only)
+    {
+        smooth = cv::imread(options.smooth_file, cv::IMREAD_UNCHANGED);
+        if(smooth.type() != CV_32F || smooth.rows != image_height || smooth.cols != image_width)
+        {
+            std::cerr << "Can't recolor: " << options.smooth_file << " is missing or doesn't match the view" << std::endl;
+            return 1;
+        }
+        image.create(image_height, image_width, CV_8UC3);
+        colorizeImage(0, image_height);
+        saveImage();
+        return 0;
+    }
+
+    if(zoom_frames > 0)
+    {
+        if(!std::is_same<Real, double>::value)
+        {
+            std::cerr << "Zoom animations are calculated in double, and need a build with MANDELBROT_REAL=double"
+                      << std::endl;
+            return 1;
+        }
+
+        auto calculate = [kernel](const double *cx, const double *cy, int count, int max_iterations,
+                                  int *iterations, double *norm)
+        {
+            calculateEscapeTimes(kernel, cx, cy, count, max_iterations, iterations, norm);
+        };
+
+        const double first_spacing = RealTraits<Real>::toDouble(window_width) / image_width;
+        cv::Mat frame_image(image_height, image_width, CV_8UC3);
+
+        if(options.exp_map)
+        {
+            // From the corners of the first frame down to half a pixel of the last one
+            const double last_spacing = first_spacing * std::pow(zoom_factor, zoom_frames - 1);
+            ExpMapStrip strip(options.zoom_center_x, options.zoom_center_y,
+                              first_spacing * std::hypot(image_width, image_height)/2, last_spacing/2,
+                              ExpMapStrip::columnsFor(image_width, image_height));
+
+            auto start = std::chrono::steady_clock::now();
+            strip.render(pool, tile_size, max_iterations, calculate);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Rendered the " << strip.columns() << " x " << strip.rows() << " strip in "
+                      << elapsed.count() << " s" << std::endl;
+
+            if(!options.exp_map_file.empty())
+                cv::imwrite(options.exp_map_file, cv::Mat(strip.rows(), strip.columns(), CV_32F,
+                                                          const_cast<float *>(strip.smooth().data())));
+            strip.colorize(palette);
+
+            start = std::chrono::steady_clock::now();
+            double spacing = first_spacing;
+            for(int frame = 0; frame < zoom_frames; ++frame)
+            {
+                strip.renderFrame(spacing, image_width, image_height, pool, frame_image.data);
+                cv::imwrite(frameFile(options.output_file, "", frameNumber(frame)), frame_image);
+                spacing *= zoom_factor;
+            }
+            elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Resampled " << zoom_frames << " frames to " << frameFile(options.output_file, "", "*")
+                      << " in " << elapsed.count() << " s" << std::endl;
+            return 0;
+        }
+
+        const std::string suffix = options.zoom_final ? "" : "-preview";
+        ZoomSequence sequence(image_width, image_height,
+                              options.zoom_final ? options.zoom_final_tolerance : options.zoom_preview_tolerance);
+        ZoomView view = {options.zoom_center_x, options.zoom_center_y, first_spacing};
+        long long calculated = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for(int frame = 0; frame < zoom_frames; ++frame)
+        {
+            calculated += sequence.renderFrame(view, pool, tile_size, max_iterations, calculate);
+            colorize(sequence.smooth().data(), image_width*image_height, palette, frame_image.data);
+            cv::imwrite(frameFile(options.output_file, suffix, frameNumber(frame)), frame_image);
+            view.spacing *= zoom_factor;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "Rendered " << zoom_frames << " frames to " << frameFile(options.output_file, suffix, "*")
+                  << " in " << elapsed.count() << " s, calculating " << 100.0 * calculated / (static_cast<double>(zoom_frames) * frame_image.total())
+                  << "% of the pixels" << std::endl;
+        return 0;
+    }
+
+    // calculateRow(row, col, count, iterations, norm) calculates the escape times
+    // of  count  pixels in the given row, starting from the given column
+    auto calculateRow = [&](int row, int col, int count, int *iterations, double *norm)
+    {
+        std::vector<double> x(count), y(count, row);
+        for(int i = 0; i < count; ++i)
+            x[i] = col + i;
+        calculatePoints(x.data(), y.data(), count, iterations, norm);
+    };
+    auto calculateRowWithDistance = [&](int row, int col, int count, int *iterations, double *norm,
+                                        double *distance)
+    {
+        std::vector<double> x(count), y(count, row);
+        for(int i = 0; i < count; ++i)
+            x[i] = col + i;
+        calculatePointsWithDistance(x.data(), y.data(), count, iterations, norm, distance);
+    };
+
+    std::atomic<long> calculated_pixels(0);
+
+    TileCache *cache = options.use_cache ? &context.cache(options.cache_directory, options.cache_max_bytes) : nullptr;
+    const long cache_hits = cache ? cache->hits() : 0;
+    const long cache_misses = cache ? cache->misses() : 0;
+
+    std::unique_ptr<RenderStats> stats;
+    if(!options.stats_file.empty() || !options.heatmap_file.empty())
+        stats.reset(new RenderStats(max_iterations));
+
+    // Calculate the smooth iteration counts of a tile, into rows of  stride  floats,
+    // and with distance shading, the distance estimates into distance_out
+    auto calculateTile = [&](const Tile &tile, float *out, int stride, float *distance_out)
+    {
+        const double start = stats ? stats->now() : 0;
+
+        if(checkpoint && checkpoint->loadTile(tile, out, distance_out, stride))
+        {
+            if(stats)
+                stats->recordCached(tile, start);
+            return;
+        }
+
+        const std::string key = cache ? tileKey(cache_view, tile, max_iterations, cache_precision) : "";
+        if(cache && cache->load(key, tile.width, tile.height, out, stride))
+        {
+            if(stats)
+                stats->recordCached(tile, start);
+            return;
+        }
+
+        std::vector<int> iterations(tile.width*tile.height);
+        std::vector<double> norm(tile.width*tile.height);
+        std::vector<double> tile_distance(distance_out ? tile.width*tile.height : 0);
+
+        // Calculate the escape time n for every pixel in the tile
+        int calculated = tile.width*tile.height;
+        if(mariani_silver)
+        {
+            calculated = marianiSilver(tile, calculateRow, iterations.data(), norm.data());
+        }
+        else if(distance_out)
+        {
+            for(int row = 0; row < tile.height; ++row)
+                calculateRowWithDistance(tile.y + row, tile.x, tile.width, &iterations[row*tile.width],
+                                         &norm[row*tile.width], &tile_distance[row*tile.width]);
+        }
+        else
+        {
+            for(int row = 0; row < tile.height; ++row)
+                calculateRow(tile.y + row, tile.x, tile.width,
+                             &iterations[row*tile.width], &norm[row*tile.width]);
+        }
+        calculated_pixels += calculated;
+        if(stats)
+            stats->record(tile, start, iterations.data(), calculated);
+
+        for(int row = 0; row < tile.height; ++row)
+        {
+            for(int col = 0; col < tile.width; ++col)
+            {
+                const int i = row*tile.width + col;
+                out[row*stride + col] = smoothIterations(iterations[i], norm[i], max_iterations, degree);
+                if(distance_out)
+                    distance_out[row*stride + col] = tile_distance[i];
             }
+        }
+
+        if(cache)
+            cache->store(key, tile.width, tile.height, out, stride);
+        if(checkpoint)
+            checkpoint->storeTile(tile, out, distance_out, stride);
+    };
+
+    auto renderTile = [&](const Tile &tile)
+    {
+        calculateTile(tile, smooth.ptr<float>(tile.y - buffer_y) + tile.x, image_width,
+                      distance_shading ? distance.ptr<float>(tile.y - buffer_y) + tile.x : nullptr);
+    };
 
-            // Set the pixel color
-            image.at<cv::Vec3b>(row, col) = cv::Vec3b(B, G, R);
+    std::atomic<long> supersampled_pixels(0);
+
+    // Supersample the pixels of a tile that need it, after the band it is in
+    // (or the whole image) has been colorized
+    auto antialiasTile = [&](const Tile &tile)
+    {
+        const float *context_smooth = smooth.ptr<float>(context_y - buffer_y);
+        if(!distance_shading)
+        {
+            supersampled_pixels += supersampleTile(tile, buffer_y, context_smooth, context_y, image_width,
+                                                   context_rows, options.aa_grid, options.aa_threshold,
+                                                   max_iterations, palette, calculatePoints,
+                                                   image.ptr<unsigned char>(0), degree);
+            return;
         }
+
+        // With distance shading, the pixels near the set need it too, and the
+        // samples are shaded by their own distances
+        auto needs = [&](int col, int row)
+        {
+            return distance.at<float>(row - buffer_y, col) < options.aa_distance ||
+                   needsSupersampling(context_smooth, image_width, context_rows, col, row - context_y,
+                                      options.aa_threshold);
+        };
+        auto colorSamples = [&](const double *x, const double *y, int count, unsigned char *bgr)
+        {
+            std::vector<int> iterations(count);
+            std::vector<double> norm(count), sample_distance(count);
+            std::vector<float> sample_smooth(count), shade_distance(count);
+            calculatePointsWithDistance(x, y, count, iterations.data(), norm.data(), sample_distance.data());
+            for(int k = 0; k < count; ++k)
+            {
+                sample_smooth[k] = smoothIterations(iterations[k], norm[k], max_iterations);
+                shade_distance[k] = sample_distance[k];
+            }
+            colorize(sample_smooth.data(), count, palette, bgr);
+            shadeByDistance(shade_distance.data(), count, options.distance_shading_width, bgr);
+        };
+        supersampled_pixels += supersamplePixels(tile, buffer_y, image_width, options.aa_grid, needs, colorSamples,
+                                                 image.ptr<unsigned char>(0));
+    };
+
+    if(options.pyramid)
+    {
+        TilePyramid tiles(options.pyramid_name, image_width, image_height, options.pyramid_tile_size,
+                          options.pyramid_layout);
+        const int count = tiles.build(pool, [&](const Tile &tile, unsigned char *bgr)
+        {
+            std::vector<float> tile_smooth(tile.width*tile.height);
+            std::vector<float> tile_distance(distance_shading ? tile.width*tile.height : 0);
+            calculateTile(tile, tile_smooth.data(), tile.width, distance_shading ? tile_distance.data() : nullptr);
+            colorize(tile_smooth.data(), tile_smooth.size(), palette, bgr);
+            if(distance_shading)
+                shadeByDistance(tile_distance.data(), tile_distance.size(), options.distance_shading_width, bgr);
+        });
+        std::cout << "Wrote " << count << " tiles in " << tiles.levels() << " levels to " << options.pyramid_name
+                  << (options.pyramid_layout == PyramidLayout::dzi ? ".dzi" : "/") << std::endl;
     }
+    else if(!streaming)
+    {
+        renderTiles(pool, makeTiles(image_width, image_height, tile_size), renderTile);
+        if(!options.smooth_file.empty())
+        {
+            cv::imwrite(options.smooth_file, smooth);
+            if(!saveBudget(options.smooth_file, max_iterations))
+            {
+                std::cerr << "Can't write " << options.smooth_file << ".budget" << std::endl;
+                return 1;
+            }
+        }
+
+        colorizeImage(0, image_height);
+        if(antialias)
+            renderTiles(pool, makeTiles(image_width, image_height, tile_size), antialiasTile);
+        saveImage();
+    }
+    else
+    {
+        BackgroundWriter writer(openImageWriter(options.streaming_file, image_width, image_height,
+                                                &context.encoders()),
+                                options.max_queued_bands);
+
+        // Antialias a band, with the rows of the image up to  context_end  to
+        // compare its pixels with, and write it
+        auto finishBand = [&](const Tile &band, int context_end)
+        {
+            context_y = std::max(band.y - 1, 0);
+            context_rows = context_end - context_y;
+            renderTiles(pool, makeTiles(band, tile_size), antialiasTile);
+            writer.writeBand(image.ptr<unsigned char>(band.y - buffer_y), band.height);
+        };
+
+        buffer_y = antialias ? -1 : 0;
+        Tile previous = {0, 0, 0, 0};
+        for(int band_y = 0; band_y < image_height; band_y += band_height)
+        {
+            const Tile band = {0, band_y, image_width, std::min(band_height, image_height - band_y)};
+            renderTiles(pool, makeTiles(band, tile_size), renderTile);
+            colorizeImage(band_y - buffer_y, band.height);
+            if(!antialias)
+            {
+                writer.writeBand(image.ptr<unsigned char>(0), band.height);
+                buffer_y += band_height;
+                continue;
+            }
 
-    cv::imwrite("mandelbrot.png", image);
+            // Now that its next row is in, finish the previous band, and move
+            // this one up in its place, with the row above it
+            if(band_y > 0)
+            {
+                finishBand(previous, band_y + 1);
+                for(cv::Mat *buffer : {&smooth, &image, &distance})
+                    if(!buffer->empty())
+                        std::memmove(buffer->ptr(0), buffer->ptr(band_height), (band.height + 1)*buffer->step[0]);
+                buffer_y += band_height;
+            }
+            previous = band;
+        }
+        if(antialias)
+            finishBand(previous, image_height);
+        writer.finish();
+        std::cout << "Saved output image to " << options.streaming_file << std::endl;
+    }
+
+    if(mariani_silver)
+        std::cout << "Calculated " << calculated_pixels << " of " << image_width*image_height
+                  << " pixels" << std::endl;
+    if(cache)
+        std::cout << "Loaded " << cache->hits() - cache_hits << " of "
+                  << cache->hits() - cache_hits + cache->misses() - cache_misses << " tiles from the cache" << std::endl;
+    if(antialias)
+        std::cout << "Supersampled " << supersampled_pixels << " of " << image_width*image_height
+                  << " pixels" << std::endl;
+    if(checkpoint)
+    {
+        checkpoint->flush();
+        std::cout << "Saved the checkpoint to " << options.checkpoint_file << std::endl;
+    }
 
-    std::cout << "Saved output image to mandelbrot.png" << std::endl;
+    if(!options.stats_file.empty())
+    {
+        stats->write(options.stats_file);
+        std::cout << "Saved tile statistics to " << options.stats_file << std::endl;
+    }
+    if(!options.heatmap_file.empty())
+    {
+        stats->writeHeatmap(options.heatmap_file);
+        std::cout << "Saved tile time heatmap to " << options.heatmap_file << std::endl;
+    }
 
     return 0;
 }
 
+
+int main(int argc, char *argv[])
+{
+    RenderOptions options;
+    std::vector<RenderOptions> jobs;
+    try
+    {
+        parseOptions(std::vector<std::string>(argv + 1, argv + argc), options);
+        if(options.help)
+        {
+            std::cout << usage();
+            return 0;
+        }
+        jobs = options.jobs_file.empty() ? std::vector<RenderOptions>(1, options)
+                                         : readJobFile(options.jobs_file, options);
+    }
+    catch(const std::exception &error)
+    {
+        std::cerr << error.what() << "\n\n" << usage();
+        return 1;
+    }
+
+    RenderContext context(options.num_threads, options.num_encoder_threads);
+    std::cout << "Rendering on " << context.pool.size() << " threads" << std::endl;
+    if(std::is_same<Real, double>::value)
+        std::cout << "Using the " << escapeKernelName(context.kernel) << " and "
+                  << escapeKernelName(context.float_kernel) << " escape time kernels" << std::endl;
+    else
+        std::cout << "Using " << RealTraits<Real>::name() << " arithmetic" << std::endl;
+
+    // A job that fails doesn't stop the rest of the batch
+    int failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t job = 0; job < jobs.size(); ++job)
+    {
+        try
+        {
+            if(render(jobs[job], context) != 0)
+                ++failed;
+        }
+        catch(const std::exception &error)
+        {
+            std::cerr << "Job " << job + 1 << " failed: " << error.what() << std::endl;
+            ++failed;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if(jobs.size() > 1)
+        std::cout << "Rendered " << jobs.size() - failed << " of " << jobs.size() << " jobs in "
+                  << elapsed.count() << " s" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
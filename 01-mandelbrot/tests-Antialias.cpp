@@ -0,0 +1,165 @@
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "catch.hpp"
+#include "Antialias.h"
+#include "EscapeTime.h"
+
+
+SCENARIO( "only pixels with sharp changes in the smooth iteration count are supersampled" )
+{
+    GIVEN( "a buffer with a sharp edge down the middle" )
+    {
+        const int width = 8, height = 4;
+        std::vector<float> smooth(width*height);
+        for(int y = 0; y < height; ++y)
+            for(int x = 0; x < width; ++x)
+                smooth[y*width + x] = x < 4 ? 10 + 0.1f*x : 50;
+
+        THEN( "the pixels on either side of the edge need supersampling" )
+        {
+            for(int y = 0; y < height; ++y)
+            {
+                for(int x = 0; x < width; ++x)
+                {
+                    INFO( "pixel " << x << ", " << y );
+                    CHECK( needsSupersampling(smooth.data(), width, height, x, y, 1.0f) == (x == 3 || x == 4) );
+                }
+            }
+        }
+    }
+
+    THEN( "the jitter stays inside the unit interval and differs between samples" )
+    {
+        double sum = 0;
+        for(int k = 0; k < 1000; ++k)
+        {
+            const double u = jitter(17, 23, k);
+            REQUIRE( u >= 0.0 );
+            REQUIRE( u < 1.0 );
+            sum += u;
+        }
+        CHECK( sum / 1000 == Approx(0.5).epsilon(0.05) );
+        CHECK( jitter(1, 2, 3) == jitter(1, 2, 3) );
+        CHECK( jitter(1, 2, 3) != jitter(2, 1, 3) );
+    }
+}
+
+
+SCENARIO( "supersampling smooths the edges of the set" )
+{
+    // The default view, at a low resolution
+    const int width = 250, height = 120, max_iterations = 500;
+    auto calculatePoints = [&](const double *x, const double *y, int count, int *iterations, double *norm)
+    {
+        std::vector<double> cx(count), cy(count);
+        for(int i = 0; i < count; ++i)
+        {
+            cx[i] = -1.9 + x[i]*2.5/width;
+            cy[i] = 1.2 - y[i]*1.2/height;
+        }
+        escapeTimeScalar(cx.data(), cy.data(), count, max_iterations, iterations, norm);
+    };
+
+    std::vector<float> smooth(width*height);
+    std::vector<int> iterations(width);
+    std::vector<double> x(width), y(width), norm(width);
+    for(int row = 0; row < height; ++row)
+    {
+        for(int col = 0; col < width; ++col)
+        {
+            x[col] = col;
+            y[col] = row;
+        }
+        calculatePoints(x.data(), y.data(), width, iterations.data(), norm.data());
+        for(int col = 0; col < width; ++col)
+            smooth[row*width + col] = smoothIterations(iterations[col], norm[col], max_iterations);
+    }
+
+    const Palette palette = Palette::standard(max_iterations);
+    std::vector<unsigned char> bgr(3*width*height);
+    colorize(smooth.data(), smooth.size(), palette, bgr.data());
+    const std::vector<unsigned char> aliased = bgr;
+
+    GIVEN( "the image split into a band and tiles" )
+    {
+        // The bottom half of the image, as one band
+        const int band_y = height/2;
+        Tile band = {0, band_y, width, height - band_y};
+        int supersampled = 0;
+        for(const Tile &tile : makeTiles(band, 32))
+            supersampled += supersampleTile(tile, band_y, &smooth[band_y*width], band_y, width, band.height, 4,
+                                            1.0f, max_iterations, palette, calculatePoints, &bgr[3*band_y*width]);
+
+        THEN( "only a fraction of the pixels are supersampled" )
+        {
+            CHECK( supersampled > 0 );
+            CHECK( supersampled < band.width*band.height / 2 );
+        }
+
+        THEN( "only the pixels of the band change" )
+        {
+            for(int i = 0; i < 3*band_y*width; ++i)
+                REQUIRE( bgr[i] == aliased[i] );
+        }
+
+        THEN( "pixels that weren't supersampled keep their color" )
+        {
+            for(int row = band_y; row < height; ++row)
+            {
+                for(int col = 0; col < width; ++col)
+                {
+                    if(needsSupersampling(&smooth[band_y*width], width, band.height, col, row - band_y, 1.0f))
+                        continue;
+                    const int i = 3*(row*width + col);
+                    REQUIRE( bgr[i] == aliased[i] );
+                    REQUIRE( bgr[i + 2] == aliased[i + 2] );
+                }
+            }
+        }
+
+        THEN( "the result doesn't depend on the tiling" )
+        {
+            std::vector<unsigned char> other = aliased;
+            for(const Tile &tile : makeTiles(band, 50))
+                supersampleTile(tile, band_y, &smooth[band_y*width], band_y, width, band.height, 4, 1.0f,
+                                max_iterations, palette, calculatePoints, &other[3*band_y*width]);
+            CHECK( other == bgr );
+        }
+    }
+
+    GIVEN( "the image split into bands that see a row of the bands next to them" )
+    {
+        const int band_height = 16;
+        for(int band_y = 0; band_y < height; band_y += band_height)
+        {
+            const Tile band = {0, band_y, width, std::min(band_height, height - band_y)};
+            const int smooth_y = std::max(band_y - 1, 0);
+            const int smooth_rows = std::min(band_y + band.height + 1, height) - smooth_y;
+            for(const Tile &tile : makeTiles(band, 32))
+                supersampleTile(tile, band_y, &smooth[smooth_y*width], smooth_y, width, smooth_rows, 4, 1.0f,
+                                max_iterations, palette, calculatePoints, &bgr[3*band_y*width]);
+        }
+
+        THEN( "the result is that of the whole image, seams and all" )
+        {
+            std::vector<unsigned char> whole = aliased;
+            for(const Tile &tile : makeTiles(width, height, 32))
+                supersampleTile(tile, 0, smooth.data(), 0, width, height, 4, 1.0f, max_iterations, palette,
+                                calculatePoints, whole.data());
+            CHECK( whole == bgr );
+
+            // Without the rows of context, edges along the seams are missed
+            std::vector<unsigned char> seams = aliased;
+            for(int band_y = 0; band_y < height; band_y += band_height)
+            {
+                const Tile band = {0, band_y, width, std::min(band_height, height - band_y)};
+                for(const Tile &tile : makeTiles(band, 32))
+                    supersampleTile(tile, band_y, &smooth[band_y*width], band_y, width, band.height, 4, 1.0f,
+                                    max_iterations, palette, calculatePoints, &seams[3*band_y*width]);
+            }
+            CHECK( seams != whole );
+        }
+    }
+}
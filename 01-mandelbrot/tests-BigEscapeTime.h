@@ -0,0 +1,30 @@
+#ifndef TESTS_BIG_ESCAPE_TIME_H_
+#define TESTS_BIG_ESCAPE_TIME_H_
+
+#include "BigFixed.h"
+#include "EscapeTime.h"
+
+// The escape times the tests of the wider number types are checked against
+
+
+// The plain escape time loop, in arbitrary precision
+static int bigEscapeTime(const BigFixed &cx, const BigFixed &cy, int max_iterations)
+{
+    BigFixed x = cx, y = cy, temp;
+    int n;
+    for(n = 0; n < max_iterations; ++n)
+    {
+        temp = x;
+        x = (x + y)*(x - y) + cx;
+        y = (temp*y).twice() + cy;
+
+        const double dx = x.toDouble();
+        const double dy = y.toDouble();
+        if(dx*dx + dy*dy > escape_radius_squared)
+            break;
+    }
+    return n;
+}
+
+
+#endif  // TESTS_BIG_ESCAPE_TIME_H_
@@ -0,0 +1,122 @@
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "catch.hpp"
+#include "Buddhabrot.h"
+
+
+// The density divided by its sum
+static std::vector<double> normalized(const Buddhabrot &buddhabrot)
+{
+    double sum = 0;
+    for(std::uint64_t d : buddhabrot.density())
+        sum += d;
+    std::vector<double> result;
+    for(std::uint64_t d : buddhabrot.density())
+        result.push_back(d / sum);
+    return result;
+}
+
+
+SCENARIO( "the Buddhabrot density doesn't depend on the threads" )
+{
+    ThreadPool one_thread(1), three_threads(3);
+
+    GIVEN( "the whole set, sampled uniformly" )
+    {
+        Buddhabrot single(-2, 1.5, 3, 3, 60, 60, 1, 100, 7);
+        Buddhabrot multi(-2, 1.5, 3, 3, 60, 60, 1, 100, 7);
+        single.render(one_thread, 50000);
+        multi.render(three_threads, 50000);
+
+        THEN( "the densities are the same" )
+        {
+            CHECK( single.samples() == 50000 );
+            CHECK( multi.samples() == 50000 );
+            CHECK( single.visits() > 0 );
+            CHECK( single.visits() == multi.visits() );
+            CHECK( single.density() == multi.density() );
+        }
+    }
+
+    GIVEN( "a view sampled from the importance map" )
+    {
+        Buddhabrot single(-0.5, 0.9, 0.3, 0.3, 16, 16, 10, 200, 7);
+        Buddhabrot multi(-0.5, 0.9, 0.3, 0.3, 16, 16, 10, 200, 7);
+        single.buildImportanceMap(one_thread, 32, 8);
+        multi.buildImportanceMap(three_threads, 32, 8);
+        single.render(one_thread, 20000);
+        multi.render(three_threads, 20000);
+
+        THEN( "the densities are the same" )
+        {
+            CHECK( single.visits() > 0 );
+            CHECK( single.density() == multi.density() );
+        }
+    }
+}
+
+
+SCENARIO( "importance sampling spends the samples on the view" )
+{
+    ThreadPool pool(2);
+
+    GIVEN( "a zoomed in view, sampled both ways" )
+    {
+        Buddhabrot uniform(-0.5, 0.9, 0.3, 0.3, 8, 8, 10, 200, 1);
+        uniform.render(pool, 1000000);
+        Buddhabrot importance(-0.5, 0.9, 0.3, 0.3, 8, 8, 10, 200, 1);
+        importance.buildImportanceMap(pool, 64, 16);
+        importance.render(pool, 100000);
+
+        THEN( "many more orbit points land in the view" )
+        {
+            // A tenth of the samples, and still several times the orbit points
+            CHECK( importance.visits() > 3*uniform.visits() );
+        }
+
+        THEN( "the density has the same shape" )
+        {
+            const std::vector<double> a = normalized(uniform), b = normalized(importance);
+            double difference = 0;
+            for(std::size_t i = 0; i < a.size(); ++i)
+                difference += std::fabs(a[i] - b[i]);
+            CHECK( difference < 0.1 );
+        }
+    }
+
+    GIVEN( "a view away from the set" )
+    {
+        Buddhabrot buddhabrot(3, 1, 1, 1, 8, 8, 1, 100, 1);
+        buddhabrot.buildImportanceMap(pool, 16, 4);
+        buddhabrot.render(pool, 10000);
+
+        THEN( "nothing lands in it" )
+        {
+            CHECK( buddhabrot.visits() == 0 );
+            CHECK( buddhabrot.image() == std::vector<unsigned char>(64, 0) );
+        }
+    }
+}
+
+
+SCENARIO( "the Buddhabrot image is scaled to the dense pixels" )
+{
+    ThreadPool pool(1);
+    Buddhabrot buddhabrot(-2, 1.5, 3, 3, 40, 40, 1, 100, 3);
+    buddhabrot.render(pool, 20000);
+    const std::vector<unsigned char> gray = buddhabrot.image();
+
+    THEN( "the densest pixels are white and the empty ones black" )
+    {
+        int white = 0;
+        for(std::size_t i = 0; i < gray.size(); ++i)
+        {
+            white += gray[i] == 255;
+            if(buddhabrot.density()[i] == 0)
+                CHECK( gray[i] == 0 );
+        }
+        CHECK( white >= 1 );
+    }
+}
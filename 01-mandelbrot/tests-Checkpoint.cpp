@@ -0,0 +1,178 @@
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+#include "catch.hpp"
+#include "Checkpoint.h"
+
+
+static const char *const checkpoint_path = "tests-checkpoint.tmp";
+
+static std::vector<float> tileValues(const Tile &tile, float offset)
+{
+    std::vector<float> values(tile.width*tile.height);
+    for(std::size_t i = 0; i < values.size(); ++i)
+        values[i] = offset + tile.x + 0.25f*i;
+    return values;
+}
+
+static long fileSize(const char *path)
+{
+    std::FILE *file = std::fopen(path, "rb");
+    std::fseek(file, 0, SEEK_END);
+    const long size = std::ftell(file);
+    std::fclose(file);
+    return size;
+}
+
+
+SCENARIO( "a checkpoint keeps the finished tiles" )
+{
+    const Tile first = {0, 0, 16, 8}, second = {16, 0, 16, 8}, missing = {32, 0, 16, 8};
+    const std::vector<float> first_values = tileValues(first, 0), second_values = tileValues(second, 0);
+    const std::vector<float> second_distance = tileValues(second, 100);
+    {
+        Checkpoint checkpoint(checkpoint_path, "view A", false, 0);
+        checkpoint.storeTile(first, first_values.data(), nullptr, first.width);
+        checkpoint.storeTile(second, second_values.data(), second_distance.data(), second.width);
+    }
+
+    GIVEN( "a resumed checkpoint of the same render" )
+    {
+        Checkpoint checkpoint(checkpoint_path, "view A", true, 0);
+
+        THEN( "it has the tiles, with their distances" )
+        {
+            CHECK( checkpoint.resumedTiles() == 2 );
+
+            std::vector<float> smooth(first.width*first.height), distance(smooth.size());
+            CHECK( checkpoint.loadTile(first, smooth.data(), nullptr, first.width) );
+            CHECK( smooth == first_values );
+            CHECK( checkpoint.loadTile(second, smooth.data(), distance.data(), second.width) );
+            CHECK( smooth == second_values );
+            CHECK( distance == second_distance );
+
+            CHECK_FALSE( checkpoint.loadTile(missing, smooth.data(), nullptr, missing.width) );
+            CHECK_FALSE( checkpoint.loadTile(first, smooth.data(), distance.data(), first.width) );
+        }
+
+        THEN( "tiles are loaded into rows of any stride" )
+        {
+            std::vector<float> image(3*first.width*first.height, -1);
+            CHECK( checkpoint.loadTile(first, image.data() + 1, nullptr, 3*first.width) );
+            CHECK( image[1] == first_values[0] );
+            CHECK( image[3*first.width + 1] == first_values[first.width] );
+            CHECK( image[0] == -1 );
+        }
+    }
+
+    GIVEN( "a checkpoint that isn't resumed" )
+    {
+        Checkpoint checkpoint(checkpoint_path, "view A", false, 0);
+        std::vector<float> smooth(first.width*first.height);
+
+        THEN( "it starts from scratch" )
+        {
+            CHECK( checkpoint.resumedTiles() == 0 );
+            CHECK_FALSE( checkpoint.loadTile(first, smooth.data(), nullptr, first.width) );
+        }
+    }
+
+    GIVEN( "a checkpoint of another render" )
+    {
+        THEN( "resuming it is an error" )
+        {
+            CHECK_THROWS_AS( Checkpoint(checkpoint_path, "view B", true, 0), std::runtime_error );
+        }
+    }
+
+    GIVEN( "a checkpoint whose last record was cut short" )
+    {
+        REQUIRE( truncate(checkpoint_path, fileSize(checkpoint_path) - 5) == 0 );
+
+        THEN( "the complete records are kept, and new ones follow them" )
+        {
+            {
+                Checkpoint checkpoint(checkpoint_path, "view A", true, 0);
+                CHECK( checkpoint.resumedTiles() == 1 );
+                checkpoint.storeTile(missing, first_values.data(), nullptr, missing.width);
+            }
+
+            Checkpoint checkpoint(checkpoint_path, "view A", true, 0);
+            CHECK( checkpoint.resumedTiles() == 2 );
+            std::vector<float> smooth(missing.width*missing.height);
+            CHECK( checkpoint.loadTile(missing, smooth.data(), nullptr, missing.width) );
+            CHECK( smooth == first_values );
+        }
+    }
+
+    std::remove(checkpoint_path);
+}
+
+
+SCENARIO( "records are written once the interval has passed" )
+{
+    const Tile tile = {0, 0, 8, 8};
+    const std::vector<float> values = tileValues(tile, 0);
+    {
+        Checkpoint checkpoint(checkpoint_path, "view", false, 3600);
+        const long empty = fileSize(checkpoint_path);
+        checkpoint.storeTile(tile, values.data(), nullptr, tile.width);
+        CHECK_FALSE( checkpoint.due() );
+        CHECK( fileSize(checkpoint_path) == empty );
+
+        checkpoint.flush();
+        CHECK( fileSize(checkpoint_path) > empty );
+    }
+    std::remove(checkpoint_path);
+}
+
+
+SCENARIO( "a reference orbit resumes from a checkpoint" )
+{
+    const int limbs = 4;
+    const BigFixed cx = BigFixed::fromString("-0.7436438870371587047521915", limbs);
+    const BigFixed cy = BigFixed::fromString("0.1318259042053119704931320", limbs);
+    const int max_iterations = 3000;
+    const ReferenceOrbit whole(cx, cy, max_iterations);
+
+    // Calculate the orbit in steps, checkpointing after each, and stop halfway
+    {
+        Checkpoint checkpoint(checkpoint_path, "deep view", false, 0);
+        ReferenceOrbit orbit(cx, cy, max_iterations, 0);
+        for(int step = 0; step < 3; ++step)
+        {
+            orbit.extend(500);
+            checkpoint.storeOrbit(orbit);
+        }
+    }
+
+    Checkpoint checkpoint(checkpoint_path, "deep view", true, 0);
+    std::vector<double> x, y;
+    BigFixed last_x, last_y;
+    REQUIRE( checkpoint.loadOrbit(x, y, last_x, last_y) );
+    CHECK( x.size() == 1501 );
+
+    ReferenceOrbit resumed(cx, cy, max_iterations, x, y, last_x, last_y);
+    CHECK_FALSE( resumed.finished() );
+    CHECK( resumed.extend(max_iterations) );
+
+    THEN( "it is the orbit calculated in one go" )
+    {
+        CHECK( resumed.size() == whole.size() );
+        CHECK( resumed.x() == whole.x() );
+        CHECK( resumed.y() == whole.y() );
+    }
+
+    THEN( "the rest of it can be checkpointed too" )
+    {
+        checkpoint.storeOrbit(resumed);
+        Checkpoint again(checkpoint_path, "deep view", true, 0);
+        REQUIRE( again.loadOrbit(x, y, last_x, last_y) );
+        CHECK( x == whole.x() );
+        CHECK( y == whole.y() );
+    }
+
+    std::remove(checkpoint_path);
+}
@@ -0,0 +1,472 @@
+
+#include <cmath>
+#include <vector>
+#include "catch.hpp"
+#include "EscapeTime.h"
+
+
+// Fill cx, cy with the points of a width x height grid covering the default view
+static void makeGrid(int width, int height, std::vector<double> &cx, std::vector<double> &cy)
+{
+    const double window_startx = -1.9;
+    const double window_width = 2.5;
+    const double window_starty = 1.2;
+    const double window_height = 1.2;
+
+    cx.clear();
+    cy.clear();
+    for(int row = 0; row < height; ++row)
+    {
+        for(int col = 0; col < width; ++col)
+        {
+            cx.push_back(window_startx + col*window_width/width);
+            cy.push_back(window_starty - row*window_height/height);
+        }
+    }
+}
+
+
+SCENARIO( "the scalar kernel calculates correct escape times" )
+{
+    GIVEN( "some points with known escape times" )
+    {
+        //                          origin  c=-1  c=1  c=2  c=0.5i  c=3
+        std::vector<double> cx = {  0.0,    -1.0, 1.0, 2.0, 0.0,    3.0 };
+        std::vector<double> cy = {  0.0,     0.0, 0.0, 0.0, 0.5,    0.0 };
+        std::vector<int> iterations(cx.size());
+        std::vector<double> norm(cx.size());
+
+        escapeTimeScalar(cx.data(), cy.data(), cx.size(), 100, iterations.data(), norm.data());
+
+        THEN( "points inside the set never escape" )
+        {
+            CHECK( iterations[0] == 100 );
+            CHECK( iterations[1] == 100 );
+            CHECK( iterations[4] == 100 );
+        }
+
+        THEN( "points outside the set escape" )
+        {
+            // c=1: 2, 5, 26
+            CHECK( iterations[2] == 2 );
+            CHECK( norm[2] == 26.0*26.0 );
+            // c=2: 6, 38
+            CHECK( iterations[3] == 1 );
+            CHECK( norm[3] == 38.0*38.0 );
+            // c=3: 12, 147
+            CHECK( iterations[5] == 1 );
+            CHECK( norm[5] == 147.0*147.0 );
+        }
+    }
+}
+
+
+// The plain escape time loop, without any shortcuts
+static int bruteForceEscapeTime(double cx, double cy, int max_iterations)
+{
+    double x = cx, y = cy, temp;
+    int n;
+    for(n = 0; n < max_iterations; ++n)
+    {
+        temp = x;
+        x = x*x - y*y + cx;
+        y = 2*temp*y + cy;
+        if (x*x + y*y > escape_radius_squared)
+            break;
+    }
+    return n;
+}
+
+
+SCENARIO( "points inside the set are recognized early" )
+{
+    GIVEN( "points in the main cardioid, the period-2 bulb, and outside both" )
+    {
+        THEN( "the analytic test recognizes the cardioid and the bulb" )
+        {
+            CHECK( isInMainCardioidOrBulb( 0.0,   0.0) );
+            CHECK( isInMainCardioidOrBulb( 0.24,  0.0) );
+            CHECK( isInMainCardioidOrBulb(-0.74,  0.0) );
+            CHECK( isInMainCardioidOrBulb(-0.1,   0.6) );
+            CHECK( isInMainCardioidOrBulb(-1.0,   0.0) );
+            CHECK( isInMainCardioidOrBulb(-1.2,   0.1) );
+
+            CHECK_FALSE( isInMainCardioidOrBulb( 0.26,  0.0) );
+            CHECK_FALSE( isInMainCardioidOrBulb(-1.26,  0.0) );
+            CHECK_FALSE( isInMainCardioidOrBulb(-1.75,  0.0) );  // period-3 bulb
+            CHECK_FALSE( isInMainCardioidOrBulb(-0.12,  0.75) ); // period-3 bulb
+            CHECK_FALSE( isInMainCardioidOrBulb( 1.0,   1.0) );
+        }
+    }
+
+    GIVEN( "a grid of points over the default view" )
+    {
+        std::vector<double> cx, cy;
+        makeGrid(400, 192, cx, cy);
+        const int count = cx.size();
+        const int max_iterations = 1000;
+
+        std::vector<int> iterations(count);
+        std::vector<double> norm(count);
+        escapeTimeScalar(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+        THEN( "the escape times are the same as without the shortcuts" )
+        {
+            int mismatches = 0;
+            for(int i = 0; i < count; ++i)
+                if(iterations[i] != bruteForceEscapeTime(cx[i], cy[i], max_iterations))
+                    ++mismatches;
+
+            REQUIRE( mismatches == 0 );
+        }
+    }
+}
+
+
+SCENARIO( "the SIMD kernels match the scalar kernel exactly" )
+{
+    GIVEN( "a grid of points over the default view, with a ragged row length" )
+    {
+        std::vector<double> cx, cy;
+        makeGrid(203, 97, cx, cy);
+        const int count = cx.size();
+        const int max_iterations = 500;
+
+        std::vector<int> expected_iterations(count);
+        std::vector<double> expected_norm(count);
+        escapeTimeScalar(cx.data(), cy.data(), count, max_iterations,
+                         expected_iterations.data(), expected_norm.data());
+
+        std::vector<int> iterations(count);
+        std::vector<double> norm(count);
+
+        if(cpuSupportsAvx2())
+        {
+            escapeTimeAvx2(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+            THEN( "the AVX2 kernel gives identical results" )
+            {
+                REQUIRE( iterations == expected_iterations );
+                REQUIRE( norm == expected_norm );
+            }
+        }
+
+        if(cpuSupportsAvx512())
+        {
+            escapeTimeAvx512(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+            THEN( "the AVX-512 kernel gives identical results" )
+            {
+                REQUIRE( iterations == expected_iterations );
+                REQUIRE( norm == expected_norm );
+            }
+        }
+
+        THEN( "the selected kernel gives identical results" )
+        {
+            EscapeKernel kernel = selectEscapeKernel();
+            kernel(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+            REQUIRE( iterations == expected_iterations );
+            REQUIRE( norm == expected_norm );
+        }
+    }
+}
+
+
+// The plain escape time loop in single precision
+static int bruteForceEscapeTimeFloat(float cx, float cy, int max_iterations)
+{
+    float x = cx, y = cy, temp;
+    int n;
+    for(n = 0; n < max_iterations; ++n)
+    {
+        temp = x;
+        x = x*x - y*y + cx;
+        y = 2*temp*y + cy;
+        if (x*x + y*y > escape_radius_squared)
+            break;
+    }
+    return n;
+}
+
+
+SCENARIO( "the single precision kernels are close to the double precision ones" )
+{
+    GIVEN( "a grid of points over the default view, with a ragged row length" )
+    {
+        std::vector<double> cx, cy;
+        makeGrid(403, 193, cx, cy);
+        const int count = cx.size();
+        const int max_iterations = 1000;
+
+        std::vector<int> expected_iterations(count);
+        std::vector<double> expected_norm(count);
+        escapeTimeFloat(cx.data(), cy.data(), count, max_iterations, expected_iterations.data(), expected_norm.data());
+
+        std::vector<int> iterations(count);
+        std::vector<double> norm(count);
+
+        THEN( "the shortcuts don't change the escape times" )
+        {
+            int mismatches = 0;
+            for(int i = 0; i < count; ++i)
+                if(expected_iterations[i] != bruteForceEscapeTimeFloat(cx[i], cy[i], max_iterations))
+                    ++mismatches;
+
+            REQUIRE( mismatches == 0 );
+        }
+
+        if(cpuSupportsAvx2())
+        {
+            escapeTimeFloatAvx2(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+            THEN( "the AVX2 kernel gives identical results" )
+            {
+                REQUIRE( iterations == expected_iterations );
+                REQUIRE( norm == expected_norm );
+            }
+        }
+
+        if(cpuSupportsAvx512())
+        {
+            escapeTimeFloatAvx512(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+            THEN( "the AVX-512 kernel gives identical results" )
+            {
+                REQUIRE( iterations == expected_iterations );
+                REQUIRE( norm == expected_norm );
+            }
+        }
+
+        THEN( "only a few pixels on the edge of the set differ from double precision" )
+        {
+            escapeTimeScalar(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+            int different = 0, inside_or_outside = 0;
+            for(int i = 0; i < count; ++i)
+            {
+                if(iterations[i] != expected_iterations[i])
+                    ++different;
+                if((iterations[i] == max_iterations) != (expected_iterations[i] == max_iterations))
+                    ++inside_or_outside;
+            }
+
+            CHECK( different < count/100 );
+            CHECK( inside_or_outside < count/1000 );
+        }
+    }
+}
+
+
+SCENARIO( "the precision is chosen from the pixel spacing" )
+{
+    THEN( "shallow views are calculated in single precision" )
+    {
+        CHECK( selectPrecision(2.5/2000) == Precision::float32 );
+        CHECK( selectPrecision(1e-3) == Precision::float32 );
+    }
+
+    THEN( "deeper views in double precision" )
+    {
+        CHECK( selectPrecision(2.5/20000) == Precision::float64 );
+        CHECK( selectPrecision(1e-11) == Precision::float64 );
+    }
+
+    THEN( "and beyond that in the wider types" )
+    {
+        CHECK( selectPrecision(1e-13) == Precision::extended );
+        CHECK( selectPrecision(1e-30) == Precision::extended );
+    }
+}
+
+
+SCENARIO( "the distance estimate comes with the same escape times" )
+{
+    GIVEN( "points along the real axis beyond the tip of the set at -2" )
+    {
+        // The nearest point of the set is the tip itself
+        const double offsets[] = {0.001, 0.01, 0.1};
+        std::vector<double> cx, cy(3, 0.0);
+        for(double offset : offsets)
+            cx.push_back(-2 - offset);
+        std::vector<int> iterations(3);
+        std::vector<double> norm(3), distance(3);
+        escapeTimeWithDistance(cx.data(), cy.data(), 3, 1000, iterations.data(), norm.data(), distance.data());
+
+        THEN( "the estimate is within a factor of two of the distance" )
+        {
+            for(int i = 0; i < 3; ++i)
+            {
+                CHECK( distance[i] >= offsets[i]/2 );
+                // Right at the tip the estimate is twice the distance, and
+                // the finite escape radius adds a little
+                CHECK( distance[i] <= 2.01*offsets[i] );
+            }
+        }
+    }
+
+    GIVEN( "the grid over the default view" )
+    {
+        std::vector<double> cx, cy;
+        makeGrid(200, 100, cx, cy);
+        const int count = cx.size();
+        const int max_iterations = 500;
+
+        std::vector<int> iterations(count), distance_iterations(count);
+        std::vector<double> norm(count), distance_norm(count), distance(count);
+        escapeTimeScalar(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+        escapeTimeWithDistance(cx.data(), cy.data(), count, max_iterations, distance_iterations.data(),
+                               distance_norm.data(), distance.data());
+
+        THEN( "the escape times are exactly those of the scalar kernel" )
+        {
+            CHECK( distance_iterations == iterations );
+            CHECK( distance_norm == norm );
+        }
+
+        THEN( "only the points that don't escape are at distance 0" )
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                if(iterations[i] == max_iterations)
+                    REQUIRE( distance[i] == 0 );
+                else
+                    REQUIRE( distance[i] > 0 );
+            }
+        }
+
+        THEN( "double-double gives the same estimates" )
+        {
+            std::vector<DoubleDouble> dcx(cx.begin(), cx.end()), dcy(cy.begin(), cy.end());
+            std::vector<int> wide_iterations(count);
+            std::vector<double> wide_norm(count), wide_distance(count);
+            escapeTimeWithDistance(dcx.data(), dcy.data(), count, max_iterations, wide_iterations.data(),
+                                   wide_norm.data(), wide_distance.data());
+            int different = 0;
+            for(int i = 0; i < count; ++i)
+                different += wide_iterations[i] != iterations[i] ||
+                             std::fabs(wide_distance[i] - distance[i]) > 1e-6*distance[i];
+            CHECK( different < count/100 );
+        }
+    }
+}
+
+
+SCENARIO( "the escape time loop is specialized for fractal families" )
+{
+    GIVEN( "the grid over the default view" )
+    {
+        std::vector<double> cx, cy;
+        makeGrid(200, 100, cx, cy);
+        const int count = cx.size();
+        const int max_iterations = 500;
+        std::vector<int> iterations(count), family_iterations(count);
+        std::vector<double> norm(count), family_norm(count);
+        escapeTimeScalar(cx.data(), cy.data(), count, max_iterations, iterations.data(), norm.data());
+
+        WHEN( "the Mandelbrot policy is iterated" )
+        {
+            escapeTime(Mandelbrot(), cx.data(), cy.data(), count, max_iterations, family_iterations.data(),
+                       family_norm.data());
+
+            THEN( "it is the scalar kernel" )
+            {
+                CHECK( family_iterations == iterations );
+                CHECK( family_norm == norm );
+            }
+        }
+
+        WHEN( "the multibrot of degree 2 is iterated" )
+        {
+            escapeTime(Multibrot<2>(), cx.data(), cy.data(), count, max_iterations, family_iterations.data(),
+                       family_norm.data());
+
+            THEN( "it is the Mandelbrot set without the cardioid test" )
+            {
+                CHECK( family_iterations == iterations );
+                for(int i = 0; i < count; ++i)
+                    if(iterations[i] < max_iterations)
+                        REQUIRE( family_norm[i] == norm[i] );
+            }
+        }
+
+        WHEN( "the burning ship is iterated" )
+        {
+            escapeTime(BurningShip(), cx.data(), cy.data(), count, max_iterations, family_iterations.data(),
+                       family_norm.data());
+
+            THEN( "it is a different set" )
+            {
+                CHECK( family_iterations != iterations );
+            }
+
+            THEN( "it matches the Mandelbrot set on the real axis, where y stays 0" )
+            {
+                std::vector<double> axis_x, axis_y(200, 0.0);
+                for(int i = 0; i < 200; ++i)
+                    axis_x.push_back(-2.5 + i*0.015625);
+                std::vector<int> axis_iterations(200), ship_iterations(200);
+                std::vector<double> axis_norm(200), ship_norm(200);
+                escapeTimeScalar(axis_x.data(), axis_y.data(), 200, max_iterations, axis_iterations.data(),
+                                 axis_norm.data());
+                escapeTime(BurningShip(), axis_x.data(), axis_y.data(), 200, max_iterations,
+                           ship_iterations.data(), ship_norm.data());
+                CHECK( ship_iterations == axis_iterations );
+            }
+        }
+    }
+
+    GIVEN( "points with known escape times" )
+    {
+        std::vector<int> iterations(2);
+        std::vector<double> norm(2);
+
+        THEN( "the cubic multibrot takes c=1 through 1, 2, 9, 730" )
+        {
+            const double cx[] = {1.0, 0.0}, cy[] = {0.0, 0.0};
+            escapeTime(Multibrot<3>(), cx, cy, 2, 100, iterations.data(), norm.data());
+            CHECK( iterations[0] == 2 );
+            CHECK( norm[0] == 730.0*730.0 );
+            CHECK( iterations[1] == 100 );
+        }
+
+        THEN( "the Julia set of c=0 is the unit disk" )
+        {
+            // z=2: 4, 16, 256
+            const double px[] = {2.0, 0.5}, py[] = {0.0, 0.5};
+            escapeTime(Julia(0, 0), px, py, 2, 100, iterations.data(), norm.data());
+            CHECK( iterations[0] == 2 );
+            CHECK( norm[0] == 256.0*256.0 );
+            CHECK( iterations[1] == 100 );
+        }
+
+        THEN( "the burning ship takes c=i, which is in the Mandelbrot set, out through -1+i, 3i, -9+i, 80+19i" )
+        {
+            const double cx[] = {0.0}, cy[] = {1.0};
+            escapeTime(BurningShip(), cx, cy, 1, 100, iterations.data(), norm.data());
+            CHECK( iterations[0] == 3 );
+            CHECK( norm[0] == 80.0*80.0 + 19.0*19.0 );
+        }
+    }
+
+    GIVEN( "double-double points" )
+    {
+        std::vector<double> cx, cy;
+        makeGrid(40, 20, cx, cy);
+        std::vector<DoubleDouble> dcx(cx.begin(), cx.end()), dcy(cy.begin(), cy.end());
+        std::vector<int> iterations(cx.size()), wide_iterations(cx.size());
+        std::vector<double> norm(cx.size()), wide_norm(cx.size());
+        escapeTime(Multibrot<4>(), cx.data(), cy.data(), cx.size(), 200, iterations.data(), norm.data());
+        escapeTime(Multibrot<4>(), dcx.data(), dcy.data(), cx.size(), 200, wide_iterations.data(),
+                   wide_norm.data());
+
+        THEN( "the families work with them too" )
+        {
+            int different = 0;
+            for(std::size_t i = 0; i < cx.size(); ++i)
+                different += wide_iterations[i] != iterations[i];
+            CHECK( different < static_cast<int>(cx.size())/50 );
+        }
+    }
+}
@@ -0,0 +1,87 @@
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "catch.hpp"
+#include "EscapeTime.h"
+#include "ExpMap.h"
+#include "Palette.h"
+#include "ThreadPool.h"
+
+
+namespace
+{
+    void calculate(const double *cx, const double *cy, int count, int max_iterations, int *iterations, double *norm)
+    {
+        escapeTimeScalar(cx, cy, count, max_iterations, iterations, norm);
+    }
+}
+
+
+SCENARIO( "zoom frames are resampled from a log-polar strip" )
+{
+    const int width = 48, height = 32;
+    const int max_iterations = 200;
+    const double center_x = 0.4, center_y = 0.45;
+    const double first_spacing = 0.01, last_spacing = 0.0001;
+
+    ThreadPool pool(3);
+    const int columns = ExpMapStrip::columnsFor(width, height);
+    ExpMapStrip strip(center_x, center_y, first_spacing*std::hypot(width, height)/2, last_spacing/2, columns);
+
+    THEN( "the columns go around the center, and the rows shrink towards it" )
+    {
+        double cx, cy;
+        strip.point(0, 0, cx, cy);
+        CHECK( cx == Approx(center_x + first_spacing*std::hypot(width, height)/2) );
+        CHECK( cy == Approx(center_y) );
+
+        strip.point(columns/4.0, columns/(2*M_PI) * std::log(2.0), cx, cy);
+        CHECK( cx == Approx(center_x) );
+        CHECK( cy == Approx(center_y + first_spacing*std::hypot(width, height)/4) );
+
+        // Down to half a pixel of the last frame
+        strip.point(0, strip.rows() - 1, cx, cy);
+        CHECK( cx - center_x <= last_spacing/2 );
+    }
+
+    GIVEN( "the rendered and colored strip" )
+    {
+        const Palette palette = Palette::standard(max_iterations);
+        strip.render(pool, 64, max_iterations, calculate);
+        strip.colorize(palette);
+
+        THEN( "frames along the zoom look like frames rendered directly" )
+        {
+            for(double spacing = first_spacing; spacing >= last_spacing; spacing /= 10)
+            {
+                std::vector<unsigned char> resampled(3*width*height);
+                strip.renderFrame(spacing, width, height, pool, resampled.data());
+
+                std::vector<double> cx, cy;
+                for(int row = 0; row < height; ++row)
+                {
+                    for(int col = 0; col < width; ++col)
+                    {
+                        cx.push_back(center_x + (col - width/2.0)*spacing);
+                        cy.push_back(center_y + (height/2.0 - row)*spacing);
+                    }
+                }
+                std::vector<int> iterations(width*height);
+                std::vector<double> norm(width*height);
+                calculate(cx.data(), cy.data(), width*height, max_iterations, iterations.data(), norm.data());
+                std::vector<float> smooth(width*height);
+                for(int k = 0; k < width*height; ++k)
+                    smooth[k] = smoothIterations(iterations[k], norm[k], max_iterations);
+                std::vector<unsigned char> direct(3*width*height);
+                colorize(smooth.data(), width*height, palette, direct.data());
+
+                double difference = 0;
+                for(int k = 0; k < 3*width*height; ++k)
+                    difference += std::abs(resampled[k] - direct[k]);
+                INFO( "spacing " << spacing );
+                CHECK( difference / (3*width*height) < 2.0 );
+            }
+        }
+    }
+}
@@ -0,0 +1,221 @@
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "catch.hpp"
+#include "ImageWriter.h"
+#include "ThreadPool.h"
+#include "tests-Png.h"
+
+
+// A test pattern, in BGR
+static std::vector<unsigned char> makePattern(int width, int height)
+{
+    std::vector<unsigned char> bgr(3*width*height);
+    for(int row = 0; row < height; ++row)
+    {
+        for(int col = 0; col < width; ++col)
+        {
+            unsigned char *pixel = &bgr[3*(row*width + col)];
+            pixel[0] = col*7 + row;
+            pixel[1] = row*13;
+            pixel[2] = (col*col + row) % 251;
+        }
+    }
+    return bgr;
+}
+
+
+// Write an image in bands of the given height
+static void writeInBands(ImageWriter &writer, const std::vector<unsigned char> &bgr, int width, int height, int band)
+{
+    for(int row = 0; row < height; row += band)
+        writer.writeBand(&bgr[3*row*width], std::min(band, height - row));
+    writer.finish();
+}
+
+
+static std::uint64_t littleEndian(const unsigned char *p, int bytes)
+{
+    std::uint64_t value = 0;
+    for(int k = bytes; k-- > 0; )
+        value = (value << 8) | p[k];
+    return value;
+}
+
+
+// Decode a tiled, deflate compressed RGB TIFF or BigTIFF as written by TiffWriter
+static std::vector<unsigned char> decodeTiff(const std::vector<unsigned char> &file, bool &big, int &width, int &height)
+{
+    REQUIRE( file[0] == 'I' );
+    big = littleEndian(&file[2], 2) == 43;
+    const int offset_size = big ? 8 : 4;
+    const int entry_size = big ? 20 : 12;
+
+    std::uint64_t position = littleEndian(&file[big ? 8 : 4], offset_size);
+    const std::uint64_t entries = littleEndian(&file[position], big ? 8 : 2);
+    position += big ? 8 : 2;
+
+    int tile_size = 0;
+    std::uint64_t tile_count = 0, offsets = 0, counts = 0;
+    for(std::uint64_t e = 0; e < entries; ++e)
+    {
+        const unsigned char *entry = &file[position + e*entry_size];
+        const int tag = littleEndian(entry, 2);
+        const int type = littleEndian(entry + 2, 2);
+        const std::uint64_t count = littleEndian(entry + 4, offset_size);
+        const std::uint64_t value = littleEndian(entry + 4 + offset_size, type == 3 && count == 1 ? 2 : offset_size);
+        switch(tag)
+        {
+            case 256: width = value; break;
+            case 257: height = value; break;
+            case 259: CHECK( value == 8 ); break;
+            case 322: tile_size = value; break;
+            case 324: tile_count = count; offsets = value; break;
+            case 325: counts = value; break;
+        }
+    }
+
+    const int tiles_across = (width + tile_size - 1) / tile_size;
+    REQUIRE( tile_count == static_cast<std::uint64_t>(tiles_across*((height + tile_size - 1) / tile_size)) );
+
+    std::vector<unsigned char> rgb(3*width*height);
+    for(std::uint64_t t = 0; t < tile_count; ++t)
+    {
+        const std::uint64_t tile_offset = tile_count == 1 ? offsets : littleEndian(&file[offsets + t*offset_size], offset_size);
+        const std::uint64_t tile_bytes = tile_count == 1 ? counts : littleEndian(&file[counts + t*offset_size], offset_size);
+        std::vector<unsigned char> tile = inflateAll(&file[tile_offset], tile_bytes, 3*tile_size*tile_size);
+
+        const int x0 = (t % tiles_across)*tile_size;
+        const int y0 = (t / tiles_across)*tile_size;
+        for(int y = 0; y < tile_size && y0 + y < height; ++y)
+            for(int x = 0; x < tile_size && x0 + x < width; ++x)
+                for(int c = 0; c < 3; ++c)
+                    rgb[3*((y0 + y)*width + x0 + x) + c] = tile[3*(y*tile_size + x) + c];
+    }
+    return rgb;
+}
+
+
+static bool sameImage(const std::vector<unsigned char> &bgr, const std::vector<unsigned char> &rgb)
+{
+    for(std::size_t i = 0; i < bgr.size(); i += 3)
+        if(bgr[i] != rgb[i + 2] || bgr[i + 1] != rgb[i + 1] || bgr[i + 2] != rgb[i])
+            return false;
+    return bgr.size() == rgb.size();
+}
+
+
+SCENARIO( "images are written band by band" )
+{
+    const int width = 101, height = 70;
+    std::vector<unsigned char> bgr = makePattern(width, height);
+
+    GIVEN( "a PNG written in bands of 100 rows" )
+    {
+        // More rows than PngWriter::rows_per_piece, so that bands are split
+        const int tall_height = 300;
+        std::vector<unsigned char> tall = makePattern(width, tall_height);
+        const std::string path = "test-image-writer.png";
+        {
+            PngWriter writer(path, width, tall_height);
+            writeInBands(writer, tall, width, tall_height, 100);
+        }
+        std::vector<unsigned char> file = readFile(path);
+
+        THEN( "it decodes to the same image" )
+        {
+            int decoded_width = 0, decoded_height = 0;
+            std::vector<unsigned char> rgb = decodePng(file, decoded_width, decoded_height);
+            CHECK( decoded_width == width );
+            CHECK( decoded_height == tall_height );
+            CHECK( sameImage(tall, rgb) );
+        }
+
+        THEN( "compressing on a thread pool gives the same file" )
+        {
+            ThreadPool pool(4);
+            {
+                PngWriter writer(path, width, tall_height, 6, &pool);
+                writeInBands(writer, tall, width, tall_height, 100);
+            }
+            CHECK( readFile(path) == file );
+        }
+
+        THEN( "encoding in the background gives the same file" )
+        {
+            {
+                BackgroundWriter writer(std::unique_ptr<ImageWriter>(new PngWriter(path, width, tall_height)), 1);
+                writeInBands(writer, tall, width, tall_height, 100);
+            }
+            CHECK( readFile(path) == file );
+        }
+        std::remove(path.c_str());
+    }
+
+    for(bool big_tiff : {false, true})
+    {
+        GIVEN( std::string("a tiled ") + (big_tiff ? "BigTIFF" : "TIFF") + " written in bands of 7 rows" )
+        {
+            const std::string path = "test-image-writer.tiff";
+            ThreadPool pool(3);
+            {
+                TiffWriter writer(path, width, height, 32, 6, big_tiff, &pool);
+                writeInBands(writer, bgr, width, height, 7);
+            }
+
+            THEN( "it decodes to the same image" )
+            {
+                bool big = false;
+                int decoded_width = 0, decoded_height = 0;
+                std::vector<unsigned char> rgb = decodeTiff(readFile(path), big, decoded_width, decoded_height);
+                CHECK( big == big_tiff );
+                CHECK( decoded_width == width );
+                CHECK( decoded_height == height );
+                CHECK( sameImage(bgr, rgb) );
+            }
+            std::remove(path.c_str());
+        }
+    }
+
+    GIVEN( "a writer that doesn't get all the rows" )
+    {
+        const std::string path = "test-image-writer.png";
+        PngWriter writer(path, width, height);
+        writer.writeBand(bgr.data(), 10);
+
+        THEN( "finishing it fails" )
+        {
+            CHECK_THROWS_AS( writer.finish(), std::runtime_error );
+        }
+        std::remove(path.c_str());
+    }
+
+    GIVEN( "a background writer whose encoder fails" )
+    {
+        const std::string path = "test-image-writer.png";
+        BackgroundWriter writer(std::unique_ptr<ImageWriter>(new PngWriter(path, width, 10)), 1);
+
+        THEN( "the error comes out of a later call" )
+        {
+            // Depending on the timing, that is either writeBand() or finish()
+            auto writeTooManyRows = [&]
+            {
+                for(int band = 0; band < 3; ++band)
+                    writer.writeBand(bgr.data(), 10);
+                writer.finish();
+            };
+            CHECK_THROWS_AS( writeTooManyRows(), std::runtime_error );
+        }
+        std::remove(path.c_str());
+    }
+
+    THEN( "unknown formats are rejected" )
+    {
+        CHECK_THROWS_AS( openImageWriter("image.bmp", width, height), std::invalid_argument );
+    }
+}
@@ -0,0 +1,125 @@
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "catch.hpp"
+#include "EscapeTime.h"
+#include "IterationBudget.h"
+
+
+// The estimate for a 400 x 300 view of the given width, centered on (center_x, center_y)
+static int estimateView(ThreadPool &pool, double center_x, double center_y, double view_width, double threshold)
+{
+    const int width = 400, height = 300;
+    auto calculate = [&](const double *x, const double *y, int count, int max_iterations,
+                         int *iterations, double *norm)
+    {
+        std::vector<double> cx(count), cy(count);
+        for(int i = 0; i < count; ++i)
+        {
+            cx[i] = center_x + (x[i] - width/2.0)*view_width/width;
+            cy[i] = center_y + (height/2.0 - y[i])*view_width/width;
+        }
+        escapeTimeScalar(cx.data(), cy.data(), count, max_iterations, iterations, norm);
+    };
+    return estimateMaxIterations(pool, width, height, calculate, threshold, 1 << 20);
+}
+
+
+SCENARIO( "the iteration budget is estimated from the escapes of the view" )
+{
+    ThreadPool pool(2);
+
+    GIVEN( "pixels that escape after as many iterations as their column number" )
+    {
+        // Columns 0 to 999 of a single row; 1 in 4 columns never escapes
+        const int width = 1000;
+        std::atomic<int> largest_budget(0);
+        std::atomic<int> iterated_again(0);
+        auto calculate = [&](const double *x, const double *, int count, int max_iterations,
+                             int *iterations, double *norm)
+        {
+            int largest = largest_budget;
+            while(max_iterations > largest && !largest_budget.compare_exchange_weak(largest, max_iterations))
+                ;
+            for(int i = 0; i < count; ++i)
+            {
+                const int col = x[i];
+                if(max_iterations > first_iteration_budget && col % 4 != 0 && col < max_iterations/2)
+                    ++iterated_again;
+                iterations[i] = col % 4 == 0 ? max_iterations : std::min(col, max_iterations);
+                norm[i] = 0;
+            }
+        };
+
+        WHEN( "the threshold is low" )
+        {
+            const int budget = estimateMaxIterations(pool, width, 1, calculate, 0.001, 1 << 20);
+
+            THEN( "the budget is the first one after which a doubling makes no difference" )
+            {
+                CHECK( budget == 1024 );
+                CHECK( largest_budget == 2048 );
+            }
+
+            THEN( "pixels that escaped aren't iterated again" )
+            {
+                CHECK( iterated_again == 0 );
+            }
+        }
+
+        WHEN( "the threshold is high" )
+        {
+            // From 64 to 128 iterations, about 6 of the 122 probes left escape
+            const int budget = estimateMaxIterations(pool, width, 1, calculate, 0.1, 1 << 20);
+
+            THEN( "the budget stops being raised earlier" )
+            {
+                CHECK( budget == 64 );
+            }
+        }
+
+        WHEN( "the limit is low" )
+        {
+            const int budget = estimateMaxIterations(pool, width, 1, calculate, 0.001, 300);
+
+            THEN( "the budget stops at the limit" )
+            {
+                CHECK( budget == 300 );
+                CHECK( largest_budget == 300 );
+            }
+        }
+    }
+
+    GIVEN( "pixels that all escape late" )
+    {
+        auto calculate = [](const double *, const double *, int count, int max_iterations,
+                            int *iterations, double *norm)
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                iterations[i] = std::min(5000, max_iterations);
+                norm[i] = 0;
+            }
+        };
+        const int budget = estimateMaxIterations(pool, 100, 100, calculate, 0.01, 1 << 20);
+
+        THEN( "they aren't taken for the inside of the set" )
+        {
+            CHECK( budget == 8192 );
+        }
+    }
+
+    GIVEN( "views of the Mandelbrot set" )
+    {
+        const int full_set = estimateView(pool, -0.65, 0, 2.5, 0.01);
+        const int seahorse_valley = estimateView(pool, -0.7453, 0.1127, 0.0065, 0.01);
+
+        THEN( "deeper views get larger budgets" )
+        {
+            CHECK( full_set >= first_iteration_budget );
+            CHECK( full_set <= 1024 );
+            CHECK( seahorse_valley > full_set );
+        }
+    }
+}
@@ -0,0 +1,65 @@
+
+#include <vector>
+#include "catch.hpp"
+#include "EscapeTime.h"
+#include "MarianiSilver.h"
+
+
+SCENARIO( "Mariani-Silver subdivision skips uniform regions" )
+{
+    // The default view, at a lower resolution
+    const int image_width = 500, image_height = 240, max_iterations = 1000;
+    auto calculateRow = [&](int row, int col, int count, int *iterations, double *norm)
+    {
+        std::vector<double> cx(count), cy(count);
+        for(int i = 0; i < count; ++i)
+        {
+            cx[i] = -1.9 + (col + i)*2.5/image_width;
+            cy[i] = 1.2 - row*1.2/image_height;
+        }
+        escapeTimeScalar(cx.data(), cy.data(), count, max_iterations, iterations, norm);
+    };
+
+    GIVEN( "a tile inside the main cardioid" )
+    {
+        // From c = -0.4 + 0.3i to c = -0.2 + 0.15i
+        Tile tile = {300, 180, 40, 30};
+        std::vector<int> iterations(tile.width*tile.height);
+        std::vector<double> norm(tile.width*tile.height);
+        const int calculated = marianiSilver(tile, calculateRow, iterations.data(), norm.data());
+
+        THEN( "only the border is calculated" )
+        {
+            CHECK( calculated == 2*tile.width + 2*(tile.height - 2) );
+            for(int n : iterations)
+                REQUIRE( n == max_iterations );
+        }
+    }
+
+    GIVEN( "the whole view in tiles" )
+    {
+        int calculated = 0, mismatches = 0;
+        for(const Tile &tile : makeTiles(image_width, image_height, 64))
+        {
+            std::vector<int> iterations(tile.width*tile.height), expected(tile.width*tile.height);
+            std::vector<double> norm(tile.width*tile.height);
+            calculated += marianiSilver(tile, calculateRow, iterations.data(), norm.data());
+            for(int row = 0; row < tile.height; ++row)
+                calculateRow(tile.y + row, tile.x, tile.width, &expected[row*tile.width], &norm[row*tile.width]);
+
+            for(std::size_t i = 0; i < iterations.size(); ++i)
+                if(iterations[i] != expected[i])
+                    ++mismatches;
+        }
+
+        THEN( "far fewer pixels are calculated" )
+        {
+            CHECK( calculated < image_width*image_height / 2 );
+        }
+
+        THEN( "nearly all of the escape times are right" )
+        {
+            CHECK( mismatches < image_width*image_height / 200 );
+        }
+    }
+}
@@ -0,0 +1,185 @@
+
+#include <cmath>
+#include <vector>
+#include "catch.hpp"
+#include "BigFixed.h"
+#include "EscapeTime.h"
+#include "MultiDouble.h"
+#include "tests-BigEscapeTime.h"
+
+
+// The value of a double-double or quad-double, in arbitrary precision
+static BigFixed toBigFixed(const DoubleDouble &x, int limbs)
+{
+    return BigFixed(x.hi(), 0, limbs) + BigFixed(x.lo(), 0, limbs);
+}
+
+static BigFixed toBigFixed(const QuadDouble &x, int limbs)
+{
+    return BigFixed(x[0], 0, limbs) + BigFixed(x[1], 0, limbs) + BigFixed(x[2], 0, limbs) + BigFixed(x[3], 0, limbs);
+}
+
+// |a - b| / 2^exponent
+static double scaledError(const BigFixed &a, const BigFixed &b, int exponent)
+{
+    return std::fabs((a - b).toDouble()) / std::ldexp(1.0, exponent);
+}
+
+
+SCENARIO( "error-free transformations are exact" )
+{
+    double err;
+    const double s = twoSum(1.0, 1e-20, err);
+    CHECK( s == 1.0 );
+    CHECK( err == 1e-20 );
+
+    const double p = twoProd(1.0 + std::ldexp(1.0, -30), 1.0 + std::ldexp(1.0, -30), err);
+    CHECK( p == 1.0 + std::ldexp(1.0, -29) );
+    CHECK( err == std::ldexp(1.0, -60) );
+}
+
+
+SCENARIO( "double-double and quad-double arithmetic is accurate" )
+{
+    const int limbs = 16;
+    const char *a_text = "-0.743643887037158704752191506114774";
+    const char *b_text = "0.131825904205311970493132056385139";
+    BigFixed a = BigFixed::fromString(a_text, limbs);
+    BigFixed b = BigFixed::fromString(b_text, limbs);
+
+    GIVEN( "double-double numbers" )
+    {
+        DoubleDouble x = DoubleDouble::fromString(a_text);
+        DoubleDouble y = DoubleDouble::fromString(b_text);
+
+        THEN( "they hold about 106 bits of the parsed values" )
+        {
+            CHECK( scaledError(toBigFixed(x, limbs), a, -104) < 1 );
+            CHECK( scaledError(toBigFixed(y, limbs), b, -104) < 1 );
+        }
+
+        THEN( "the arithmetic keeps that precision" )
+        {
+            CHECK( scaledError(toBigFixed(x + y, limbs), a + b, -103) < 1 );
+            CHECK( scaledError(toBigFixed(x - y, limbs), a - b, -103) < 1 );
+            CHECK( scaledError(toBigFixed(x * y, limbs), a * b, -103) < 1 );
+            CHECK( scaledError(toBigFixed((x * y) / y, limbs), a, -102) < 1 );
+        }
+
+        THEN( "comparisons look past the leading double" )
+        {
+            DoubleDouble z = x + std::ldexp(1.0, -90);
+            CHECK( z.hi() == x.hi() );
+            CHECK( x < z );
+            CHECK( fabs(z) < fabs(-x) );
+        }
+    }
+
+    GIVEN( "quad-double numbers" )
+    {
+        QuadDouble x = QuadDouble::fromString(a_text);
+        QuadDouble y = QuadDouble::fromString(b_text);
+
+        THEN( "they hold the parsed values to far beyond double-double precision" )
+        {
+            CHECK( scaledError(toBigFixed(x, limbs), a, -200) < 1 );
+            CHECK( scaledError(toBigFixed(y, limbs), b, -200) < 1 );
+        }
+
+        THEN( "the arithmetic keeps that precision" )
+        {
+            CHECK( scaledError(toBigFixed(x + y, limbs), a + b, -200) < 1 );
+            CHECK( scaledError(toBigFixed(x - y, limbs), a - b, -200) < 1 );
+            CHECK( scaledError(toBigFixed(x * y, limbs), a * b, -200) < 1 );
+            CHECK( scaledError(toBigFixed(x * 3.0, limbs), a * BigFixed(3.0, 0, limbs), -200) < 1 );
+            CHECK( scaledError(toBigFixed((x * y) / y, limbs), a, -198) < 1 );
+        }
+    }
+}
+
+
+SCENARIO( "the wider number types calculate correct escape times where double can't" )
+{
+    // A zoom into the Seahorse valley, with pixels 1e-25 apart
+    const int limbs = 8;
+    const int size = 6, max_iterations = 3000;
+    const char *center_x = "-0.743643887037158704752191506114774";
+    const char *center_y = "0.131825904205311970493132056385139";
+    const char *spacing = "1e-25";
+
+    BigFixed big_x = BigFixed::fromString(center_x, limbs);
+    BigFixed big_y = BigFixed::fromString(center_y, limbs);
+    BigFixed big_spacing = BigFixed::fromString(spacing, limbs);
+
+    std::vector<int> expected;
+    for(int row = 0; row < size; ++row)
+    {
+        for(int col = 0; col < size; ++col)
+        {
+            BigFixed cx = big_x + big_spacing*BigFixed(col - size/2, 0, limbs);
+            BigFixed cy = big_y + big_spacing*BigFixed(size/2 - row, 0, limbs);
+            expected.push_back(bigEscapeTime(cx, cy, max_iterations));
+        }
+    }
+
+    GIVEN( "double-double points" )
+    {
+        const DoubleDouble x = DoubleDouble::fromString(center_x);
+        const DoubleDouble y = DoubleDouble::fromString(center_y);
+        const DoubleDouble d = DoubleDouble::fromString(spacing);
+
+        std::vector<DoubleDouble> cx, cy;
+        for(int row = 0; row < size; ++row)
+        {
+            for(int col = 0; col < size; ++col)
+            {
+                cx.push_back(x + d*(col - size/2));
+                cy.push_back(y + d*(size/2 - row));
+            }
+        }
+
+        std::vector<int> iterations(cx.size());
+        std::vector<double> norm(cx.size());
+        escapeTime(cx.data(), cy.data(), cx.size(), max_iterations, iterations.data(), norm.data());
+
+        THEN( "the escape times match arbitrary precision iteration" )
+        {
+            REQUIRE( iterations == expected );
+        }
+    }
+
+    GIVEN( "quad-double points" )
+    {
+        const QuadDouble x = QuadDouble::fromString(center_x);
+        const QuadDouble y = QuadDouble::fromString(center_y);
+        const QuadDouble d = QuadDouble::fromString(spacing);
+
+        std::vector<QuadDouble> cx, cy;
+        for(int row = 0; row < size; ++row)
+        {
+            for(int col = 0; col < size; ++col)
+            {
+                cx.push_back(x + d*(col - size/2));
+                cy.push_back(y + d*(size/2 - row));
+            }
+        }
+
+        std::vector<int> iterations(cx.size());
+        std::vector<double> norm(cx.size());
+        escapeTime(cx.data(), cy.data(), cx.size(), max_iterations, iterations.data(), norm.data());
+
+        THEN( "the escape times match arbitrary precision iteration" )
+        {
+            REQUIRE( iterations == expected );
+        }
+    }
+
+    GIVEN( "double points" )
+    {
+        THEN( "the pixels can't even be told apart" )
+        {
+            const double x = std::stod(center_x);
+            CHECK( x + 1e-25 == x );
+        }
+    }
+}
@@ -0,0 +1,175 @@
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "Options.h"
+
+
+SCENARIO( "render settings come from the command line" )
+{
+    RenderOptions options;
+
+    GIVEN( "no options" )
+    {
+        parseOptions({}, options);
+
+        THEN( "the defaults render the whole set" )
+        {
+            CHECK( options.max_iterations == 1000 );
+            CHECK( options.window_startx == "-1.9" );
+            CHECK( options.image_width == 2000 );
+            CHECK( options.output_file == "mandelbrot.png" );
+            CHECK( !options.antialias );
+        }
+    }
+
+    GIVEN( "options named after the settings" )
+    {
+        parseOptions({"--window-startx", "-0.75", "--window-width", "0.01", "--image-width", "640",
+                      "--max-iterations", "5000", "--antialias", "--pyramid-layout", "xyz",
+                      "--cache-max-bytes", "1e9", "--output-file", "view.png"}, options);
+
+        THEN( "they set them, and leave the rest alone" )
+        {
+            CHECK( options.window_startx == "-0.75" );
+            CHECK( options.window_width == "0.01" );
+            CHECK( options.window_starty == "1.2" );
+            CHECK( options.image_width == 640 );
+            CHECK( options.max_iterations == 5000 );
+            CHECK( options.antialias );
+            CHECK( options.pyramid_layout == PyramidLayout::xyz );
+            CHECK( options.cache_max_bytes == 1000000000u );
+            CHECK( options.output_file == "view.png" );
+        }
+    }
+
+    THEN( "mistakes are reported" )
+    {
+        CHECK_THROWS_AS( parseOptions({"--image-wdith", "640"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--image-width"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--image-width", "64O"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--image-width", "-640"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--max-iterations", "0"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--window-width", "x"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--pyramid-layout", "tms"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--buddhabrot", "--max-iterations", "20"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--distance-shading", "--mariani-silver"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--fractal", "tricorn"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--multibrot-degree", "2"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--interactive", "--deep-zoom"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--resume"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--recolor-only"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--deep-center-x", "-0.74.3"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--deep-width", "1e99999999999"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--deep-width", "1e-100000000"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--deep-center-x", "1e2147483647"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--deep-center-x", "0." + std::string(5000, '0') + "1"}, options),
+                         std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--deep-width", "0"}, options), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--deep-width", "-1e-40"}, options), std::invalid_argument );
+    }
+
+    THEN( "bad values name the option as it is given" )
+    {
+        const std::vector<std::vector<std::string>> mistakes = {
+            {"--max-iterations", "lots", "Bad value for --max-iterations: lots"},
+            {"--zoom-factor", "x", "Bad value for --zoom-factor: x"},
+            {"--window-startx", "1.2.3", "Bad value for --window-startx: 1.2.3"},
+            {"--window-startx", "1e400", "Bad value for --window-startx: 1e400"}};
+        for(const std::vector<std::string> &mistake : mistakes)
+        {
+            RenderOptions fresh;
+            try
+            {
+                parseOptions({mistake[0], mistake[1]}, fresh);
+                FAIL( "no error for " << mistake[0] << " " << mistake[1] );
+            }
+            catch(const std::invalid_argument &error)
+            {
+                CHECK( std::string(error.what()) == mistake[2] );
+            }
+        }
+    }
+
+    THEN( "zoom animations reject the options they can't honour" )
+    {
+        RenderOptions antialiased, single, deep, plain;
+        CHECK_THROWS_AS( parseOptions({"--zoom-frames", "10", "--antialias"}, antialiased), std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--zoom-frames", "10", "--precision", "float"}, single),
+                         std::invalid_argument );
+        CHECK_THROWS_AS( parseOptions({"--zoom-frames", "2000", "--zoom-factor", "0.9"}, deep),
+                         std::invalid_argument );
+        CHECK_NOTHROW( parseOptions({"--zoom-frames", "100", "--precision", "double"}, plain) );
+    }
+
+    THEN( "deep zooms can go beyond the range of a double" )
+    {
+        parseOptions({"--deep-zoom", "--deep-width", "2.5e-1000", "--deep-center-x", "0.00012e-3996"}, options);
+        CHECK( options.deep_width == "2.5e-1000" );
+        CHECK( options.deep_center_x == "0.00012e-3996" );
+    }
+}
+
+
+SCENARIO( "job files hold one render per line" )
+{
+    const std::string path = "test-jobs.txt";
+    RenderOptions defaults;
+    parseOptions({"--image-width", "256", "--max-iterations", "2000"}, defaults);
+
+    GIVEN( "a job file with comments and blank lines" )
+    {
+        {
+            std::ofstream file(path.c_str());
+            file << "# thumbnails\n"
+                 << "--output-file a.png\n"
+                 << "\n"
+                 << "  --output-file b.png   --max-iterations 500 --window-startx -0.5\n";
+        }
+        const std::vector<RenderOptions> jobs = readJobFile(path, defaults);
+
+        THEN( "every job starts from the options of the command line" )
+        {
+            REQUIRE( jobs.size() == 2 );
+            CHECK( jobs[0].output_file == "a.png" );
+            CHECK( jobs[0].image_width == 256 );
+            CHECK( jobs[0].max_iterations == 2000 );
+            CHECK( jobs[1].output_file == "b.png" );
+            CHECK( jobs[1].image_width == 256 );
+            CHECK( jobs[1].max_iterations == 500 );
+            CHECK( jobs[1].window_startx == "-0.5" );
+        }
+    }
+
+    GIVEN( "a job file with a mistake" )
+    {
+        {
+            std::ofstream file(path.c_str());
+            file << "--output-file a.png\n"
+                 << "--output-file b.png --tile-size\n";
+        }
+
+        THEN( "the error names the line" )
+        {
+            try
+            {
+                readJobFile(path, defaults);
+                FAIL( "no error" );
+            }
+            catch(const std::invalid_argument &error)
+            {
+                CHECK( std::string(error.what()).find("test-jobs.txt:2:") == 0 );
+            }
+        }
+    }
+
+    THEN( "a missing job file is an error" )
+    {
+        CHECK_THROWS_AS( readJobFile("no-such-jobs.txt", defaults), std::runtime_error );
+    }
+
+    std::remove(path.c_str());
+}
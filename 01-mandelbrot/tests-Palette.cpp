@@ -0,0 +1,147 @@
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "catch.hpp"
+#include "Palette.h"
+
+
+// The original per-pixel shading
+static void shadePixel(int n, double norm, int max_iterations, unsigned char *bgr)
+{
+    double shade;
+    if(n == max_iterations)
+        shade = n;
+    else
+        shade = n + 1 - log(log(sqrt(norm)))/log(2);
+    shade = sqrt(shade / max_iterations);
+
+    const double breakpoint = 0.28;
+    if (shade < breakpoint)
+    {
+        shade = shade / breakpoint;
+        bgr[0] = shade*240;
+        bgr[1] = shade*180;
+        bgr[2] = shade*190;
+    }
+    else
+    {
+        shade = (shade - breakpoint) / (1 - breakpoint);
+        bgr[0] = (1-shade)*240 + shade*255;
+        bgr[1] = (1-shade)*180 + shade*255;
+        bgr[2] = (1-shade)*190 + shade*255;
+    }
+}
+
+
+SCENARIO( "colorizing through the palette table matches the per-pixel shading" )
+{
+    GIVEN( "a range of escape times and final values of z" )
+    {
+        const int max_iterations = 1000;
+        std::vector<int> n;
+        std::vector<double> norm;
+        for(int k = 1; k < max_iterations; k += 7)
+        {
+            for(double r : {16.5, 40.0, 200.0, 250.0})
+            {
+                n.push_back(k);
+                norm.push_back(r*r);
+            }
+        }
+        n.push_back(max_iterations);
+        norm.push_back(0.1);
+
+        std::vector<float> smooth;
+        for(std::size_t i = 0; i < n.size(); ++i)
+            smooth.push_back(smoothIterations(n[i], norm[i], max_iterations));
+
+        std::vector<unsigned char> bgr(3*smooth.size());
+        colorize(smooth.data(), smooth.size(), Palette::standard(max_iterations), bgr.data());
+
+        THEN( "every color is within a step of the original" )
+        {
+            int largest_difference = 0;
+            for(std::size_t i = 0; i < n.size(); ++i)
+            {
+                unsigned char expected[3];
+                shadePixel(n[i], norm[i], max_iterations, expected);
+                for(int c = 0; c < 3; ++c)
+                    largest_difference = std::max(largest_difference, std::abs(bgr[3*i + c] - expected[c]));
+            }
+            CHECK( largest_difference <= 2 );
+        }
+
+        THEN( "points inside the set are white" )
+        {
+            CHECK( bgr[bgr.size() - 3] == 255 );
+            CHECK( bgr[bgr.size() - 2] == 255 );
+            CHECK( bgr[bgr.size() - 1] == 255 );
+        }
+
+        THEN( "they can be recolored with another palette" )
+        {
+            std::vector<PaletteStop> stops;
+            stops.push_back({0.0, 10, 20, 30});
+            stops.push_back({1.0, 10, 20, 30});
+            colorize(smooth.data(), smooth.size(), Palette(stops, max_iterations), bgr.data());
+
+            for(std::size_t i = 0; i < n.size(); ++i)
+            {
+                REQUIRE( std::abs(bgr[3*i] - 10) <= 1 );
+                REQUIRE( std::abs(bgr[3*i + 1] - 20) <= 1 );
+                REQUIRE( std::abs(bgr[3*i + 2] - 30) <= 1 );
+            }
+        }
+    }
+
+    GIVEN( "smooth iteration counts outside the palette" )
+    {
+        std::vector<float> smooth = {-0.4f, 5000.0f};
+        std::vector<unsigned char> bgr(6);
+        colorize(smooth.data(), smooth.size(), Palette::standard(100), bgr.data());
+
+        THEN( "they are clamped to its ends" )
+        {
+            CHECK( bgr[0] == 0 );
+            CHECK( bgr[3] == 255 );
+        }
+    }
+}
+
+
+SCENARIO( "the palette table doesn't grow with the iteration budget" )
+{
+    const int max_iterations = 2000000000;
+    const Palette palette = Palette::standard(max_iterations);
+    CHECK( palette.size() == int(Palette::table_size) );
+
+    std::vector<float> smooth = {0.0f, 0.25f*max_iterations, static_cast<float>(max_iterations)};
+    std::vector<unsigned char> bgr(9);
+    colorize(smooth.data(), smooth.size(), palette, bgr.data());
+
+    THEN( "its colors still run from black to white" )
+    {
+        CHECK( bgr[0] == 0 );
+        CHECK( bgr[3] > 0 );
+        CHECK( bgr[3] < 255 );
+        CHECK( bgr[6] == 255 );
+    }
+}
+
+
+SCENARIO( "distance shading darkens the pixels near the set" )
+{
+    std::vector<float> distance = {0.0f, 0.5f, 1.0f, 7.0f};
+    std::vector<unsigned char> bgr(12, 200);
+    shadeByDistance(distance.data(), distance.size(), 1.0f, bgr.data());
+
+    THEN( "the set is black, the pixels within the width are darker, and the rest are left alone" )
+    {
+        CHECK( bgr[0] == 0 );
+        CHECK( bgr[3] == 100 );
+        CHECK( bgr[5] == 100 );
+        CHECK( bgr[6] == 200 );
+        CHECK( bgr[9] == 200 );
+    }
+}
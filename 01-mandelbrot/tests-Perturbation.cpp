@@ -0,0 +1,191 @@
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "BigFixed.h"
+#include "Perturbation.h"
+#include "tests-BigEscapeTime.h"
+
+
+SCENARIO( "arbitrary precision fixed point arithmetic" )
+{
+    GIVEN( "some numbers parsed from strings" )
+    {
+        BigFixed a = BigFixed::fromString("1.5", 4);
+        BigFixed b = BigFixed::fromString("-2.25", 4);
+        BigFixed c = BigFixed::fromString("0.1", 4);
+        BigFixed d = BigFixed::fromString("-3e-2", 4);
+
+        THEN( "they convert back to the right doubles" )
+        {
+            CHECK( a.toDouble() == 1.5 );
+            CHECK( b.toDouble() == -2.25 );
+            CHECK( std::abs(c.toDouble() - 0.1) < 1e-17 );
+            CHECK( std::abs(d.toDouble() + 0.03) < 1e-17 );
+        }
+
+        THEN( "arithmetic gives the right results" )
+        {
+            CHECK( (a + b).toDouble() == -0.75 );
+            CHECK( (a - b).toDouble() == 3.75 );
+            CHECK( (b - a).toDouble() == -3.75 );
+            CHECK( (a * b).toDouble() == -3.375 );
+            CHECK( (b * b).toDouble() == 5.0625 );
+            CHECK( b.twice().toDouble() == -4.5 );
+            CHECK( (a - a).isZero() );
+            CHECK( std::abs((c * d).toDouble() + 0.003) < 1e-17 );
+        }
+    }
+
+    GIVEN( "numbers far below double precision" )
+    {
+        const int limbs = BigFixed::limbsForBits(1200);
+        BigFixed one = BigFixed::fromString("1", limbs);
+        BigFixed tiny = BigFixed::fromString("1e-300", limbs);
+        BigFixed small(0.75, -1100, limbs);
+
+        THEN( "they keep their precision when added to large numbers" )
+        {
+            CHECK( ((one + tiny) - one).toDouble() == Approx(1e-300) );
+            CHECK( ((one + small) - one).toDouble() == std::ldexp(0.75, -1100) );
+            CHECK( (small * BigFixed(2.0, 0, limbs)).toDouble() == std::ldexp(0.75, -1099) );
+        }
+    }
+
+    GIVEN( "numbers with exponents far beyond the precision" )
+    {
+        THEN( "they are parsed without writing out every zero" )
+        {
+            CHECK( BigFixed::fromString("1e-2000000000", 4).isZero() );
+            CHECK( BigFixed::fromString("0e2000000000", 4).isZero() );
+            CHECK( BigFixed::fromString("0.0125e2", 4).toDouble() == 0.0125e2 );
+            CHECK( BigFixed::fromString("0.5" + std::string(100000, '0') + "1", 4).toDouble() == 0.5 );
+            CHECK_THROWS_AS( BigFixed::fromString("1e2147483647", 4), std::out_of_range );
+        }
+    }
+}
+
+
+SCENARIO( "scales outside the range of a double are parsed" )
+{
+    double mantissa;
+    int exponent;
+
+    parseScale("0.75", mantissa, exponent);
+    CHECK( mantissa == Approx(0.75) );
+    CHECK( exponent == 0 );
+
+    parseScale("2.5e-1000", mantissa, exponent);
+    CHECK( mantissa >= 0.5 );
+    CHECK( mantissa < 1.0 );
+    CHECK( std::log10(mantissa) + exponent*std::log10(2.0) == Approx(std::log10(2.5) - 1000) );
+}
+
+
+SCENARIO( "perturbation gives the same escape times as direct iteration" )
+{
+    GIVEN( "a shallow view, where double precision is enough" )
+    {
+        // The default view, relative to a reference point at its center
+        const int width = 200, height = 96, max_iterations = 500;
+        const int limbs = 4;
+        ReferenceOrbit orbit(BigFixed::fromString("-0.65", limbs), BigFixed::fromString("0.6", limbs), max_iterations);
+
+        const double spacing = 2.5 / width;
+        std::vector<double> cx, cy, dcx, dcy;
+        for(int row = 0; row < height; ++row)
+        {
+            for(int col = 0; col < width; ++col)
+            {
+                dcx.push_back((col - width/2)*spacing);
+                dcy.push_back((height/2 - row)*spacing);
+                cx.push_back(-0.65 + dcx.back());
+                cy.push_back(0.6 + dcy.back());
+            }
+        }
+
+        std::vector<int> expected(cx.size()), iterations(cx.size());
+        std::vector<double> norm(cx.size());
+        escapeTimeScalar(cx.data(), cy.data(), cx.size(), max_iterations, expected.data(), norm.data());
+        perturbationEscapeTime(orbit, nullptr, dcx.data(), dcy.data(), 0, dcx.size(), max_iterations,
+                               iterations.data(), norm.data());
+
+        THEN( "nearly all of the escape times agree" )
+        {
+            // Points very close to the boundary are chaotic, so the rounding
+            // differences between the two methods can change a few of them
+            int mismatches = 0;
+            for(std::size_t i = 0; i < cx.size(); ++i)
+                if(iterations[i] != expected[i])
+                    ++mismatches;
+
+            CHECK( mismatches < static_cast<int>(cx.size()) / 500 );
+        }
+    }
+
+    // The Misiurewicz point c = i has detail at every scale
+    for(const char *scale : {"1e-40", "1e-350"})
+    {
+        GIVEN( std::string("a deep zoom to ") + scale + " around c = i" )
+        {
+            const int max_iterations = 4000;
+            double mantissa;
+            int exponent;
+            parseScale(scale, mantissa, exponent);
+            const int limbs = BigFixed::limbsForBits(-exponent + 64);
+
+            BigFixed center_x = BigFixed::fromString("0", limbs);
+            BigFixed center_y = BigFixed::fromString("1", limbs);
+            ReferenceOrbit orbit(center_x, center_y, max_iterations);
+
+            const int size = 5;
+            std::vector<double> dcx, dcy;
+            for(int row = 0; row < size; ++row)
+            {
+                for(int col = 0; col < size; ++col)
+                {
+                    dcx.push_back((col - size/2 + 0.5)*mantissa);
+                    dcy.push_back((size/2 - row + 0.25)*mantissa);
+                }
+            }
+
+            std::vector<int> expected(dcx.size());
+            for(std::size_t i = 0; i < dcx.size(); ++i)
+            {
+                BigFixed cx = center_x + BigFixed(dcx[i], exponent, limbs);
+                BigFixed cy = center_y + BigFixed(dcy[i], exponent, limbs);
+                expected[i] = bigEscapeTime(cx, cy, max_iterations);
+            }
+
+            std::vector<int> iterations(dcx.size());
+            std::vector<double> norm(dcx.size());
+
+            THEN( "the escape times match arbitrary precision iteration" )
+            {
+                perturbationEscapeTime(orbit, nullptr, dcx.data(), dcy.data(), exponent, dcx.size(),
+                                       max_iterations, iterations.data(), norm.data());
+
+                for(std::size_t i = 0; i < dcx.size(); ++i)
+                {
+                    CHECK( iterations[i] == expected[i] );
+                    CHECK( iterations[i] < max_iterations );
+                }
+            }
+
+            THEN( "skipping iterations with BLA gives the same escape times" )
+            {
+                const double max_dc = std::ldexp(mantissa*size, exponent);
+                BlaTable table(orbit, max_dc);
+                REQUIRE( table.levels() > 10 );
+
+                perturbationEscapeTime(orbit, &table, dcx.data(), dcy.data(), exponent, dcx.size(),
+                                       max_iterations, iterations.data(), norm.data());
+
+                for(std::size_t i = 0; i < dcx.size(); ++i)
+                    CHECK( iterations[i] == expected[i] );
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef TESTS_PNG_H_
+#define TESTS_PNG_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "catch.hpp"
+
+// Reading back the PNGs written by PngWriter, for the tests
+
+
+static std::vector<unsigned char> readFile(const std::string &path)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+static std::vector<unsigned char> inflateAll(const unsigned char *data, std::size_t size, std::size_t expected_size)
+{
+    std::vector<unsigned char> output(expected_size);
+    uLongf output_size = output.size();
+    REQUIRE( uncompress(output.data(), &output_size, data, size) == Z_OK );
+    REQUIRE( output_size == expected_size );
+    return output;
+}
+
+
+static std::uint32_t bigEndian32(const unsigned char *p)
+{
+    return (std::uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Decode an RGB PNG that only uses the filters of PngWriter (and None)
+static std::vector<unsigned char> decodePng(const std::vector<unsigned char> &file, int &width, int &height)
+{
+    REQUIRE( file.size() > 8 );
+    REQUIRE( file[1] == 'P' );
+
+    std::vector<unsigned char> compressed;
+    std::size_t position = 8;
+    while(position < file.size())
+    {
+        const std::uint32_t length = bigEndian32(&file[position]);
+        const std::string type(file.begin() + position + 4, file.begin() + position + 8);
+        const unsigned char *data = &file[position + 8];
+        const std::uint32_t crc = bigEndian32(data + length);
+        REQUIRE( crc == crc32(crc32(0, &file[position + 4], 4), data, length) );
+
+        if(type == "IHDR")
+        {
+            width = bigEndian32(data);
+            height = bigEndian32(data + 4);
+        }
+        else if(type == "IDAT")
+        {
+            compressed.insert(compressed.end(), data, data + length);
+        }
+        position += 12 + length;
+    }
+
+    const std::size_t stride = 3*width + 1;
+    std::vector<unsigned char> filtered = inflateAll(compressed.data(), compressed.size(), stride*height);
+    std::vector<unsigned char> rgb(3*width*height);
+    for(int row = 0; row < height; ++row)
+    {
+        const unsigned char filter = filtered[row*stride];
+        REQUIRE( (filter == 0 || filter == 1 || filter == 4) );
+        for(int k = 0; k < 3*width; ++k)
+        {
+            const int a = k >= 3 ? rgb[row*3*width + k - 3] : 0;
+            const int b = row > 0 ? rgb[(row - 1)*3*width + k] : 0;
+            const int c = k >= 3 && row > 0 ? rgb[(row - 1)*3*width + k - 3] : 0;
+            const int p = a + b - c;
+            const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            const int predictor = filter == 0 ? 0 : filter == 1 ? a : (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            rgb[row*3*width + k] = filtered[row*stride + 1 + k] + predictor;
+        }
+    }
+    return rgb;
+}
+
+
+#endif  // TESTS_PNG_H_
@@ -0,0 +1,167 @@
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "ProgressiveRenderer.h"
+
+
+// Colors every point by its coordinates
+static void colorByPosition(const double *x, const double *y, int count, unsigned char *bgr)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        bgr[i*3] = static_cast<int>(x[i]) % 251;
+        bgr[i*3 + 1] = static_cast<int>(y[i]) % 251;
+        bgr[i*3 + 2] = 7;
+    }
+}
+
+
+SCENARIO( "progressive rendering ends with every pixel calculated once" )
+{
+    ThreadPool pool(3);
+    const int width = 70, height = 45;
+    ProgressiveRenderer renderer(pool, width, height);
+
+    std::vector<std::atomic<int>> calculated(width*height);
+    for(std::atomic<int> &count : calculated)
+        count = 0;
+    renderer.start([&](const double *x, const double *y, int count, unsigned char *bgr)
+    {
+        for(int i = 0; i < count; ++i)
+            ++calculated[static_cast<int>(y[i])*width + static_cast<int>(x[i])];
+        colorByPosition(x, y, count, bgr);
+    });
+    renderer.wait();
+
+    std::vector<unsigned char> frame(width*height*3);
+    const int step = renderer.takeFrame(frame.data());
+
+    THEN( "the last pass is at full resolution" )
+    {
+        CHECK( step == 1 );
+        CHECK( renderer.takeFrame(frame.data()) == 0 );
+    }
+
+    THEN( "every pixel has its own color" )
+    {
+        bool same = true;
+        for(int row = 0; row < height; ++row)
+            for(int col = 0; col < width; ++col)
+            {
+                const double x = col, y = row;
+                unsigned char expected[3];
+                colorByPosition(&x, &y, 1, expected);
+                for(int k = 0; k < 3; ++k)
+                    same = same && frame[(row*width + col)*3 + k] == expected[k];
+            }
+        CHECK( same );
+    }
+
+    THEN( "no point was calculated twice" )
+    {
+        bool once = true;
+        for(const std::atomic<int> &count : calculated)
+            once = once && count == 1;
+        CHECK( once );
+    }
+}
+
+
+SCENARIO( "starting a frame cancels the one in flight" )
+{
+    ThreadPool pool(2);
+    const int width = 64, height = 64;
+    ProgressiveRenderer renderer(pool, width, height);
+
+    std::atomic<int> slow_calls(0);
+    renderer.start([&](const double *, const double *, int count, unsigned char *bgr)
+    {
+        ++slow_calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        for(int i = 0; i < count*3; ++i)
+            bgr[i] = 1;
+    });
+    while(slow_calls == 0)
+        std::this_thread::yield();
+    renderer.start(colorByPosition);
+    renderer.wait();
+
+    std::vector<unsigned char> frame(width*height*3);
+    renderer.takeFrame(frame.data());
+
+    THEN( "the old frame stops after the rows in flight" )
+    {
+        // All of its passes would take 4 + 16 + 64 rows
+        CHECK( slow_calls < 10 );
+    }
+
+    THEN( "the frame shows the new one" )
+    {
+        CHECK( frame[(10*width + 20)*3] == 20 );
+        CHECK( frame[(10*width + 20)*3 + 1] == 10 );
+    }
+}
+
+
+SCENARIO( "a cancelled frame is replaced by the next one" )
+{
+    ThreadPool pool(2);
+    ProgressiveRenderer renderer(pool, 20, 20);
+
+    for(int frame = 0; frame < 10; ++frame)
+        renderer.start(colorByPosition);
+    renderer.wait();
+
+    std::vector<unsigned char> bgr(20*20*3);
+    CHECK( renderer.takeFrame(bgr.data()) == 1 );
+    CHECK( bgr[(19*20 + 19)*3] == 19 );
+}
+
+
+SCENARIO( "exceptions of the colors reach the caller" )
+{
+    ThreadPool pool(2);
+    ProgressiveRenderer renderer(pool, 20, 20);
+    renderer.start([](const double *, const double *, int, unsigned char *)
+    {
+        throw std::runtime_error("no colors");
+    });
+    CHECK_THROWS_AS( renderer.wait(), std::runtime_error );
+}
+
+
+SCENARIO( "frames are reprojected for a new view" )
+{
+    const int width = 8, height = 4;
+    std::vector<unsigned char> previous(width*height*3), bgr(width*height*3);
+    for(int row = 0; row < height; ++row)
+        for(int col = 0; col < width; ++col)
+            previous[(row*width + col)*3] = row*width + col + 1;
+
+    WHEN( "the view moves right by 3 pixels" )
+    {
+        reprojectFrame(previous.data(), width, height, 3, 0, 1, bgr.data());
+
+        THEN( "the pixels move left, and black comes in" )
+        {
+            CHECK( bgr[0] == previous[3*3] );
+            CHECK( bgr[(2*width + 4)*3] == previous[(2*width + 7)*3] );
+            CHECK( bgr[(2*width + 5)*3] == 0 );
+        }
+    }
+
+    WHEN( "the view zooms in by 2 on its center" )
+    {
+        reprojectFrame(previous.data(), width, height, 2, 1, 0.5, bgr.data());
+
+        THEN( "the center pixels are spread over 2 x 2 blocks" )
+        {
+            CHECK( bgr[0] == previous[(1*width + 2)*3] );
+            CHECK( bgr[(2*width + 4)*3] == previous[(2*width + 4)*3] );
+        }
+    }
+}
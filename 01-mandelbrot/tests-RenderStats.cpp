@@ -0,0 +1,163 @@
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "RenderStats.h"
+#include "tests-Png.h"
+
+
+static std::vector<std::string> readLines(const std::string &path)
+{
+    std::ifstream file(path.c_str());
+    std::vector<std::string> lines;
+    for(std::string line; std::getline(file, line); )
+        lines.push_back(line);
+    return lines;
+}
+
+
+SCENARIO( "render statistics are recorded per tile" )
+{
+    const int max_iterations = 100;
+    RenderStats stats(max_iterations);
+
+    THEN( "escape times are binned by powers of two" )
+    {
+        CHECK( RenderStats::histogramBin(0) == 0 );
+        CHECK( RenderStats::histogramBin(1) == 1 );
+        CHECK( RenderStats::histogramBin(2) == 1 );
+        CHECK( RenderStats::histogramBin(3) == 2 );
+        CHECK( RenderStats::histogramBin(6) == 2 );
+        CHECK( RenderStats::histogramBin(7) == 3 );
+        CHECK( stats.histogramBins() == 7 );
+    }
+
+    GIVEN( "a calculated tile and a cached one" )
+    {
+        const Tile calculated = {0, 0, 3, 2};
+        const int iterations[] = {0, 1, 2, 5, 100, 100};
+        stats.record(calculated, stats.now(), iterations, 6);
+
+        const Tile cached = {3, 0, 3, 2};
+        stats.recordCached(cached, stats.now());
+
+        const std::vector<TileStats> tiles = stats.tiles();
+        REQUIRE( tiles.size() == 2 );
+
+        THEN( "the escape times of the calculated tile are counted" )
+        {
+            const TileStats &tile = tiles[0];
+            CHECK( !tile.cached );
+            CHECK( tile.thread == -1 );
+            CHECK( tile.seconds >= 0 );
+            CHECK( tile.calculated == 6 );
+            CHECK( tile.iterations == 208 );
+            CHECK( tile.escaped == 4 );
+            CHECK( tile.max_iteration == 2 );
+            CHECK( tile.histogram == std::vector<int>({1, 2, 1, 0, 0, 0, 0}) );
+        }
+
+        THEN( "the cached tile has no escape times" )
+        {
+            const TileStats &tile = tiles[1];
+            CHECK( tile.cached );
+            CHECK( tile.calculated == 0 );
+            CHECK( tile.iterations == 0 );
+            CHECK( tile.histogram == std::vector<int>(7, 0) );
+        }
+
+        THEN( "they are written as CSV, one line per tile" )
+        {
+            stats.write("test-stats.csv");
+            const std::vector<std::string> lines = readLines("test-stats.csv");
+            REQUIRE( lines.size() == 3 );
+            CHECK( lines[0] == "x,y,width,height,thread,start,seconds,cached,calculated,iterations,escaped,"
+                               "max_iteration,n>=0,n>=1,n>=3,n>=7,n>=15,n>=31,n>=63" );
+            CHECK( lines[1].find("0,0,3,2,-1,") == 0 );
+            CHECK( lines[1].find(",0,6,208,4,2,1,2,1,0,0,0,0") != std::string::npos );
+            CHECK( lines[2].find("3,0,3,2,-1,") == 0 );
+            std::remove("test-stats.csv");
+        }
+
+        THEN( "they are written as JSON" )
+        {
+            stats.write("test-stats.json");
+            std::ifstream file("test-stats.json");
+            std::stringstream json;
+            json << file.rdbuf();
+            CHECK( json.str().find("\"max_iterations\": 100") != std::string::npos );
+            CHECK( json.str().find("\"histogram_bins\": [[0, 1], [1, 3], [3, 7], [7, 15], [15, 31], [31, 63], [63, 100]]")
+                   != std::string::npos );
+            CHECK( json.str().find("\"iterations\": 208, \"escaped\": 4, \"max_iteration\": 2, "
+                                   "\"histogram\": [1, 2, 1, 0, 0, 0, 0]") != std::string::npos );
+            CHECK( json.str().find("\"cached\": true") != std::string::npos );
+            std::remove("test-stats.json");
+        }
+
+        THEN( "other formats are refused" )
+        {
+            CHECK_THROWS_AS( stats.write("test-stats.txt"), std::runtime_error );
+        }
+    }
+}
+
+
+SCENARIO( "the heatmap shows where the time went" )
+{
+    RenderStats stats(100);
+    std::vector<int> iterations(100*100, 1);
+
+    // A slow tile next to a fast one
+    const Tile slow = {0, 0, 100, 100};
+    stats.record(slow, stats.now() - 1, iterations.data(), 100*100);
+    const Tile fast = {100, 0, 50, 100};
+    stats.record(fast, stats.now(), iterations.data(), 50*100);
+
+    GIVEN( "a heatmap at full size" )
+    {
+        int width, height;
+        const std::vector<unsigned char> bgr = stats.heatmap(width, height);
+
+        THEN( "it covers the tiles, with the slowest one in white" )
+        {
+            CHECK( width == 150 );
+            CHECK( height == 100 );
+            CHECK( bgr[0] == 255 );
+            CHECK( bgr[1] == 255 );
+            CHECK( bgr[2] == 255 );
+
+            const unsigned char *pixel = &bgr[3*(50*width + 120)];
+            CHECK( pixel[0] < 255 );
+        }
+    }
+
+    GIVEN( "a heatmap shrunk to fit" )
+    {
+        int width, height;
+        stats.heatmap(width, height, 64);
+
+        THEN( "it is shrunk by a whole factor" )
+        {
+            CHECK( width == 50 );
+            CHECK( height == 34 );
+        }
+    }
+
+    GIVEN( "a heatmap written to a PNG" )
+    {
+        stats.writeHeatmap("test-heatmap.png", 64);
+        int width, height;
+        const std::vector<unsigned char> rgb = decodePng(readFile("test-heatmap.png"), width, height);
+
+        THEN( "the file holds it" )
+        {
+            CHECK( width == 50 );
+            CHECK( height == 34 );
+            CHECK( rgb[0] == 255 );
+        }
+        std::remove("test-heatmap.png");
+    }
+}
@@ -0,0 +1,178 @@
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "BoundedQueue.h"
+#include "ThreadPool.h"
+#include "Tiles.h"
+
+
+SCENARIO( "the thread pool runs every task exactly once" )
+{
+    GIVEN( "a pool with several threads" )
+    {
+        ThreadPool pool(4);
+        REQUIRE( pool.size() == 4 );
+
+        WHEN( "many tasks of varying cost are submitted" )
+        {
+            std::vector<std::atomic<int> > counts(1000);
+            for(std::atomic<int> &count : counts)
+                count = 0;
+
+            for(std::size_t i = 0; i < counts.size(); ++i)
+            {
+                pool.submit([&counts, i]
+                {
+                    // Make a few of the tasks much more expensive than the rest
+                    volatile double x = 0;
+                    for(int k = 0; k < (i % 97 == 0 ? 200000 : 10); ++k)
+                        x = x + k;
+                    ++counts[i];
+                });
+            }
+            pool.wait();
+
+            THEN( "each task ran once" )
+            {
+                for(std::atomic<int> &count : counts)
+                    REQUIRE( count == 1 );
+            }
+        }
+
+        WHEN( "tasks ask which worker runs them" )
+        {
+            std::vector<int> workers(100, -2);
+            for(std::size_t i = 0; i < workers.size(); ++i)
+                pool.submit([&workers, i]{ workers[i] = ThreadPool::workerIndex(); });
+            pool.wait();
+
+            THEN( "it is one of the pool's, and outside the pool there is none" )
+            {
+                for(int worker : workers)
+                {
+                    REQUIRE( worker >= 0 );
+                    REQUIRE( worker < 4 );
+                }
+                REQUIRE( ThreadPool::workerIndex() == -1 );
+            }
+        }
+
+        WHEN( "tasks submit more tasks" )
+        {
+            std::atomic<int> count(0);
+            for(int i = 0; i < 10; ++i)
+            {
+                pool.submit([&pool, &count]
+                {
+                    for(int j = 0; j < 10; ++j)
+                        pool.submit([&count]{ ++count; });
+                    ++count;
+                });
+            }
+            pool.wait();
+
+            THEN( "wait() waits for the nested tasks too" )
+            {
+                REQUIRE( count == 110 );
+            }
+        }
+
+        WHEN( "a task throws" )
+        {
+            std::atomic<int> count(0);
+            for(int i = 0; i < 10; ++i)
+            {
+                pool.submit([&count, i]
+                {
+                    ++count;
+                    if(i == 5)
+                        throw std::runtime_error("task failed");
+                });
+            }
+
+            THEN( "the exception is rethrown by wait(), after the other tasks have run" )
+            {
+                REQUIRE_THROWS_AS( pool.wait(), std::runtime_error );
+                REQUIRE( count == 10 );
+            }
+        }
+    }
+}
+
+
+SCENARIO( "an image is split into tiles" )
+{
+    GIVEN( "an image whose size is not a multiple of the tile size" )
+    {
+        std::vector<Tile> tiles = makeTiles(150, 70, 64);
+
+        THEN( "the tiles cover every pixel exactly once" )
+        {
+            REQUIRE( tiles.size() == 6 );
+
+            std::vector<int> covered(150*70, 0);
+            for(const Tile &tile : tiles)
+                for(int y = tile.y; y < tile.y + tile.height; ++y)
+                    for(int x = tile.x; x < tile.x + tile.width; ++x)
+                        ++covered[y*150 + x];
+
+            for(int c : covered)
+                REQUIRE( c == 1 );
+        }
+
+        THEN( "the edge tiles are clipped to the image" )
+        {
+            CHECK( tiles[2].x == 128 );
+            CHECK( tiles[2].width == 22 );
+            CHECK( tiles[5].y == 64 );
+            CHECK( tiles[5].height == 6 );
+        }
+    }
+}
+
+
+SCENARIO( "a bounded queue passes items between threads in order" )
+{
+    GIVEN( "a producer that is much faster than the consumer" )
+    {
+        BoundedQueue<int> queue(3);
+        std::atomic<int> pushed(0);
+        std::vector<int> popped;
+
+        std::thread producer([&]
+        {
+            for(int i = 0; i < 100; ++i)
+            {
+                queue.push(i);
+                ++pushed;
+            }
+            queue.close();
+        });
+
+        int item;
+        while(queue.pop(item))
+        {
+            // The producer can't get more than the queue size ahead
+            REQUIRE( pushed - static_cast<int>(popped.size()) <= 4 );
+            popped.push_back(item);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        producer.join();
+
+        THEN( "every item arrives once, in order" )
+        {
+            REQUIRE( popped.size() == 100 );
+            for(int i = 0; i < 100; ++i)
+                REQUIRE( popped[i] == i );
+        }
+
+        THEN( "nothing more can be pushed after closing" )
+        {
+            CHECK_FALSE( queue.push(100) );
+        }
+    }
+}
@@ -0,0 +1,112 @@
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include "catch.hpp"
+#include "TileCache.h"
+
+
+static void removeDirectory(const std::string &directory)
+{
+    if(DIR *dir = opendir(directory.c_str()))
+    {
+        while(dirent *file = readdir(dir))
+        {
+            const std::string name = file->d_name;
+            if(name != "." && name != "..")
+                std::remove((directory + "/" + name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(directory.c_str());
+}
+
+
+SCENARIO( "tiles are cached on disk by their key" )
+{
+    const std::string directory = "test-tile-cache";
+    removeDirectory(directory);
+
+    const Tile tile = {64, 32, 5, 3};
+    const std::string key = tileKey("window -1.9 2.5 1.2 1.2 2000x960", tile, 1000, "double");
+
+    // The tile, in rows of 8 floats
+    std::vector<float> smooth(8*tile.height);
+    for(std::size_t k = 0; k < smooth.size(); ++k)
+        smooth[k] = 0.5f*k;
+
+    GIVEN( "a tile stored in the cache" )
+    {
+        {
+            TileCache cache(directory, 1 << 20);
+            CHECK( !cache.load(key, tile.width, tile.height, smooth.data(), 8) );
+            cache.store(key, tile.width, tile.height, smooth.data(), 8);
+        }
+
+        TileCache cache(directory, 1 << 20);
+
+        THEN( "a later run loads it back" )
+        {
+            std::vector<float> loaded(8*tile.height, -1);
+            REQUIRE( cache.load(key, tile.width, tile.height, loaded.data(), 8) );
+            for(int row = 0; row < tile.height; ++row)
+            {
+                for(int col = 0; col < 8; ++col)
+                {
+                    if(col < tile.width)
+                        CHECK( loaded[row*8 + col] == smooth[row*8 + col] );
+                    else
+                        CHECK( loaded[row*8 + col] == -1 );
+                }
+            }
+            CHECK( cache.hits() == 1 );
+        }
+
+        THEN( "any change to the key is a miss" )
+        {
+            std::vector<float> loaded(8*tile.height);
+            const Tile other = {64, 35, 5, 3};
+            CHECK( !cache.load(tileKey("window -1.9 2.5 1.2 1.2 2000x960", other, 1000, "double"),
+                               tile.width, tile.height, loaded.data(), 8) );
+            CHECK( !cache.load(tileKey("window -1.9 2.5 1.2 1.2 2000x960", tile, 2000, "double"),
+                               tile.width, tile.height, loaded.data(), 8) );
+            CHECK( !cache.load(tileKey("window -1.9 2.5 1.2 1.2 2000x960", tile, 1000, "double-double"),
+                               tile.width, tile.height, loaded.data(), 8) );
+            CHECK( !cache.load(tileKey("window -1.8 2.5 1.2 1.2 2000x960", tile, 1000, "double"),
+                               tile.width, tile.height, loaded.data(), 8) );
+            CHECK( cache.misses() == 4 );
+        }
+    }
+
+    GIVEN( "a cache with room for three tiles" )
+    {
+        auto keyOf = [&](int n) { return key + " " + std::to_string(n); };
+        const int tile_bytes = 24 + keyOf(0).size() + sizeof(float)*tile.width*tile.height;
+        TileCache cache(directory, 3*tile_bytes);
+
+        auto contains = [&](int n)
+        {
+            std::vector<float> loaded(8*tile.height);
+            return cache.load(keyOf(n), tile.width, tile.height, loaded.data(), 8);
+        };
+
+        for(int n = 0; n < 3; ++n)
+            cache.store(keyOf(n), tile.width, tile.height, smooth.data(), 8);
+
+        THEN( "storing a fourth evicts the least recently used one" )
+        {
+            REQUIRE( contains(0) );
+            cache.store(keyOf(3), tile.width, tile.height, smooth.data(), 8);
+
+            CHECK( contains(0) );
+            CHECK( !contains(1) );
+            CHECK( contains(2) );
+            CHECK( contains(3) );
+            CHECK( cache.size() <= 3u*tile_bytes );
+        }
+    }
+
+    removeDirectory(directory);
+}
@@ -0,0 +1,155 @@
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "catch.hpp"
+#include "ThreadPool.h"
+#include "TilePyramid.h"
+#include "tests-Png.h"
+
+
+// The color of a pixel of the full size test image
+static void patternColor(int x, int y, unsigned char *bgr)
+{
+    bgr[0] = x*2;
+    bgr[1] = y*3;
+    bgr[2] = (x*y) % 251;
+}
+
+
+static std::vector<unsigned char> readTile(const TilePyramid &pyramid, int level, int col, int row,
+                                           int &width, int &height)
+{
+    const std::vector<unsigned char> file = readFile(pyramid.tilePath(level, col, row));
+    INFO( pyramid.tilePath(level, col, row) );
+    REQUIRE( !file.empty() );
+    return decodePng(file, width, height);
+}
+
+
+// Remove the tiles and directories of a pyramid
+static void removePyramid(const TilePyramid &pyramid, const std::string &name, bool xyz)
+{
+    for(int level = 0; level < pyramid.levels(); ++level)
+    {
+        for(int row = 0; row < pyramid.tileRows(level); ++row)
+            for(int col = 0; col < pyramid.tileColumns(level); ++col)
+                std::remove(pyramid.tilePath(level, col, row).c_str());
+
+        const std::string z = xyz ? name + "/" + std::to_string(level - (pyramid.levels() - 3))
+                                  : name + "_files/" + std::to_string(level);
+        if(xyz)
+            for(int col = 0; col < pyramid.tileColumns(level); ++col)
+                rmdir((z + "/" + std::to_string(col)).c_str());
+        rmdir(z.c_str());
+    }
+    rmdir((xyz ? name : name + "_files").c_str());
+    std::remove((name + ".dzi").c_str());
+}
+
+
+SCENARIO( "tile pyramids render the deepest level and shrink it for the others" )
+{
+    const int width = 100, height = 60, tile_size = 32;
+    ThreadPool pool(3);
+
+    std::atomic<int> rendered_pixels(0);
+    auto renderTile = [&](const Tile &tile, unsigned char *bgr)
+    {
+        for(int y = 0; y < tile.height; ++y)
+            for(int x = 0; x < tile.width; ++x)
+                patternColor(tile.x + x, tile.y + y, bgr + 3*(y*tile.width + x));
+        rendered_pixels += tile.width*tile.height;
+    };
+
+    GIVEN( "a Deep Zoom pyramid" )
+    {
+        const std::string name = "test-pyramid";
+        TilePyramid pyramid(name, width, height, tile_size);
+        REQUIRE( pyramid.levels() == 8 );
+        REQUIRE( pyramid.levelWidth(6) == 50 );
+        REQUIRE( pyramid.levelHeight(0) == 1 );
+
+        const int tiles = pyramid.build(pool, renderTile);
+
+        THEN( "every pixel is rendered once, and every tile of every level is written" )
+        {
+            CHECK( rendered_pixels == width*height );
+
+            int count = 0;
+            for(int level = 0; level < pyramid.levels(); ++level)
+            {
+                for(int row = 0; row < pyramid.tileRows(level); ++row)
+                {
+                    for(int col = 0; col < pyramid.tileColumns(level); ++col)
+                    {
+                        int w, h;
+                        readTile(pyramid, level, col, row, w, h);
+                        CHECK( w == std::min(tile_size, pyramid.levelWidth(level) - col*tile_size) );
+                        CHECK( h == std::min(tile_size, pyramid.levelHeight(level) - row*tile_size) );
+                        ++count;
+                    }
+                }
+            }
+            CHECK( count == tiles );
+            CHECK( readFile(name + ".dzi").size() > 0 );
+        }
+
+        THEN( "the deepest level is the image, and the next one averages 2x2 pixels of it" )
+        {
+            int w, h;
+            const std::vector<unsigned char> deep = readTile(pyramid, 7, 1, 1, w, h);
+            unsigned char expected[3];
+            patternColor(32 + 5, 32 + 9, expected);
+            CHECK( deep[3*(9*w + 5)] == expected[2] );
+            CHECK( deep[3*(9*w + 5) + 1] == expected[1] );
+            CHECK( deep[3*(9*w + 5) + 2] == expected[0] );
+
+            const std::vector<unsigned char> shrunk = readTile(pyramid, 6, 1, 0, w, h);
+            REQUIRE( w == 18 );
+            const int x = 3, y = 20;
+            int sum[3] = {0, 0, 0};
+            for(int j = 0; j < 2; ++j)
+            {
+                for(int i = 0; i < 2; ++i)
+                {
+                    unsigned char bgr[3];
+                    patternColor(2*(32 + x) + i, 2*y + j, bgr);
+                    for(int c = 0; c < 3; ++c)
+                        sum[c] += bgr[c];
+                }
+            }
+            for(int c = 0; c < 3; ++c)
+                CHECK( shrunk[3*(y*w + x) + 2 - c] == (sum[c] + 2)/4 );
+        }
+
+        removePyramid(pyramid, name, false);
+    }
+
+    GIVEN( "an XYZ pyramid" )
+    {
+        const std::string name = "test-pyramid-xyz";
+        TilePyramid pyramid(name, width, height, tile_size, PyramidLayout::xyz);
+        const int tiles = pyramid.build(pool, renderTile);
+
+        THEN( "it starts with the image in one tile, and all tiles are full size" )
+        {
+            CHECK( pyramid.tilePath(5, 0, 0) == name + "/0/0/0.png" );
+            CHECK( pyramid.tilePath(7, 3, 1) == name + "/2/3/1.png" );
+            CHECK( tiles == 1 + 2 + 8 );
+
+            int w, h;
+            const std::vector<unsigned char> top = readTile(pyramid, 5, 0, 0, w, h);
+            CHECK( w == tile_size );
+            CHECK( h == tile_size );
+
+            // Padded with black beyond the 25x15 pixels of the image
+            CHECK( top[3*(20*w + 30)] == 0 );
+            CHECK( top[3*(5*w + 5) + 1] > 0 );
+        }
+
+        removePyramid(pyramid, name, true);
+    }
+}
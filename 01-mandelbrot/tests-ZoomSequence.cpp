@@ -0,0 +1,96 @@
+
+#include <cmath>
+#include <vector>
+#include "catch.hpp"
+#include "EscapeTime.h"
+#include "ThreadPool.h"
+#include "ZoomSequence.h"
+
+
+namespace
+{
+    const int width = 96, height = 64;
+    const int max_iterations = 500;
+
+    void calculate(const double *cx, const double *cy, int count, int max_iterations, int *iterations, double *norm)
+    {
+        escapeTimeScalar(cx, cy, count, max_iterations, iterations, norm);
+    }
+
+    // The smooth iteration count at a position in pixels of a view
+    float smoothAt(const ZoomView &view, double col, double row)
+    {
+        const double cx = view.center_x + (col - width/2.0)*view.spacing;
+        const double cy = view.center_y + (height/2.0 - row)*view.spacing;
+        int iterations;
+        double norm;
+        calculate(&cx, &cy, 1, max_iterations, &iterations, &norm);
+        return smoothIterations(iterations, norm, max_iterations);
+    }
+
+    ZoomView zoomFrame(int frame)
+    {
+        ZoomView view = {-0.7435, 0.1314, 3.0/width * std::pow(0.95, frame)};
+        return view;
+    }
+}
+
+
+SCENARIO( "zoom frames reuse the samples of the previous frame" )
+{
+    ThreadPool pool(3);
+
+    GIVEN( "a sequence that never reuses samples" )
+    {
+        ZoomSequence sequence(width, height, 0);
+
+        THEN( "every frame is calculated in full" )
+        {
+            for(int frame = 0; frame < 3; ++frame)
+            {
+                const ZoomView view = zoomFrame(frame);
+                REQUIRE( sequence.renderFrame(view, pool, 16, max_iterations, calculate) == width*height );
+                for(int row = 0; row < height; ++row)
+                    for(int col = 0; col < width; ++col)
+                        REQUIRE( sequence.smooth()[row*width + col] == smoothAt(view, col, row) );
+            }
+        }
+    }
+
+    GIVEN( "a preview sequence" )
+    {
+        ZoomSequence sequence(width, height, 0.5);
+
+        THEN( "the same view twice needs no calculation at all" )
+        {
+            REQUIRE( sequence.renderFrame(zoomFrame(0), pool, 16, max_iterations, calculate) == width*height );
+            const std::vector<float> first = sequence.smooth();
+            REQUIRE( sequence.renderFrame(zoomFrame(0), pool, 16, max_iterations, calculate) == 0 );
+            REQUIRE( sequence.smooth() == first );
+        }
+
+        THEN( "every pixel shows the exact value of a sample within the tolerance, however many frames on" )
+        {
+            int calculated = 0;
+            for(int frame = 0; frame < 20; ++frame)
+                calculated += sequence.renderFrame(zoomFrame(frame), pool, 16, max_iterations, calculate);
+
+            // Most of the pixels were reused
+            CHECK( calculated < 20*width*height / 3 );
+
+            const ZoomView view = zoomFrame(19);
+            for(int row = 0; row < height; ++row)
+            {
+                for(int col = 0; col < width; ++col)
+                {
+                    const int k = row*width + col;
+                    INFO( "pixel " << col << ", " << row );
+                    REQUIRE( std::fabs(sequence.offsetX()[k]) <= 0.5 );
+                    REQUIRE( std::fabs(sequence.offsetY()[k]) <= 0.5 );
+                    REQUIRE( sequence.smooth()[k] ==
+                             Approx(smoothAt(view, col + sequence.offsetX()[k], row + sequence.offsetY()[k])).epsilon(1e-4) );
+                }
+            }
+        }
+    }
+}